@@ -2,39 +2,99 @@
 #include "rtc.h" //needed for rtc handler
 #include "i8259.h"
 #include "keyboard.h"
+#include "kdata.h"
 #include "x86_desc.h"
 #include "lib.h"
 #include "fs.h"
-
-//pointer to the current pcb array for each termninal
-pcb_t* curr_task[MAX_TERMINALS];
-//array used to store which process ids are used
-uint32_t pid_used[MAX_TERMINALS][MAX_PCBS] = {{0,0,0,0,0,0},{0,0,0,0,0,0},{0,0,0,0,0,0}};
-//array to store the start addresses of each pcb
-static uint32_t PCB_ADDR[MAX_TERMINALS][MAX_PCBS];
+#include "uaccess.h"
+#include "pipe.h"
+
+//pointer to the current pcb array for each termninal, then the background slots
+pcb_t* curr_task[MAX_SLOTS + 1];
+//global process table indexed by pid, NULL when the pid is free
+pcb_t* process_table[MAX_PROCESSES];
+//stack of free pids so allocating and releasing a pid is O(1)
+static int32_t free_pids[MAX_PROCESSES];
+static uint32_t num_free_pids;
+//free_pids and the entries of process_table
+static spinlock_t proc_lock = SPIN_LOCK_INIT("proc");
+//deepest kernel stack use of any process that has exited
+static uint32_t max_stack_used;
+
+static void poison_stack(int32_t pid);
+static void fd_release(pcb_t* task, int32_t fd);
+static int32_t exec_program(const uint8_t* command, int32_t in_fd, int32_t out_fd, int32_t slot);
+static spinlock_t sleep_lock = SPIN_LOCK_INIT("nanosleep"); //sleep timers and their sleepers
 //file operations table for each of the different file types
 operations_table_t file_operations = {read_file, write_file, open_file, close_file};
 operations_table_t dir_operations = {read_dir, write_dir, open_dir, close_dir};
 operations_table_t rtc_operations = {rtc_read, rtc_write, rtc_open, rtc_close};
 operations_table_t stdin_operations = {terminal_read, NULL, terminal_open, terminal_close};
 operations_table_t stdout_operations = {NULL, terminal_write, NULL, NULL};
+operations_table_t pipe_read_operations = {pipe_read, NULL, NULL, pipe_close};
+operations_table_t pipe_write_operations = {NULL, pipe_write, NULL, pipe_close};
 
 /*
 * void set_pcbs()
 *   Inputs: void
 *   Return Value: none
-*	Function: sets up the pcb address array in decreasing 8kB addresses from 8MB
+*	Function: empties the process table and puts every pid on the free stack,
+*		lowest pid on top so the first shell gets pid 0
 */
 void set_pcbs(){
-	int curr_addr = PCB_ADDR_BASE;
-	int x, y;
-	for(y=0; y<MAX_TERMINALS; y++){
-		for(x=0; x<MAX_PCBS; x++){
-			PCB_ADDR[y][x] = (curr_addr -= EIGHT_KB);
-		}
+	int32_t pid;
+	num_free_pids = 0;
+	for(pid=MAX_PROCESSES-1; pid>=0; pid--){
+		process_table[pid] = NULL;
+		free_pids[num_free_pids++] = pid;
+	}
+}
+
+/*
+* void restore_task_paging(pcb_t* task)
+*   Inputs: task = pcb of the process about to run on the current terminal
+*   Return Value: none
+*	Function: maps the program page and the heap of the task, then flushes the TLB
+*/
+void restore_task_paging(pcb_t* task){
+	add_page(region_pde(task->user_table, 0), VIRT_ADDR128_INDEX);
+	set_heap_table(task->heap_table, task->large_regions & LARGE_HEAP);
+	set_shm_table(task->shm_table);
+	reset_cr3();
+}
+
+/*
+* void promote_heap(pcb_t* task)
+*   Inputs: task = process whose heap just filled its 4MB region
+*   Return Value: none
+*	Function: maps the heap with a single 4MB page once every page in it is
+*		present, so it only takes one TLB entry. a page swapped out meanwhile
+*		keeps it in 4KB pages
+*/
+void promote_heap(pcb_t* task){
+	if(task->large_regions & LARGE_HEAP)
+		return;
+	if(promote_table(task->heap_table) == 0){
+		task->large_regions |= LARGE_HEAP;
+		restore_task_paging(task);
 	}
 }
 
+/*
+* void demote_heap(pcb_t* task)
+*   Inputs: task = process that owns the heap
+*   Return Value: none
+*	Function: goes back to the 4KB page table of a promoted heap, needed before
+*		part of it is unmapped
+*/
+void demote_heap(pcb_t* task){
+	if(!(task->large_regions & LARGE_HEAP))
+		return;
+	task->large_regions &= ~LARGE_HEAP;
+	count_demotion();
+	restore_task_paging(task);
+}
+
 /*
 * set_exeptions()
 *   Inputs: void
@@ -44,35 +104,21 @@ void set_pcbs(){
 */
 void set_exeptions(){
 	//32 reserved by intel but only 20 are defined
-	SET_IDT_ENTRY(idt[0], ex_0);
-	SET_IDT_ENTRY(idt[1], ex_1);
-	SET_IDT_ENTRY(idt[2], ex_2);
-	SET_IDT_ENTRY(idt[3], ex_3);
-	SET_IDT_ENTRY(idt[4], ex_4);
-	SET_IDT_ENTRY(idt[5], ex_5);
-	SET_IDT_ENTRY(idt[6], ex_6);
-	SET_IDT_ENTRY(idt[7], ex_7);
-	SET_IDT_ENTRY(idt[8], ex_8);
-	SET_IDT_ENTRY(idt[9], ex_9);
-	SET_IDT_ENTRY(idt[10], ex_10);
-	SET_IDT_ENTRY(idt[11], ex_11);
-	SET_IDT_ENTRY(idt[12], ex_12);
-	SET_IDT_ENTRY(idt[13], ex_13);
-	SET_IDT_ENTRY(idt[14], ex_14);
-	SET_IDT_ENTRY(idt[15], ex_15);
-	SET_IDT_ENTRY(idt[16], ex_16);
-	SET_IDT_ENTRY(idt[17], ex_17);
-	SET_IDT_ENTRY(idt[18], ex_18);
-	SET_IDT_ENTRY(idt[19], ex_19);
+	uint8_t i;
+	for(i = 0; i < 20; i++)
+		SET_IDT_ENTRY(idt[i], exception_entries[i]); 	//signals for user mode, else ex_#
+	SET_IDT_ENTRY(idt[7], fpu_trap_entry);	//lazy fpu switching, else ex_7
+	SET_IDT_ENTRY(idt[14], page_fault_entry);	//resolves swapped pages, else ex_14
+	SET_IDT_ENTRY(idt[PIT_IDT], ex_32);	//scheduler tick
 	SET_IDT_ENTRY(idt[KEYBOARD_IDT], ex_33);
 	SET_IDT_ENTRY(idt[RTC_IDT], ex_40);	//RTC
 	SET_IDT_ENTRY(idt[SYSTEM_CALL_IDT], ex_128);//system call
 
 	//for loop below sets up first 20 interrupt handlers
-	uint8_t i;
 	for(i = 0; i < 20; i++){
 		set_interrupt_gate(i);
 	}
+	set_interrupt_gate(PIT_IDT);
 	set_interrupt_gate(KEYBOARD_IDT);
 	set_interrupt_gate(RTC_IDT);
 	set_interrupt_gate(SYSTEM_CALL_IDT); //this needs a different dpl value since needs to be accessed by user space
@@ -223,6 +269,71 @@ void ex_14(){
 	printf("CR2= %x\n", addr);	//print the address of the page fault
 	ex_halt();
 }
+
+/*
+* int32_t page_fault_handler(uint32_t* eip)
+*   Inputs: eip = saved eip of the faulting instruction on the interrupt stack
+*   Return Value: 0 if the fault was handled, -1 if the fault is fatal
+*	Function: called from page_fault_entry. pages of the current process that
+*		were compressed into the swap pool are decompressed and mapped again, and
+*		untouched stack/bss pages of the program region get a zeroed frame.
+*		a bad user pointer hit inside the user copy routines resumes at their
+*		fixup. anything else goes to exception_handler, SEGFAULT for a process
+*		and ex_14 for the kernel
+*/
+int32_t page_fault_handler(uint32_t* eip){
+	uint32_t addr;		//address where cr2 will be stored
+	uint32_t fixup;
+	asm volatile(
+		"movl %%cr2, %%eax\n\
+		movl %%eax, %0"
+		:"=r"(addr)
+		:
+		:"eax"
+	);
+
+	if(map_user_page(addr) == 0)
+		return 0;
+	fixup = search_exception_table(*eip);
+	if(fixup == 0)
+		return -1;
+	*eip = fixup;
+	return 0;
+}
+
+/*
+* int32_t map_user_page(uint32_t addr)
+*   Inputs: addr = faulting address
+*   Return Value: 0 if the page is now mapped, -1 otherwise
+*	Function: brings back a swapped page or maps a demand zero page of the
+*		current process
+*/
+int32_t map_user_page(uint32_t addr){
+	pcb_t* task = curr_task[running_slot];
+	uint32_t* table;
+	uint32_t index, frame;
+
+	if(task == NULL)
+		return -1;
+	if(addr >= USER_HEAP_START && addr < USER_HEAP_END)
+		return swap_in(task->heap_table, (addr - USER_HEAP_START) / FRAME_SIZE);
+	if(addr < _128MB || addr >= _132MB || task->user_table == NULL)
+		return -1;
+
+	table = task->user_table;
+	index = (addr - _128MB) / FRAME_SIZE;
+	if(table[index] & PAGE_SWAPPED)
+		return swap_in(table, index);
+	if(table[index] != 0)
+		return -1; 			//protection fault, e.g. a write to shared text
+	//demand zero page
+	frame = alloc_zeroed_frame();
+	if(frame == NO_FRAME)
+		return -1;
+	table[index] = frame | USERREADPRESENT;
+	reset_cr3();
+	return 0;
+}
 void ex_15(){
 	ex_error();
 	printf("15: reserved?\n");
@@ -256,15 +367,11 @@ void ex_19(){
 *   Inputs: none
 *   Return Value: none
 *	Function: the rtc handler is called whenever there is an rtc interrupt,
-* the register is read, then the flag is returned to 0, and we end the interrupt
+* register C is read, the virtual rtcs are ticked, and we end the interrupt
 */
 void rtc_handler(){	//RTC
-	//have to read register C to allow interrupt to happen again
-	outb(RTC_REG_C, RTC_CMD);
-	//dont care about contents
-	inb(RTC_MEM);
 	//test_interrupts(); //for checkpoint 1 - in lib.c
-	interrupt_flag = 0; //clear flag now that interrupt is over
+	rtc_tick(); //reads register C, readers whose rtc ticked can run again
 	send_eoi(RTC_IRQ); //interrupt is over
 }
 
@@ -273,35 +380,67 @@ void rtc_handler(){	//RTC
 * int32_t sys_halt()
 *   Inputs: status, and 2 garbage values
 *   Return Value: the return value from the halted function
-*	Function: closes all open files, doesn't allow the last shell to be closed,
-*		the child task is set to current, and the program is halted
+*	Function: halts the program with the low byte of status
 */
 int32_t sys_halt(uint8_t status, int32_t garbage2, int32_t garbage3){
+	return process_halt(status);
+}
 
-	pid_used[current_terminal][curr_task[current_terminal]->process_id] = FREE; //pid no longer used
-	//close all open files before halting
+/*
+* int32_t process_halt(uint32_t status)
+*   Inputs: status = value execute returns to the parent, HALT_EXCEPTION for
+*		a process killed by a signal
+*   Return Value: none, returns from the parent's execute instead
+*	Function: closes all open files, a terminal whose last shell halts gets a
+*		new one, the parent task is set to current, and the program is halted
+*/
+int32_t process_halt(uint32_t status){
+	uint32_t used = stack_high_water(curr_task[running_slot]->process_id);
+	if(used > max_stack_used)
+		max_stack_used = used;
+
+	wait_cancel(curr_task[running_slot]); //may be halted while asleep
+	timer_del(&curr_task[running_slot]->sleep_timer);
+	signal_exit(curr_task[running_slot]);
+	acct_halt(curr_task[running_slot]);
+	fpu_release(curr_task[running_slot]);
+	//close all open files before halting, stdin and stdout may be pipe ends
 	uint8_t i;
-	for(i=PCB_START; i<PCB_END; i++)
-			sys_close(i, 0, 0);
-
-	//if process being killed is pid0, start shell again
+	for(i=0; i<PCB_END; i++)
+			fd_release(curr_task[running_slot], i);
+	//give the private program pages and the heap frames back to the pool
+	user_table_release(curr_task[running_slot]->user_table);
+	curr_task[running_slot]->user_table = NULL;
+	image_put(curr_task[running_slot]->image);
+	curr_task[running_slot]->image = NULL;
+	heap_release(curr_task[running_slot]->heap_table);
+	curr_task[running_slot]->heap_table = NULL;
+	//detach shared memory, segments with no other users are destroyed
+	shm_release(curr_task[running_slot]->shm_table, curr_task[running_slot]->shm_slots,
+			curr_task[running_slot]->process_id);
+	curr_task[running_slot]->shm_table = NULL;
+	//the pid is freed once this cpu is off its kernel stack, a new process
+	//then gets its PCB and stack
+	int32_t pid = curr_task[running_slot]->process_id;
+
+	//a terminal's shell or a background stage, nobody waits for it. the
+	//scheduler starts a new shell on an empty terminal
 	//halt terminates a process, returning the specified value to its parent process
-	if(curr_task[current_terminal]->parent_task == NULL){
-		curr_task[current_terminal] = NULL;
-		sys_execute((uint8_t*)"shell", 0,0);
-	}
+	if(curr_task[running_slot]->parent_task == NULL)
+		sched_exit(pid);
 
-	curr_task[current_terminal] = curr_task[current_terminal]->parent_task;
-	pcb_t* oldtask = curr_task[current_terminal]->child_task;
-	curr_task[current_terminal]->child_task = NULL;
+	pcb_t* oldtask = curr_task[running_slot];
+	oldtask->parent_task->child_task = NULL;
+	cli(); 	//stays on this cpu until the jump to the parent's stack
+	sched_place(running_slot, oldtask->parent_task);
 
-	//restore parents paging
-	uint32_t pde = calc_pde_val(8*current_terminal + curr_task[current_terminal]->process_id);
-	add_page(pde, VIRT_ADDR128_INDEX);
-	//set cr3 register - flush TLB
-	reset_cr3();
+	//restore parents paging and flush TLB
+	restore_task_paging(curr_task[running_slot]);
 
-	tss.esp0 = EIGHT_MB - ( (8*current_terminal + curr_task[current_terminal]->process_id) * EIGHT_KB);
+	set_kernel_stack(KERNEL_STACK_TOP(curr_task[running_slot]->process_id));
+	fpu_switch(curr_task[running_slot]);
+	kdata_task(curr_task[running_slot]->process_id, curr_task[running_slot]->terminal);
+	this_cpu()->dead_pid = pid; 	//freed at halt_ret_label
 	//jmp halt_ret_label
 	uint32_t ret = status;
 	//restore old ebp/esp values
@@ -325,11 +464,151 @@ int32_t sys_halt(uint8_t status, int32_t garbage2, int32_t garbage3){
 *   Inputs: command, and 2 garbage values
 *   Return Value: -1 on fail, 256 if program dies by an exception, 0 to 255 if
 *		program executes halt syscall
+*	Function: runs the program and waits for it, it gets the caller's stdin and stdout
+*/
+int32_t sys_execute(const uint8_t* command, int32_t garbage2, int32_t garbage3){
+	uint8_t kcommand[CHAR_BUFF_SIZE];
+	if(strncpy_from_user(kcommand, command, CHAR_BUFF_SIZE) == -1)
+		return -1;
+	return exec_program(kcommand, STDIN, STDOUT, running_slot);
+}
+
+/*
+* int32_t sys_execute_fds()
+*   Inputs: command, in_fd/out_fd = descriptors of the caller that become the
+*		program's stdin and stdout
+*   Return Value: same as execute
+*	Function: execute with redirection, the last stage of a shell pipeline
+*/
+int32_t sys_execute_fds(const uint8_t* command, int32_t in_fd, int32_t out_fd){
+	uint8_t kcommand[CHAR_BUFF_SIZE];
+	if(strncpy_from_user(kcommand, command, CHAR_BUFF_SIZE) == -1)
+		return -1;
+	return exec_program(kcommand, in_fd, out_fd, running_slot);
+}
+
+/*
+* int32_t sys_spawn()
+*   Inputs: command, in_fd/out_fd = descriptors of the caller that become the
+*		program's stdin and stdout
+*   Return Value: pid of the new process, -1 on fail
+*	Function: starts the program in a background slot on the caller's terminal
+*		and returns right away, nobody waits for it to halt. the early stages
+*		of a shell pipeline
+*/
+int32_t sys_spawn(const uint8_t* command, int32_t in_fd, int32_t out_fd){
+	uint8_t kcommand[CHAR_BUFF_SIZE];
+	int32_t slot, pid;
+
+	if(strncpy_from_user(kcommand, command, CHAR_BUFF_SIZE) == -1)
+		return -1;
+	slot = sched_claim_slot(MAX_TERMINALS, MAX_SLOTS);
+	if(slot == -1)
+		return -1; 		//every background slot is busy
+	pid = exec_program(kcommand, in_fd, out_fd, slot);
+	if(pid == -1)
+		sched_unclaim(slot);
+	return pid;
+}
+
+/*
+* int32_t start_shell(int32_t terminal)
+*   Inputs: terminal = terminal without a process
+*   Return Value: pid of the shell, -1 on fail
+*	Function: starts a shell in the terminal's slot. called by the scheduler
+*		at boot and after the shell of the terminal halted
+*/
+int32_t start_shell(int32_t terminal){
+	int32_t pid;
+
+	if(sched_claim_slot(terminal, terminal + 1) == -1)
+		return -1; 		//another cpu is starting it
+	pid = exec_program((uint8_t*)"shell", STDIN, STDOUT, terminal);
+	if(pid == -1)
+		sched_unclaim(terminal);
+	return pid;
+}
+
+/*
+* int32_t redirect_ok(pcb_t* parent, int32_t fd, int32_t dir)
+*   Inputs: parent = process handing out the descriptor, fd = its descriptor
+*		dir = READ for a new stdin, WRITE for a new stdout
+*   Return Value: 0 if the descriptor can be shared, -1 otherwise
+*	Function: only terminal and pipe descriptors can, nothing else keeps a
+*		count of its users
+*/
+static int32_t redirect_ok(pcb_t* parent, int32_t fd, int32_t dir){
+	operations_table_t* opt;
+
+	if(fd < 0 || fd >= PCB_END || parent->file_array[fd].flags == FREE)
+		return -1;
+	opt = parent->file_array[fd].opt;
+	if(dir == READ)
+		return (opt == &stdin_operations || opt == &pipe_read_operations) ? 0 : -1;
+	return (opt == &stdout_operations || opt == &pipe_write_operations) ? 0 : -1;
+}
+
+/*
+* void inherit_fd(pcb_t* child, int32_t fd, pcb_t* parent, int32_t parent_fd)
+*   Inputs: child = new process, fd = its stdin or stdout
+*		parent = process starting it, parent_fd = descriptor checked by redirect_ok
+*   Return Value: none
+*	Function: both share the open terminal or pipe end
+*/
+static void inherit_fd(pcb_t* child, int32_t fd, pcb_t* parent, int32_t parent_fd){
+	file_descriptor_t* file = &child->file_array[fd];
+
+	*file = parent->file_array[parent_fd];
+	if(file->opt == &pipe_read_operations)
+		pipe_dup(file->device, PIPE_READ);
+	else if(file->opt == &pipe_write_operations)
+		pipe_dup(file->device, PIPE_WRITE);
+}
+
+/*
+* void spawn_frame(pcb_t* task, uint32_t entry)
+*   Inputs: task = new background process, entry = its first instruction
+*   Return Value: none
+*	Function: builds the kernel stack the first switch_to into the process
+*		finds. it returns into switch_to_new, on to signal_return, whose iret
+*		starts the program
+*/
+static void spawn_frame(pcb_t* task, uint32_t entry){
+	regs_t* regs = user_regs(task);
+	uint32_t* stack = (uint32_t*)regs;
+
+	memset(regs, 0, sizeof(regs_t));
+	regs->vector = SYSTEM_CALL_IDT;
+	regs->eip = entry;
+	regs->cs = USER_CS;
+	regs->eflags = IF_FLAG | EFLAGS_BASE;
+	regs->esp = USER_STACK_ADDR;
+	regs->ss = USER_DS;
+
+	*--stack = (uint32_t)switch_to_new;
+	*--stack = 0; 	//ebp
+	*--stack = 0; 	//ebx
+	*--stack = 0; 	//esi
+	*--stack = 0; 	//edi
+	task->registers.esp = (uint32_t)stack;
+}
+
+/*
+* int32_t exec_program()
+*   Inputs: command = program and arguments, already copied into the kernel
+*		in_fd/out_fd = descriptors of the caller that become stdin and stdout
+*		slot = the running one to wait for the program, else an empty slot
+*		claimed for it, which it starts in without waiting
+*   Return Value: -1 on fail, 256 if program dies by an exception, 0 to 255 if
+*		program executes halt syscall, the pid for a program in another slot
 *	Function: attempts to load and execute new program by parsing the command string,
 *		command is space separated sequence of words - first word is file name of program,
-*		rest of command - stripped of leading spaces, is provided to program on request via getargs syscall
+*		rest of command - stripped of leading spaces, is provided to program on request via getargs syscall.
+*		execute's halt_ret_label returns from here, so it must stay a real call
 */
-int32_t sys_execute(const uint8_t* command, int32_t garbage2, int32_t garbage3){
+static int32_t exec_program(const uint8_t* command, int32_t in_fd, int32_t out_fd, int32_t slot){
+	pcb_t* parent = curr_task[running_slot];
+	int32_t background = (slot != running_slot);
 	/*parse, exe check, set up paging, file loader, new pcb,
 	context switch - write tss.esp0/ebp0 with new process kernel stack?
 		save current esp/ebp or anything needed in pcb
@@ -341,10 +620,18 @@ int32_t sys_execute(const uint8_t* command, int32_t garbage2, int32_t garbage3){
 	//check for command string
 	if(command == NULL)
 		return -1;
+	//the first shell of a terminal has nothing to inherit
+	if(background && slot < MAX_TERMINALS)
+		parent = NULL;
+	if(parent != NULL && (redirect_ok(parent, in_fd, READ) != 0 || redirect_ok(parent, out_fd, WRITE) != 0))
+		return -1;
 	//parse name of program and arguments
 	uint32_t i;
+	uint32_t length = strlen((int8_t *)command);
 	uint8_t argsflag = 0;
-	for(i = 0; i < strlen((int8_t *)command); i++){
+	if(length >= CHAR_BUFF_SIZE)
+		return -1; 		//too long for the program and arguments buffers
+	for(i = 0; i < length; i++){
 		if(command[i] == ' '){	//find location of first space, when found break so i will contain the location
 			//check for args and get index where command ends and args start
 			argsflag = 1;
@@ -364,10 +651,10 @@ int32_t sys_execute(const uint8_t* command, int32_t garbage2, int32_t garbage3){
 		strncpy(program, (int8_t *) command, i);
 		program[i] = '\0';
 		i++; //increment index to start of args rather than where first space is
-		strncpy((int8_t *)arguments, (int8_t *) (command + i), strlen((int8_t *)command) - i);
+		strncpy((int8_t *)arguments, (int8_t *) (command + i), length - i);
 	}
 	else //no args
-		strncpy(program, (int8_t *)command, strlen((int8_t *) command) + 1); //+1 copies over null terminator
+		strncpy(program, (int8_t *)command, length + 1); //+1 copies over null terminator
 
 
 	//done parsing arguments, make sure executable
@@ -381,45 +668,81 @@ int32_t sys_execute(const uint8_t* command, int32_t garbage2, int32_t garbage3){
 	if(buffer[0] != MAGIC_NUM_FOR_EXE0 || buffer[1] != MAGIC_NUM_FOR_EXE1 || buffer[2] != MAGIC_NUM_FOR_EXE2 || buffer[3] != MAGIC_NUM_FOR_EXE3)
 		return -1;
 	//if reach here file exists and is executable
-	//set up paging
-	if(get_next_pid() == -1)
+	//File Loader - read only pages come from the image cache and are shared
+	//with other running copies of the program, the rest is copied privately
+	image_t* image = image_get(fileinfo.inode_number);
+	if(image == NULL)
 		return -1;
-	uint32_t pde;
-	if(curr_task[current_terminal]==NULL)
-		pde = calc_pde_val(8*current_terminal);
-	else
-		pde = calc_pde_val(8*current_terminal + get_next_pid());	//will need to change later
-	add_page(pde, VIRT_ADDR128_INDEX);
+	uint32_t* user_table = (uint32_t*) alloc_zeroed_frame();
+	if(user_table == NULL || image_map(image, user_table) == -1){
+		user_table_release(user_table);
+		image_put(image);
+		return -1;
+	}
+	int32_t pid = alloc_pid();
+	if(pid == -1){
+		user_table_release(user_table);
+		image_put(image);
+		return -1;
+	}
 
-	//set cr3 register
-	reset_cr3();
+	if(background){
+		//starts when the scheduler gets to its slot, the caller keeps its paging
+		pcb_t* task = (pcb_t*) PCB_ADDR(pid);
+		read_data(fileinfo.inode_number, MAGIC_NUM_INDEX0, buffer, 4);
+		new_pcb(pid, arguments, slot);
+		strncpy((int8_t*)task->name, program, PROC_NAME_LEN - 1);
+		task->user_table = user_table;
+		task->image = image;
+		if(parent != NULL){
+			inherit_fd(task, STDIN, parent, in_fd);
+			inherit_fd(task, STDOUT, parent, out_fd);
+		}
+		spawn_frame(task, (buffer[3] << 24) + (buffer[2] << 16) + (buffer[1] << 8) + buffer[0]);
+		sched_place(slot, task); 	//an idle cpu may take it
+		return pid;
+	}
 
-	//File Loader
+	//set up paging and set cr3 register
+	add_page(((uint32_t) user_table) | USERREADPRESENT, VIRT_ADDR128_INDEX);
+	reset_cr3();
 	uint8_t *progbuf = (uint8_t*) PROG_EXEC_ADDR;
-	uint32_t filelength = read_file_length(fileinfo.inode_number);
-	read_data(fileinfo.inode_number, 0, progbuf, filelength);
 
 	//New PCB
-	new_pcb(arguments);
+	new_pcb(pid, arguments, slot);
+	sched_place(slot, (pcb_t*) PCB_ADDR(pid));
+	strncpy((int8_t*)curr_task[running_slot]->name, program, PROC_NAME_LEN - 1);
+	curr_task[running_slot]->user_table = user_table;
+	curr_task[running_slot]->image = image;
+	if(parent != NULL){
+		inherit_fd(curr_task[running_slot], STDIN, parent, in_fd);
+		inherit_fd(curr_task[running_slot], STDOUT, parent, out_fd);
+	}
+	//new process starts with an empty heap and no shared memory
+	set_heap_table(NULL, 0);
+	set_shm_table(NULL);
+	reset_cr3();
 
 	//context switch
 
 	//need to get execution point - stored li
-	curr_task[current_terminal]->eip = (progbuf[MAGIC_NUM_INDEX3] << 24) + (progbuf[MAGIC_NUM_INDEX2] << 16) + (progbuf[MAGIC_NUM_INDEX1] << 8) + (progbuf[MAGIC_NUM_INDEX0]);
+	curr_task[running_slot]->eip = (progbuf[MAGIC_NUM_INDEX3] << 24) + (progbuf[MAGIC_NUM_INDEX2] << 16) + (progbuf[MAGIC_NUM_INDEX1] << 8) + (progbuf[MAGIC_NUM_INDEX0]);
 
 	//need to save old ebp/esp into pcb
 	asm volatile(
 		"movl %%esp, %0"
-		:"=r"(curr_task[current_terminal]->esp)
+		:"=r"(curr_task[running_slot]->esp)
 	);
 	asm volatile(
 		"movl %%ebp, %0"
-		:"=r"(curr_task[current_terminal]->ebp)
+		:"=r"(curr_task[running_slot]->ebp)
 	);
 
 	//set tss stuff
-	tss.ss0 = KERNEL_DS;
-	tss.esp0 = EIGHT_MB - ((8*current_terminal + curr_task[current_terminal]->process_id) * EIGHT_KB); //see kernel.c, x86_desc for tss info
+	set_kernel_stack(KERNEL_STACK_TOP(curr_task[running_slot]->process_id)); //see kernel.c, x86_desc for tss info
+	fpu_switch(curr_task[running_slot]); //first fpu use traps and gets a clean state
+	kdata_task(curr_task[running_slot]->process_id, curr_task[running_slot]->terminal);
+	cli(); 	//the iret turns interrupts back on in the new process
 
 	uint32_t user_stack = USER_STACK_ADDR;
 	//push IRET context onto stack, not positive my eip/esp values are correct
@@ -435,14 +758,18 @@ int32_t sys_execute(const uint8_t* command, int32_t garbage2, int32_t garbage3){
 		iret \n\
 		"
 		:
-		: "r" (USER_DS), "r" (user_stack), "r" (IF_FLAG), "r" (USER_CS), "r" (curr_task[current_terminal]->eip)
+		: "r" (USER_DS), "r" (user_stack), "r" (IF_FLAG), "r" (USER_CS), "r" (curr_task[running_slot]->eip)
 		: "eax", "memory", "cc"
 	);
 
 
-	//IRET, halt_ret_label, RET
+	//IRET, halt_ret_label, RET. halt comes here on the parent's stack with
+	//the status in eax, the child's stack is free to reuse now
 	asm volatile(
 		"HALT_RET_LABEL: \n\
+		pushl %eax \n\
+		call sched_reap \n\
+		popl %eax \n\
 		leave \n\
 		ret \n\
 		"
@@ -461,12 +788,12 @@ int32_t sys_execute(const uint8_t* command, int32_t garbage2, int32_t garbage3){
 */
 int32_t sys_read(int32_t fd, void* buf, int32_t nbytes){
 	// fd has to be in range AND fd cannot be 1 (stdout)
-	if(fd < STDIN || fd >= PCB_END  || fd == STDOUT || nbytes <= 0 || curr_task[current_terminal]->file_array[fd].flags == FREE)
+	if(fd < STDIN || fd >= PCB_END  || fd == STDOUT || nbytes <= 0 || curr_task[running_slot]->file_array[fd].flags == FREE)
 		return -1;
-	if(curr_task[current_terminal]->file_array[fd].opt->read == NULL)
+	if(curr_task[running_slot]->file_array[fd].opt->read == NULL)
 		return -1;
 
-	return curr_task[current_terminal]->file_array[fd].opt->read(fd, buf, nbytes);
+	return curr_task[running_slot]->file_array[fd].opt->read(fd, buf, nbytes);
 }
 
 /*
@@ -478,12 +805,12 @@ int32_t sys_read(int32_t fd, void* buf, int32_t nbytes){
 */
 int32_t sys_write(int32_t fd, const void* buf, int32_t nbytes){
 	//can't be negative or stdin(0) and has to be in use
-	if(fd <= STDIN || fd >= PCB_END || curr_task[current_terminal]->file_array[fd].flags == FREE)
+	if(fd <= STDIN || fd >= PCB_END || curr_task[running_slot]->file_array[fd].flags == FREE)
 		return -1;
-	if(curr_task[current_terminal]->file_array[fd].opt->write == NULL)
+	if(curr_task[running_slot]->file_array[fd].opt->write == NULL)
 		return -1;
 
-	return curr_task[current_terminal]->file_array[fd].opt->write(fd, (uint8_t*)buf, nbytes);
+	return curr_task[running_slot]->file_array[fd].opt->write(fd, (uint8_t*)buf, nbytes);
 }
 
 /*
@@ -497,13 +824,17 @@ int32_t sys_open(const uint8_t* filename, int32_t garbage2, int32_t garbage3){
 	dentry_t temp;
 	uint32_t fd;
 	uint32_t curr_available = INVALID;
+	uint8_t name[MAX_FILE_NAME_LENGTH + 1];
+	//copy the name in, a name longer than the max can't exist
+	if (strncpy_from_user(name, filename, MAX_FILE_NAME_LENGTH + 1) == -1)
+		return -1;
 	//check if file exists
-	if (read_dentry_by_name(filename, &temp) == INVALID){
+	if (read_dentry_by_name(name, &temp) == INVALID){
 		return -1; 				//return value for file doesn't exist
 	}
 
 	for(fd = PCB_START; fd<PCB_END; fd++){ 		//go through the file array for the current pcb
-		if(curr_task[current_terminal]->file_array[fd].flags == FREE){//when a free fd is found, assign it to curr_available and break
+		if(curr_task[running_slot]->file_array[fd].flags == FREE){//when a free fd is found, assign it to curr_available and break
 			curr_available = fd;
 			break;
 		}
@@ -513,28 +844,32 @@ int32_t sys_open(const uint8_t* filename, int32_t garbage2, int32_t garbage3){
 		return -1;
 
 	//SET INODE NUMBER
-	curr_task[current_terminal]->file_array[curr_available].inode_number = temp.inode_number;
-	curr_task[current_terminal]->file_array[curr_available].flags = USED;
+	curr_task[running_slot]->file_array[curr_available].inode_number = temp.inode_number;
+	curr_task[running_slot]->file_array[curr_available].flags = USED;
 
 
 	switch(temp.file_type){
 		case 0:
-			curr_task[current_terminal]->file_array[curr_available].opt =  &rtc_operations;
-			rtc_open(0, NULL, 0);
+			curr_task[running_slot]->file_array[curr_available].opt =  &rtc_operations;
+			if(rtc_open(curr_available, NULL, 0) == -1){
+				curr_task[running_slot]->file_array[curr_available].opt = NULL;
+				curr_task[running_slot]->file_array[curr_available].flags = FREE;
+				return -1; 		//every virtual rtc is in use
+			}
 			break;
 
 		case 1:
-			curr_task[current_terminal]->file_array[curr_available].opt = &dir_operations;  //CHECK THIS <====================
+			curr_task[running_slot]->file_array[curr_available].opt = &dir_operations;  //CHECK THIS <====================
 			open_dir(curr_available, NULL, 0);
 			break;
 
 		case 2:
-			curr_task[current_terminal]->file_array[curr_available].opt = &file_operations;  //CHECK THIS <====================
+			curr_task[running_slot]->file_array[curr_available].opt = &file_operations;  //CHECK THIS <====================
 			open_file(curr_available, NULL, 0);
 			break;
 
 		default:
-			curr_task[current_terminal]->file_array[curr_available].opt = &stdin_operations;
+			curr_task[running_slot]->file_array[curr_available].opt = &stdin_operations;
 			terminal_open(0, NULL, 0);
 			break;
 
@@ -555,14 +890,63 @@ int32_t sys_close(int32_t fd, int32_t garbage2, int32_t garbage3){
 	if (fd <= STDIN || fd ==  STDOUT || fd > 7)
 		return -1;
 
-	if(curr_task[current_terminal]->file_array[fd].flags == FREE)
+	if(curr_task[running_slot]->file_array[fd].flags == FREE)
 		return -1;
 
-	curr_task[current_terminal]->file_array[fd].opt = NULL;
-	curr_task[current_terminal]->file_array[fd].inode_number = INVALID_INODE;
-	curr_task[current_terminal]->file_array[fd].file_position = NULL;
-	curr_task[current_terminal]->file_array[fd].flags = FREE;
+	fd_release(curr_task[running_slot], fd);
+	return 0;
+}
+
+/*
+* void fd_release(pcb_t* task, int32_t fd)
+*   Inputs: task = current process, fd = any of its descriptors
+*   Return Value: none
+*	Function: lets the driver release what it set up in open and frees the
+*		descriptor, halt uses it on stdin and stdout too
+*/
+static void fd_release(pcb_t* task, int32_t fd){
+	if(task->file_array[fd].flags == FREE)
+		return;
+	if(task->file_array[fd].opt->close != NULL)
+		task->file_array[fd].opt->close(fd, NULL, 0);
+	task->file_array[fd].opt = NULL;
+	task->file_array[fd].inode_number = INVALID_INODE;
+	task->file_array[fd].file_position = NULL;
+	task->file_array[fd].flags = FREE;
+}
 
+/*
+* int32_t sys_pipe()
+*   Inputs: fds = gets the read end and then the write end
+*   Return Value: 0 on success, -1 on fail
+*	Function: makes a pipe and opens both ends in the lowest free descriptors
+*/
+int32_t sys_pipe(int32_t* fds, int32_t garbage2, int32_t garbage3){
+	pcb_t* task = curr_task[running_slot];
+	int32_t ends[2];
+	int32_t fd, n = 0;
+	int32_t pipe;
+
+	for(fd = PCB_START; fd < PCB_END && n < 2; fd++){
+		if(task->file_array[fd].flags == FREE)
+			ends[n++] = fd;
+	}
+	if(n < 2 || (pipe = pipe_create()) == -1)
+		return -1;
+
+	task->file_array[ends[PIPE_READ]].opt = &pipe_read_operations;
+	task->file_array[ends[PIPE_WRITE]].opt = &pipe_write_operations;
+	for(n = 0; n < 2; n++){
+		task->file_array[ends[n]].inode_number = INVALID_INODE;
+		task->file_array[ends[n]].file_position = 0;
+		task->file_array[ends[n]].device = pipe;
+		task->file_array[ends[n]].flags = USED;
+	}
+	if(copy_to_user(fds, ends, sizeof(ends)) != 0){
+		fd_release(task, ends[PIPE_READ]);
+		fd_release(task, ends[PIPE_WRITE]);
+		return -1;
+	}
 	return 0;
 }
 
@@ -574,14 +958,10 @@ int32_t sys_close(int32_t fd, int32_t garbage2, int32_t garbage3){
 */
 int32_t sys_getargs(uint8_t* buf, int32_t nbytes, int32_t garbage3){
 	//fail if null buff pointer
-	if (buf == NULL)
+	if (buf == NULL || nbytes <= 0)
 		return -1;
 
-	int i;
-	for(i=0; i<nbytes; i++)	//clear buff
-		buf[i] = '\0';
-
-	uint8_t* arguments = curr_task[current_terminal]->arg;
+	uint8_t* arguments = curr_task[running_slot]->arg;
 	if(arguments[0] == '\0')
 		return -1;
 
@@ -590,9 +970,9 @@ int32_t sys_getargs(uint8_t* buf, int32_t nbytes, int32_t garbage3){
 	//fits in buffer?
 	if (nbytes <= arg_length)
 		return -1;
-	//copy arguments to buffer
-	for(i=0; i<arg_length; i++)
-		buf[i] = arguments[i];
+	//copy arguments and their terminator to buffer
+	if(copy_to_user(buf, arguments, arg_length + 1) != 0)
+		return -1;
 
 	return 0;
 }
@@ -604,68 +984,367 @@ int32_t sys_getargs(uint8_t* buf, int32_t nbytes, int32_t garbage3){
 *	Function: checks for errors, maps video memory into user space
 */
 int32_t sys_vidmap(uint8_t** screen_start, int32_t garbage2, int32_t garbage3){
-	//check to make sure screen_start is a valid address, should it be > or >=?
-	if(screen_start < (uint8_t **) _128MB || screen_start >= (uint8_t **) _132MB)
+	uint8_t* video = (uint8_t*) _132MB; //want screen_start to point to 4kb thats at 132MB
+
+	//fails on a bad pointer before anything is mapped
+	if(copy_to_user(screen_start, &video, sizeof(video)) != 0)
 		return -1;
 
 	add_vidpage();
-	*screen_start = (uint8_t*) _132MB; //want screen_start to point to 4kb thats at 132MB
 	return 0;
 }
 
 /*
 * int32_t sys_set_handler()
-*   Inputs: signal number, handler address
-*   Return Value: -1 since never written
-*	Function:
+*   Inputs: signum = signal number, handler_address = user function to run for
+*		it, NULL restores the default action
+*   Return Value: 0 on success, -1 on a bad signal number
+*	Function: installs a signal handler for the current process
 */
 int32_t sys_set_handler(int32_t signum, void* handler_address, int32_t garbage3){
-
-	return -1;
+	return set_handler(signum, handler_address);
 }
 
 /*
 * int32_t sys_sigreturn()
 *   Inputs: 3 garbage values
-*   Return Value: -1 since never written
-*	Function:
+*   Return Value: eax of the code the signal interrupted, -1 outside a handler
+*	Function: called by the trampoline a handler returns into, restores the
+*		registers saved in its frame
 */
 int32_t sys_sigreturn(int32_t garbage1, int32_t garbage2, int32_t garbage3){
+	return sigreturn(user_regs(curr_task[running_slot]));
+}
+
+/*
+* int32_t sys_alarm()
+*   Inputs: ms = period of the ALARM signal in ms, 0 stops it
+*   Return Value: the previous period, -1 if out of range
+*	Function: ALARM is raised every ms while the process has a handler for it
+*/
+int32_t sys_alarm(uint32_t ms, int32_t garbage2, int32_t garbage3){
+	return set_alarm(ms);
+}
+
+/*
+* int32_t sys_sbrk()
+*   Inputs: increment = number of bytes to grow (or shrink if negative) the heap by
+*   Return Value: previous end of the heap on success, -1 on fail
+*	Function: moves the end of the heap of the current process, mapping zeroed
+*		pages when it grows and freeing pages when it shrinks
+*/
+int32_t sys_sbrk(int32_t increment, int32_t garbage2, int32_t garbage3){
+	pcb_t* task = curr_task[running_slot];
+	uint32_t old_brk = task->heap_brk;
+	uint32_t new_brk = old_brk + increment;
+
+	//heap can't move below its start or past the end of its page table
+	if((increment < 0 && new_brk > old_brk) || (increment > 0 && new_brk < old_brk))
+		return -1;
+	if(new_brk < USER_HEAP_START || new_brk > USER_HEAP_END)
+		return -1;
+
+	if(new_brk > old_brk){
+		if(heap_grow(&task->heap_table, old_brk, new_brk) == -1)
+			return -1;
+		restore_task_paging(task);
+	}
+	else if(new_brk < old_brk){
+		//a partial unmap splits a promoted heap back into 4KB pages
+		demote_heap(task);
+		heap_shrink(task->heap_table, old_brk, new_brk);
+	}
+
+	task->heap_brk = new_brk;
+	//a completely filled heap becomes a single large page
+	if(new_brk == USER_HEAP_END)
+		promote_heap(task);
+	return old_brk;
+}
+
+/*
+* int32_t sys_shm_create()
+*   Inputs: name = name of the segment, size = size of the segment in bytes
+*   Return Value: segment id on success, -1 on fail
+*	Function: finds or creates the named shared memory segment
+*/
+int32_t sys_shm_create(const uint8_t* name, uint32_t size, int32_t garbage3){
+	uint8_t kname[SHM_NAME_LEN];
+	if(strncpy_from_user(kname, name, SHM_NAME_LEN) == -1)
+		return -1;
+	return shm_create(kname, size, curr_task[running_slot]->process_id);
+}
+
+/*
+* int32_t sys_shm_attach()
+*   Inputs: id = segment id from shm_create
+*   Return Value: address the segment is mapped at on success, -1 on fail
+*	Function: maps the segment into the current process
+*/
+int32_t sys_shm_attach(int32_t id, int32_t garbage2, int32_t garbage3){
+	pcb_t* task = curr_task[running_slot];
+	return shm_attach(&task->shm_table, task->shm_slots, id);
+}
+
+/*
+* int32_t sys_shm_detach()
+*   Inputs: addr = address returned by shm_attach
+*   Return Value: 0 on success, -1 on fail
+*	Function: unmaps the segment from the current process
+*/
+int32_t sys_shm_detach(uint32_t addr, int32_t garbage2, int32_t garbage3){
+	pcb_t* task = curr_task[running_slot];
+	return shm_detach(task->shm_table, task->shm_slots, addr);
+}
 
-	return -1;
+/*
+* int32_t sys_memstat()
+*   Inputs: buf = struct to fill in
+*   Return Value: 0 on success, -1 on fail
+*	Function: reports frames by owner, and frames and kernel stack use of every
+*		process. counts are taken by walking the owners' tables when asked so
+*		the allocation paths don't pay for the bookkeeping
+*/
+int32_t sys_memstat(mem_stats_t* buf, int32_t garbage2, int32_t garbage3){
+	mem_stats_t stats;
+	zero_pool_stats_t zero;
+	swap_stats_t swap;
+	large_page_stats_t large;
+	pcb_t* task;
+	int32_t pid;
+	uint32_t used;
+
+	get_zero_pool_stats(&zero);
+	get_swap_stats(&swap);
+	get_large_page_stats(&large);
+	stats.pool_frames = pool_frame_count();
+	stats.free_frames = free_frame_count();
+	stats.zero_frames = zero.count;
+	stats.zero_hits = zero.hits;
+	stats.zero_misses = zero.misses;
+	stats.cache_frames = image_cache_frames();
+	stats.shm_frames = shm_frames();
+	stats.swap_frames = swap.pool_frames;
+	stats.video_frames = VIDEO_FRAMES;
+	stats.stack_size = EIGHT_KB - sizeof(pcb_t);
+	stats.max_stack_used = max_stack_used;
+	stats.promotions = large.promotions;
+	stats.demotions = large.demotions;
+	stats.copied = large.copied;
+	stats.process_frames = 0;
+	stats.num_procs = 0;
+
+	for(pid = 0; pid < MAX_PROCESSES; pid++){
+		task = process_table[pid];
+		if(task == NULL)
+			continue;
+		stats.procs[stats.num_procs].pid = pid;
+		stats.procs[stats.num_procs].terminal = task->terminal;
+		//shared memory pages belong to the segment, only the table is private
+		stats.procs[stats.num_procs].frames = table_frame_count(task->user_table)
+			+ table_frame_count(task->heap_table) + (task->shm_table != NULL);
+		used = stack_high_water(pid);
+		stats.procs[stats.num_procs].stack_used = used;
+		if(used > stats.max_stack_used)
+			stats.max_stack_used = used;
+		stats.process_frames += stats.procs[stats.num_procs].frames;
+		stats.num_procs++;
+	}
+
+	//whatever is left of the pool is kernel owned
+	stats.kernel_frames = KERNEL_PAGE_FRAMES + stats.pool_frames - stats.free_frames - stats.zero_frames
+		- stats.process_frames - stats.cache_frames - stats.shm_frames - stats.swap_frames;
+
+	if(copy_to_user(buf, &stats, sizeof(stats)) != 0)
+		return -1;
+	return 0;
 }
 
 /*
-* int32_t get_next_pid()
+* int32_t sys_clock_gettime()
+*   Inputs: clock = CLOCK_REALTIME or CLOCK_MONOTONIC
+*		ts = gets the time
+*   Return Value: 0 on success, -1 on fail
+*	Function: reads the time since 1970, or the time since boot which never
+*		jumps
+*/
+int32_t sys_clock_gettime(int32_t clock, timespec_t* ts, int32_t garbage3){
+	timespec_t now;
+
+	if(clock == CLOCK_REALTIME)
+		clock_realtime(&now);
+	else if(clock == CLOCK_MONOTONIC)
+		ns_to_timespec(clock_ns(), &now);
+	else
+		return -1;
+	if(copy_to_user(ts, &now, sizeof(now)) != 0)
+		return -1;
+	return 0;
+}
+
+/*
+* void nanosleep_wake(ktimer_t* timer)
+*   Inputs: timer = sleep timer of a process
+*   Return Value: none
+*	Function: ends the nanosleep of the process the timer belongs to
+*/
+static void nanosleep_wake(ktimer_t* timer){
+	uint32_t flags;
+
+	spin_lock_irqsave(&sleep_lock, flags);
+	wake_up(&((pcb_t*)timer->data)->sleep_wait);
+	spin_unlock_irqrestore(&sleep_lock, flags);
+}
+
+/*
+* int32_t sys_nanosleep()
+*   Inputs: req = time to sleep
+*		rem = gets the time left when the sleep ends early, may be NULL
+*   Return Value: 0 on success, -1 on fail or when a signal ends the sleep early
+*	Function: blocks the process until the time has passed, other processes
+*		run in the meantime
+*/
+int32_t sys_nanosleep(const timespec_t* req, timespec_t* rem, int32_t garbage3){
+	pcb_t* task = curr_task[running_slot];
+	timespec_t ts;
+	uint64_t expires, now, left;
+	uint32_t flags;
+	int32_t ret = 0;
+
+	if(copy_from_user(&ts, req, sizeof(ts)) != 0 || ts.nsec >= NSEC_PER_SEC)
+		return -1;
+	expires = clock_ns() + (uint64_t)ts.sec * NSEC_PER_SEC + ts.nsec;
+
+	timer_add(&task->sleep_timer, expires);
+	//the timer can't fire between the check and sleeping, its wakeup waits
+	//for the lock
+	spin_lock_irqsave(&sleep_lock, flags);
+	while(timer_pending(&task->sleep_timer)){
+		if(signal_pending(task)){
+			ret = -1;
+			break;
+		}
+		sleep_on(&task->sleep_wait, &sleep_lock);
+	}
+	spin_unlock_irqrestore(&sleep_lock, flags);
+	if(ret == -1)
+		timer_del(&task->sleep_timer);
+
+	now = clock_ns();
+	left = (ret == -1 && expires > now) ? expires - now : 0;
+	ns_to_timespec(left, &ts);
+	if(rem != NULL && copy_to_user(rem, &ts, sizeof(ts)) != 0)
+		return -1;
+	return ret;
+}
+
+/*
+* int32_t sys_schedstat()
+*   Inputs: buf = struct to fill in
+*   Return Value: 0 on success, -1 on fail
+*	Function: reports scheduler counters and how much of the time the cpu idled
+*/
+int32_t sys_schedstat(sched_stats_t* buf, int32_t garbage2, int32_t garbage3){
+	sched_stats_t stats;
+
+	get_sched_stats(&stats);
+	if(copy_to_user(buf, &stats, sizeof(stats)) != 0)
+		return -1;
+	return 0;
+}
+
+/*
+* int32_t sys_getrusage()
+*   Inputs: who = pid of any process, RUSAGE_SELF, or RUSAGE_CHILDREN for
+*		the halted children of the caller, buf = user struct to fill in
+*   Return Value: 0 on success, -1 on a bad pid or buffer
+*	Function: reports cpu time, context switches and state of a process
+*/
+int32_t sys_getrusage(int32_t who, rusage_t* buf, int32_t garbage3){
+	rusage_t usage;
+
+	if(get_rusage(who, &usage) != 0)
+		return -1;
+	if(copy_to_user(buf, &usage, sizeof(usage)) != 0)
+		return -1;
+	return 0;
+}
+
+/*
+* int32_t sys_lockstat()
+*   Inputs: buf = array of lock stats to fill in, max = its length
+*   Return Value: number of locks reported, -1 on fail
+*	Function: reports how often each spinlock was taken, waited for and held
+*/
+int32_t sys_lockstat(lock_stats_t* buf, int32_t max, int32_t garbage3){
+	lock_stats_t stats[MAX_LOCKS];
+	int32_t n;
+
+	if(max < 0)
+		return -1;
+	n = get_lock_stats(stats, max < MAX_LOCKS ? max : MAX_LOCKS);
+	if(copy_to_user(buf, stats, n * sizeof(lock_stats_t)) != 0)
+		return -1;
+	return n;
+}
+
+/*
+* int32_t alloc_pid()
 *   Inputs: none
-*   Return Value: process id(value from 0-5), or -1 on fail
-*	Function: helper function to return the next free process id for the current termninal
+*   Return Value: free global process id, or -1 if the process table is full
+*	Function: pops a pid off the free pid stack, any terminal can use any pid
 */
-int32_t get_next_pid(){
-	int i;
-	for(i=0; i<MAX_PCBS; i++){
-		if(pid_used[current_terminal][i] == FREE)
-			return i;
+int32_t alloc_pid(){
+	int32_t pid = -1;
+	uint32_t flags;
+
+	spin_lock_irqsave(&proc_lock, flags);
+	if(num_free_pids > 0)
+		pid = free_pids[--num_free_pids];
+	spin_unlock_irqrestore(&proc_lock, flags);
+	return pid;
+}
+
+/*
+* void free_pid(int32_t pid)
+*   Inputs: pid = process id of a halting process
+*   Return Value: none
+*	Function: removes the process from the process table and pushes its pid back
+*		onto the free pid stack
+*/
+void free_pid(int32_t pid){
+	uint32_t flags;
+
+	if(pid < 0 || pid >= MAX_PROCESSES)
+		return;
+	spin_lock_irqsave(&proc_lock, flags);
+	if(process_table[pid] != NULL){
+		process_table[pid] = NULL;
+		free_pids[num_free_pids++] = pid;
 	}
-	return -1;
+	spin_unlock_irqrestore(&proc_lock, flags);
 }
 
 /*
 * int32_t new_pcb()
-*   Inputs: arguments string pointer
-*   Return Value: next process id, or -1 on fail
-*	Function: helper function to set up the pcb for the next process
+*   Inputs: pid = process id from alloc_pid, arguments string pointer
+*		slot = slot of curr_task it runs in, the running one for a child
+*		of the current process, a background one for spawn
+*   Return Value: process id, or -1 on fail
+*	Function: helper function to set up the pcb for the next process on the
+*		kernel stack that belongs to pid
 */
-int32_t new_pcb(int8_t* arguments){
-	int next_pid = get_next_pid();
+int32_t new_pcb(int32_t pid, int8_t* arguments, int32_t slot){
+	int next_pid = pid;
 	int i;
+	uint32_t flags;
 
-	if(next_pid == INVALID_INODE)
+	if(next_pid < 0 || next_pid >= MAX_PROCESSES)
 		return -1;
-	//mark pid as used
-	pid_used[current_terminal][next_pid] = USED; 		//set pid to being used
-	//get address for pcb
-	pcb_t* retval = (pcb_t*) PCB_ADDR[current_terminal][next_pid];
+	//get address for pcb, it lives at the bottom of the kernel stack of this pid
+	pcb_t* retval = (pcb_t*) PCB_ADDR(next_pid);
+	//a terminal's first shell may be started from any cpu
+	retval->terminal = (slot < MAX_TERMINALS) ? slot : running_terminal;
 
 	//setup pcb file array
 	for(i=PCB_START; i<PCB_END; i++){
@@ -687,15 +1366,16 @@ int32_t new_pcb(int8_t* arguments){
 	retval->file_array[STDOUT].file_position = 0;
 	retval->file_array[STDOUT].flags = USED;
 
-	//if curr task is null then this task is the first task
-	if(curr_task[current_terminal] == NULL){
+	//if curr task is null then this task is the first task, a background
+	//process has no parent either
+	if(curr_task[running_slot] == NULL || slot != running_slot){
 		retval->parent_task = NULL;
 		retval->child_task = NULL;
 		retval->process_id = next_pid;
 	}
 	else{
-		curr_task[current_terminal]->child_task = retval;
-		retval->parent_task = curr_task[current_terminal];
+		curr_task[running_slot]->child_task = retval;
+		retval->parent_task = curr_task[running_slot];
 		retval->child_task = NULL;
 		retval->process_id = next_pid;
 	}
@@ -703,8 +1383,72 @@ int32_t new_pcb(int8_t* arguments){
 	for(i=0; i<CHAR_BUFF_SIZE; i++)
 		retval->arg[i] = arguments[i];
 
-	//set curr task of this terminal to the pointer to the current pcb
-	curr_task[current_terminal] = retval;
+	//program mapping is filled in by execute
+	retval->user_table = NULL;
+	retval->image = NULL;
+	retval->large_regions = 0;
+	//heap is empty until the first sbrk
+	retval->heap_brk = USER_HEAP_START;
+	retval->heap_table = NULL;
+	//no shared memory attached
+	retval->shm_table = NULL;
+	for(i=0; i<SHM_MAX_ATTACH; i++)
+		retval->shm_slots[i] = SHM_NONE;
+	retval->state = TASK_RUNNABLE;
+	retval->waiting_on = NULL;
+	retval->wait_next = NULL;
+	retval->ticks_running = 0;
+	retval->ticks_blocked = 0;
+	timer_setup(&retval->sleep_timer, nanosleep_wake, retval);
+	retval->fpu_used = 0;
+	retval->sleep_wait.head = NULL;
+	signal_init(retval);
+	acct_init(retval);
+	for(i=0; i<PROC_NAME_LEN; i++)
+		retval->name[i] = '\0';
+
+	poison_stack(next_pid);
+
+	//the process table sees it once it is set up, execute puts it in the slot
+	spin_lock_irqsave(&proc_lock, flags);
+	process_table[next_pid] = retval;
+	spin_unlock_irqrestore(&proc_lock, flags);
 
 	return  next_pid;
 }
+
+/*
+* void poison_stack(int32_t pid)
+*   Inputs: pid = process whose kernel stack is filled
+*   Return Value: none
+*	Function: fills the kernel stack above the pcb with STACK_POISON. a shell
+*		restarted by halt can get the pid it is still running on, then only the
+*		part well below esp is filled
+*/
+static void poison_stack(int32_t pid){
+	uint32_t* word = (uint32_t*) (PCB_ADDR(pid) + sizeof(pcb_t));
+	uint32_t limit = KERNEL_STACK_TOP(pid);
+	uint32_t esp;
+
+	asm volatile("movl %%esp, %0" : "=r"(esp));
+	if(esp > (uint32_t) word && esp <= limit)
+		limit = esp - STACK_POISON_MARGIN;
+	while((uint32_t) word < limit)
+		*word++ = STACK_POISON;
+}
+
+/*
+* uint32_t stack_high_water(int32_t pid)
+*   Inputs: pid = process to measure
+*   Return Value: deepest use of the kernel stack of pid in bytes
+*	Function: the stack grows down towards the pcb, so the first word above the
+*		pcb that isn't poison anymore marks the deepest point reached
+*/
+uint32_t stack_high_water(int32_t pid){
+	uint32_t* word = (uint32_t*) (PCB_ADDR(pid) + sizeof(pcb_t));
+	uint32_t top = KERNEL_STACK_TOP(pid);
+
+	while((uint32_t) word < top && *word == STACK_POISON)
+		word++;
+	return top - (uint32_t) word;
+}
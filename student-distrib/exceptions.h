@@ -9,9 +9,19 @@
 #include "fs.h"
 #include "rtc.h"
 #include "keyboard.h"
+#include "shm.h"
+#include "swap.h"
+#include "image.h"
+#include "sched.h"
+#include "timer.h"
+#include "fpu.h"
+#include "signal.h"
+#include "spinlock.h"
 
 #define EIGHT_KB 0x2000
 #define PCB_ADDR_BASE 0x00800000 		//PCB address for the first task -> bottom of the task 1's kernel stack
+#define KERNEL_STACK_TOP(pid) (PCB_ADDR_BASE - (pid) * EIGHT_KB) 	//esp0 of the 8KB kernel stack of pid
+#define PCB_ADDR(pid) (PCB_ADDR_BASE - ((pid) + 1) * EIGHT_KB) 	//pcb sits at the bottom of that stack
 #define KEYBOARD_IDT 33 			//Keyboard IDT value
 #define RTC_IDT 40 					//RTC IDT value
 #define SYSTEM_CALL_IDT 128 		//System Call IDT value
@@ -34,7 +44,16 @@
 #define MAGIC_NUM_INDEX2 26
 #define MAGIC_NUM_INDEX3 27
 #define INVALID_INODE -1
-#define MAX_PCBS 6
+//one 8KB kernel stack per pid, packed down from 8MB in the kernel's 4MB page.
+//build with -DMAX_PROCESSES=n to change it, and the programs with the same
+//ECE391_MAX_PROCS since memstat returns one entry per pid
+#ifndef MAX_PROCESSES
+#define MAX_PROCESSES 64
+#endif
+#define KERNEL_PAGE_SIZE 0x00400000 	//4MB to 8MB, kernel image and the stacks
+#if MAX_PROCESSES < 1 || MAX_PROCESSES * EIGHT_KB >= KERNEL_PAGE_SIZE
+#error "MAX_PROCESSES kernel stacks don't fit in the kernel page"
+#endif
 #define PCB_END 8
 #define PCB_START 2
 #define USED 1
@@ -48,6 +67,13 @@
 #define _132MB 0x08400000
 #define VIRT_VID_INDEX 33 //index in page directory for 132MB
 #define MAX_TERMINALS 3
+#define MAX_BACKGROUND 6 			//slots for spawned pipeline stages, after the terminals'
+#define MAX_SLOTS (MAX_TERMINALS + MAX_BACKGROUND)
+#define SLOT_IDLE MAX_SLOTS 		//a cpu in its idle loop, its curr_task entry is always NULL
+#define EFLAGS_BASE 0x2 			//bit 1 of eflags is always set
+#define STACK_POISON 0xDEADBEEF 	//fills unused kernel stack, overwritten words show the deepest use
+#define STACK_POISON_MARGIN 64 		//bytes left alone below esp when poisoning the stack we run on
+#define KERNEL_PAGE_FRAMES 1024 	//the 4MB kernel page at 4MB, code, data and kernel stacks
 
 
 typedef struct operations_table_t {
@@ -63,6 +89,7 @@ typedef struct file_descriptor_t{
 	int32_t inode_number;
 	uint32_t file_position;
 	uint32_t flags;
+	int32_t device; 				//driver's slot for the open file, the rtc's virtual device
 } file_descriptor_t;
 
 typedef struct task_stack_t{
@@ -76,16 +103,79 @@ typedef struct pcb_t {
 	task_stack_t registers;
 	struct pcb_t* parent_task;
 	struct pcb_t* child_task;
-	uint32_t process_id;
+	uint32_t process_id; 		//global pid, also selects the kernel stack
+	uint32_t terminal; 		//terminal the process runs on
 	uint32_t eip;
 	uint8_t arg[CHAR_BUFF_SIZE];
+	uint32_t* user_table; 		//page table of the 128MB program region
+	image_t* image; 			//cached executable, its read only pages are shared
+	uint32_t large_regions; 	//LARGE_HEAP if the heap is mapped as a large page
+	uint32_t heap_brk; 		//current end of the user heap
+	uint32_t* heap_table; 		//page table backing the heap, NULL until first sbrk
+	uint32_t* shm_table; 		//page table backing attached shared memory, NULL until first attach
+	int32_t shm_slots[SHM_MAX_ATTACH]; 	//segment id attached in each slot, SHM_NONE if empty
+	uint32_t state; 			//TASK_RUNNABLE or TASK_BLOCKED
+	wait_queue_t* waiting_on; 	//queue the process sleeps on, NULL if none
+	struct pcb_t* wait_next; 	//next process on the same wait queue
+	uint32_t ticks_running; 	//PIT ticks spent on the cpu
+	uint32_t ticks_blocked; 	//PIT ticks spent asleep on a wait queue
+	ktimer_t sleep_timer; 		//wakes the process from nanosleep
+	wait_queue_t sleep_wait;
+	uint32_t fpu_used; 			//has fpu state saved, else starts from a clean one
+	void* sig_handlers[NUM_SIGNALS]; 	//user handler per signal, NULL for the default action
+	uint32_t sig_pending; 		//SIG_BIT of each signal waiting for delivery
+	uint32_t sig_active; 		//a handler runs, signals with handlers wait for sigreturn
+	uint32_t alarm_ms; 			//ALARM period, 0 if off
+	ktimer_t alarm_timer;
+	uint8_t name[PROC_NAME_LEN]; 	//program it runs
+	uint64_t utime; 			//ns in user mode
+	uint64_t stime; 			//ns in the kernel, its syscalls and the irqs that hit it
+	uint64_t child_utime; 		//of its halted children
+	uint64_t child_stime;
+	uint64_t acct_stamp; 		//time up to which it has been charged
+	uint64_t start_ns;
+	uint32_t nvcsw; 			//switches away because it blocked
+	uint32_t nivcsw; 			//switches away because its slice ran out
 } pcb_t;
 
-extern pcb_t* curr_task[MAX_TERMINALS];
-extern uint32_t pid_used[MAX_TERMINALS][MAX_PCBS];
+//memory use of one process, returned by memstat
+typedef struct proc_mem_t {
+	uint32_t pid;
+	uint32_t terminal;
+	uint32_t frames; 			//private frames including its page tables
+	uint32_t stack_used; 		//deepest kernel stack use in bytes so far
+} proc_mem_t;
+
+//frames by owner and kernel stack use, returned by memstat
+typedef struct mem_stats_t {
+	uint32_t pool_frames; 		//frames in the allocatable pool
+	uint32_t free_frames;
+	uint32_t zero_frames; 		//pre-zeroed frames waiting in the zero pool
+	uint32_t zero_hits; 		//zeroed allocations served from the zero pool
+	uint32_t zero_misses; 		//zeroed allocations that had to zero on the spot
+	uint32_t process_frames; 	//sum of every process' private frames
+	uint32_t cache_frames; 		//shared program pages in the image cache
+	uint32_t shm_frames; 		//shared memory segments
+	uint32_t swap_frames; 		//compressed swap pool
+	uint32_t video_frames; 		//video memory and terminal backing pages
+	uint32_t kernel_frames; 	//kernel page plus pool frames with no other owner
+	uint32_t stack_size; 		//bytes of kernel stack each process gets
+	uint32_t max_stack_used; 	//deepest kernel stack use of any process so far
+	uint32_t promotions; 		//heaps collapsed into a large page
+	uint32_t demotions; 		//large pages split back into 4KB pages
+	uint32_t copied; 			//promotions that had to copy into a free 4MB block
+	uint32_t num_procs;
+	proc_mem_t procs[MAX_PROCESSES];
+} mem_stats_t;
+
+extern pcb_t* curr_task[MAX_SLOTS + 1];
+extern pcb_t* process_table[MAX_PROCESSES];
 //extern int current_terminal;
 
 void set_pcbs();
+void restore_task_paging(pcb_t* task);
+void promote_heap(pcb_t* task);
+void demote_heap(pcb_t* task);
 
 void set_interrupt_gate(uint8_t i);
 
@@ -114,9 +204,15 @@ void ex_17();
 void ex_18();
 void ex_19();
 
+extern void (*exception_entries[20])(); 	//isr_wrapper.S
+void page_fault_entry();
+int32_t page_fault_handler(uint32_t* eip);
+int32_t map_user_page(uint32_t addr);
+
 void ex_33(); //keyboard
 void ex_40(); //rtc
 void ex_128();
+void signal_return(); 		//exit path of every stub, isr_wrapper.S
 void rtc_handler(); //rtc
 
 //10 system call all have 3 arguments but some are not needed so they are garbage
@@ -130,8 +226,26 @@ extern int32_t sys_getargs(uint8_t* buf, int32_t nbytes, int32_t garbage3);
 extern int32_t sys_vidmap(uint8_t** screen_start, int32_t garbage2, int32_t garbage3);
 extern int32_t sys_set_handler(int32_t signum, void* handler_address, int32_t garbage3);
 extern int32_t sys_sigreturn(int32_t garbage1, int32_t garbage2, int32_t garbage3);
-
-int32_t get_next_pid();
-int32_t new_pcb(int8_t* arguments);
+extern int32_t sys_sbrk(int32_t increment, int32_t garbage2, int32_t garbage3);
+extern int32_t sys_shm_create(const uint8_t* name, uint32_t size, int32_t garbage3);
+extern int32_t sys_shm_attach(int32_t id, int32_t garbage2, int32_t garbage3);
+extern int32_t sys_shm_detach(uint32_t addr, int32_t garbage2, int32_t garbage3);
+extern int32_t sys_memstat(mem_stats_t* buf, int32_t garbage2, int32_t garbage3);
+extern int32_t sys_clock_gettime(int32_t clock, timespec_t* ts, int32_t garbage3);
+extern int32_t sys_nanosleep(const timespec_t* req, timespec_t* rem, int32_t garbage3);
+extern int32_t sys_schedstat(sched_stats_t* buf, int32_t garbage2, int32_t garbage3);
+extern int32_t sys_alarm(uint32_t ms, int32_t garbage2, int32_t garbage3);
+extern int32_t sys_pipe(int32_t* fds, int32_t garbage2, int32_t garbage3);
+extern int32_t sys_spawn(const uint8_t* command, int32_t in_fd, int32_t out_fd);
+extern int32_t sys_execute_fds(const uint8_t* command, int32_t in_fd, int32_t out_fd);
+extern int32_t sys_getrusage(int32_t who, rusage_t* buf, int32_t garbage3);
+extern int32_t sys_lockstat(lock_stats_t* buf, int32_t max, int32_t garbage3);
+int32_t process_halt(uint32_t status);
+int32_t start_shell(int32_t terminal);
+
+int32_t alloc_pid();
+void free_pid(int32_t pid);
+int32_t new_pcb(int32_t pid, int8_t* arguments, int32_t slot);
+uint32_t stack_high_water(int32_t pid);
 
 #endif
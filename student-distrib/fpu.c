@@ -0,0 +1,184 @@
+#include "fpu.h"
+#include "exceptions.h"
+#include "lib.h"
+#include "smp.h"
+
+//lazy fpu switching. the fpu registers keep the state of the last process
+//that used them, fpu_owner. switching to any other process sets CR0.TS so
+//its first fpu or sse instruction traps into fpu_trap, which saves the
+//owner's state and loads the new process'. processes that never touch the
+//fpu never pay for saving it. with more than one cpu a process may next run
+//on another cpu, whose fpu doesn't have its registers, so there the owner's
+//state is saved as soon as it is switched away from. loading stays lazy
+
+static uint8_t fpu_state[MAX_PROCESSES][FPU_STATE_SIZE] __attribute__((aligned(FPU_ALIGN)));
+static uint8_t fpu_init_state[FPU_STATE_SIZE] __attribute__((aligned(FPU_ALIGN)));
+static struct pcb_t* fpu_owner[MAX_CPUS]; 	//process whose state is in each cpu's fpu, NULL if none
+static uint32_t has_fpu;
+static uint32_t has_fxsr; 				//fxsave/fxrstor instead of fnsave/frstor
+static uint32_t has_sse;
+
+#define read_cr0(val) asm volatile("movl %%cr0, %0" : "=r"(val))
+#define write_cr0(val) asm volatile("movl %0, %%cr0" : : "r"(val) : "memory")
+#define clts() asm volatile("clts")
+
+/*
+* void stts()
+*   Inputs: none
+*   Return Value: none
+*	Function: sets CR0.TS so the next fpu instruction traps
+*/
+static void stts(){
+	uint32_t cr0;
+	read_cr0(cr0);
+	write_cr0(cr0 | CR0_TS);
+}
+
+/*
+* void fpu_save(uint8_t* area)
+*   Inputs: area = FPU_STATE_SIZE bytes, 16 byte aligned
+*   Return Value: none
+*	Function: stores the fpu (and sse) registers
+*/
+static void fpu_save(uint8_t* area){
+	if(has_fxsr)
+		asm volatile("fxsave %0" : "=m"(*(uint8_t(*)[FPU_STATE_SIZE])area));
+	else
+		asm volatile("fnsave %0; fwait" : "=m"(*(uint8_t(*)[FPU_STATE_SIZE])area));
+}
+
+/*
+* void fpu_restore(uint8_t* area)
+*   Inputs: area = state stored by fpu_save
+*   Return Value: none
+*	Function: loads the fpu (and sse) registers
+*/
+static void fpu_restore(uint8_t* area){
+	if(has_fxsr)
+		asm volatile("fxrstor %0" : : "m"(*(uint8_t(*)[FPU_STATE_SIZE])area));
+	else
+		asm volatile("frstor %0" : : "m"(*(uint8_t(*)[FPU_STATE_SIZE])area));
+}
+
+/*
+* void fpu_init()
+*   Inputs: none
+*   Return Value: none
+*	Function: turns on the fpu, and sse if the cpu has fxsave, then saves a
+*		freshly initialized state every process starts from. without an fpu
+*		CR0.EM stays set and fpu instructions fault like before
+*/
+void fpu_init(){
+	uint32_t regs[4];
+
+	cpuid(CPUID_FEATURES, regs);
+	has_fpu = (regs[3] & CPUID_FPU) != 0;
+	has_fxsr = has_fpu && (regs[3] & CPUID_FXSR);
+	has_sse = has_fxsr && (regs[3] & CPUID_SSE);
+	if(!has_fpu)
+		return;
+
+	fpu_init_cpu();
+	clts();
+	fpu_save(fpu_init_state);
+	stts();
+}
+
+/*
+* void fpu_init_cpu()
+*   Inputs: none
+*   Return Value: none
+*	Function: sets up the fpu of the calling cpu, every cpu does this once.
+*		the fpu has no owner and traps on its first use
+*/
+void fpu_init_cpu(){
+	uint32_t cr0, cr4;
+	uint32_t mxcsr = MXCSR_DEFAULT;
+
+	if(!has_fpu)
+		return;
+	read_cr0(cr0);
+	cr0 &= ~(CR0_EM | CR0_TS);
+	write_cr0(cr0 | CR0_MP | CR0_NE);
+	if(has_fxsr){
+		asm volatile("movl %%cr4, %0" : "=r"(cr4));
+		cr4 |= CR4_OSFXSR;
+		if(has_sse)
+			cr4 |= CR4_OSXMMEXCPT;
+		asm volatile("movl %0, %%cr4" : : "r"(cr4));
+	}
+
+	asm volatile("fninit");
+	if(has_sse)
+		asm volatile("ldmxcsr %0" : : "m"(mxcsr));
+	fpu_owner[cpu_id()] = NULL;
+	stts();
+}
+
+/*
+* void fpu_switch(pcb_t* next)
+*   Inputs: next = process about to run
+*   Return Value: none
+*	Function: called on every process switch. the owner gets the fpu without a
+*		trap, anyone else traps on their first fpu instruction
+*/
+void fpu_switch(pcb_t* next){
+	uint32_t cpu = cpu_id();
+
+	if(!has_fpu)
+		return;
+	if(smp_active && fpu_owner[cpu] != NULL && fpu_owner[cpu] != next){
+		clts();
+		fpu_save(fpu_state[fpu_owner[cpu]->process_id]);
+		fpu_owner[cpu] = NULL;
+	}
+	if(next != NULL && next == fpu_owner[cpu])
+		clts();
+	else
+		stts();
+}
+
+/*
+* void fpu_release(pcb_t* task)
+*   Inputs: task = halting process
+*   Return Value: none
+*	Function: drops the process' fpu state, the next process with its pid and
+*		pcb mustn't be mistaken for the owner
+*/
+void fpu_release(pcb_t* task){
+	uint32_t cpu = cpu_id();
+
+	if(fpu_owner[cpu] == task){
+		fpu_owner[cpu] = NULL;
+		stts();
+	}
+	task->fpu_used = 0;
+}
+
+/*
+* int32_t fpu_trap()
+*   Inputs: none
+*   Return Value: 0 once the state is loaded, -1 without an fpu
+*	Function: device not available, the running process used the fpu while
+*		its state isn't loaded. saves the previous owner's state and loads
+*		this process' state, or a clean one if it never used the fpu
+*/
+int32_t fpu_trap(){
+	pcb_t* task = curr_task[running_slot];
+	uint32_t cpu = cpu_id();
+
+	if(!has_fpu || task == NULL)
+		return -1; 	//emulation isn't supported, SEGFAULT or ex_7
+	clts();
+	if(fpu_owner[cpu] == task)
+		return 0;
+	if(fpu_owner[cpu] != NULL)
+		fpu_save(fpu_state[fpu_owner[cpu]->process_id]);
+	if(task->fpu_used)
+		fpu_restore(fpu_state[task->process_id]);
+	else
+		fpu_restore(fpu_init_state);
+	task->fpu_used = 1;
+	fpu_owner[cpu] = task;
+	return 0;
+}
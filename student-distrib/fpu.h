@@ -0,0 +1,31 @@
+#ifndef FPU_H
+#define FPU_H
+
+#include "types.h"
+
+//cpuid leaf 1 edx
+#define CPUID_FPU (1 << 0)
+#define CPUID_FXSR (1 << 24)
+#define CPUID_SSE (1 << 25)
+
+#define CR0_MP 0x00000002 				//wait/fwait traps on TS too
+#define CR0_EM 0x00000004 				//no fpu, every fpu instruction traps
+#define CR0_TS 0x00000008 				//task switched, the next fpu instruction traps
+#define CR0_NE 0x00000020 				//native fpu errors through exception 16
+#define CR4_OSFXSR 0x00000200 			//fxsave/fxrstor and sse enabled
+#define CR4_OSXMMEXCPT 0x00000400 		//sse errors through exception 19
+
+#define FPU_STATE_SIZE 512 				//fxsave area, fnsave only uses 108 bytes
+#define FPU_ALIGN 16
+#define MXCSR_DEFAULT 0x1F80 			//every sse exception masked
+
+struct pcb_t;
+
+void fpu_init();
+void fpu_init_cpu();
+void fpu_switch(struct pcb_t* next);
+void fpu_release(struct pcb_t* task);
+int32_t fpu_trap();
+void fpu_trap_entry();
+
+#endif /* FPU_H */
@@ -1,8 +1,13 @@
 #include "fs.h"
+#include "uaccess.h"
+#include "spinlock.h"
 
 boot_block_t* boot_block;
 
 uint32_t dir_index = 0; //file directory index
+static spinlock_t fs_lock = SPIN_LOCK_INIT("fs"); //dir_index, the file system is read only
+
+static int32_t copy_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length, uint32_t user);
 
 /*
 * int32_t read_dentry_by_name (const uint8_t* fname, dentry_t* dentry);
@@ -66,6 +71,17 @@ int32_t read_dentry_by_index (uint32_t index, dentry_t* dentry){
 * (starting offset bytes into the file), and store it in buffer
 */
 int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length){
+	return copy_data(inode, offset, buf, length, 0);
+}
+
+/*
+* int32_t copy_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length, uint32_t user)
+*   Inputs: same as read_data, user = nonzero if buf is a user pointer
+*   Return Value: number of bytes read on success, -1 on failure
+*	Function: copies the file a block-sized run at a time, through copy_to_user
+*		when the buffer belongs to user space
+*/
+static int32_t copy_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length, uint32_t user){
 	if(inode > boot_block->total_inodes || inode < 0 || buf == NULL)
 		return -1;
 
@@ -77,6 +93,9 @@ int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length
 	if(file_length < offset){
 		return -1;
 	}
+	//nothing left to read
+	if(file_length == offset)
+		return 0;
 
 
 	//address of the first data block
@@ -93,7 +112,8 @@ int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length
 
 	uint32_t read_count = 0; 				//number of bytes read thus far
 	uint32_t byte_position = 0; 			//byte position into the file
-	// uint8_t curr_byte;						//current byte that is being read into the buffer
+	uint32_t run; 							//bytes copied out of the current block
+	uint8_t* src;
 
 	//variable to check how far in the file we are reading
 	byte_position = offset + read_count;
@@ -102,10 +122,21 @@ int32_t read_data(uint32_t inode, uint32_t offset, uint8_t* buf, uint32_t length
 
 	while(length > read_count){
 
-		//read the byte from the corresponding offset of the current data block
-		buf[read_count] = *((uint8_t*)((uint32_t)curr_data_block_address + byte_position % BYTES_PER_BLOCK));
+		//copy the rest of the current block, or less if the request or file ends first
+		run = BYTES_PER_BLOCK - byte_position % BYTES_PER_BLOCK;
+		if(run > length - read_count)
+			run = length - read_count;
+		if(run > file_length - byte_position)
+			run = file_length - byte_position;
+		src = (uint8_t*)((uint32_t)curr_data_block_address + byte_position % BYTES_PER_BLOCK);
+		if(user){
+			if(copy_to_user(&buf[read_count], src, run) != 0)
+				return -1;
+		}
+		else
+			memcpy(&buf[read_count], src, run);
 
-		read_count++;							//increment bytes read counter
+		read_count += run;						//increment bytes read counter
 		byte_position = offset + read_count; 	//re-set the byte position
 
 		//EOF reached ?
@@ -152,15 +183,17 @@ uint32_t read_file_length(uint32_t inode){
 */
 int32_t read_file(int32_t fd, uint8_t* buf, int32_t length){
 
-	uint32_t curr_inode_number = curr_task[current_terminal]->file_array[fd].inode_number;
+	uint32_t curr_inode_number = curr_task[running_slot]->file_array[fd].inode_number;
 	uint32_t file_len = read_file_length(curr_inode_number);
 
-	if(file_len <= curr_task[current_terminal]->file_array[fd].file_position)
+	if(file_len <= curr_task[running_slot]->file_array[fd].file_position)
 		return 0;
 
-	uint32_t offset = curr_task[current_terminal]->file_array[fd].file_position;
-	uint32_t read_amount = read_data(curr_inode_number, offset, buf, length);
-	curr_task[current_terminal]->file_array[fd].file_position += read_amount;
+	uint32_t offset = curr_task[running_slot]->file_array[fd].file_position;
+	int32_t read_amount = copy_data(curr_inode_number, offset, buf, length, 1);
+	if(read_amount == -1)
+		return -1;
+	curr_task[running_slot]->file_array[fd].file_position += read_amount;
 	return read_amount;
 }
 
@@ -185,8 +218,8 @@ int32_t write_file(int32_t fd, uint8_t* buf, int32_t length){
 *	Function: set the flag of the file in fd to used and set its file position to 0
 */
 int32_t open_file(int32_t fd, uint8_t* buf, int32_t length){
-	curr_task[current_terminal]->file_array[fd].file_position = 0;
-	curr_task[current_terminal]->file_array[fd].flags = USED;
+	curr_task[running_slot]->file_array[fd].file_position = 0;
+	curr_task[running_slot]->file_array[fd].flags = USED;
 	return 0;
 }
 
@@ -199,7 +232,7 @@ int32_t open_file(int32_t fd, uint8_t* buf, int32_t length){
 *	Function: set the flag of the file in fd to free
 */
 int32_t close_file(int32_t fd, uint8_t* buf, int32_t length){
-	curr_task[current_terminal]->file_array[fd].flags = FREE;
+	curr_task[running_slot]->file_array[fd].flags = FREE;
 	return 0;
 }
 
@@ -218,23 +251,31 @@ int32_t close_file(int32_t fd, uint8_t* buf, int32_t length){
 int32_t read_dir(int32_t fd, uint8_t* buf, int32_t length){
 
 	dentry_t temp;
+	uint32_t index, flags;
 
 	//is this right berk? not sure if i interpreted this part right
 	//i moved index to dir_index which is global
+	spin_lock_irqsave(&fs_lock, flags);
 	if(dir_index >= boot_block->total_dirs){
 		dir_index = 0;
+		spin_unlock_irqrestore(&fs_lock, flags);
 		return 0;
 	}
+	index = dir_index++; //claimed before the copy, which may sleep
+	spin_unlock_irqrestore(&fs_lock, flags);
 
 	int i;
-	read_dentry_by_index(dir_index, &temp);
-
-	for(i = 0; i < strlen((int8_t*)temp.file_name); i++){
-		buf[i] = temp.file_name[i];
-	}
-	buf[i+1] = '\0'; //might want to null terminate instead but we'll try this
+	read_dentry_by_index(index, &temp);
+
+	//names that use all 32 characters have no terminator
+	i = strlen((int8_t*)temp.file_name);
+	if(i > MAX_FILE_NAME_LENGTH)
+		i = MAX_FILE_NAME_LENGTH;
+	if(i > length)
+		i = length;
+	if(copy_to_user(buf, temp.file_name, i) != 0)
+		return -1;
 
-	dir_index++; //increment read file index
 	return i; //i is same as doing strlen(buf) but we already have it calculated
 }
 
@@ -260,9 +301,9 @@ int32_t write_dir(int32_t fd, uint8_t* buf, int32_t length){
 */
 int32_t open_dir(int32_t fd, uint8_t* buf, int32_t length){
 
-	curr_task[current_terminal]->file_array[fd].inode_number = 0;
-	curr_task[current_terminal]->file_array[fd].file_position = 0;
-	curr_task[current_terminal]->file_array[fd].flags = USED;
+	curr_task[running_slot]->file_array[fd].inode_number = 0;
+	curr_task[running_slot]->file_array[fd].file_position = 0;
+	curr_task[running_slot]->file_array[fd].flags = USED;
 	return 0;
 }
 
@@ -4,13 +4,20 @@
 
 //referenced http://wiki.osdev.org/8259_PIC
 
+//every irq starts out on the i8259. once smp_init finds an IOAPIC in the MP
+//table the irqs are moved over to it and these functions pass through to the
+//IOAPIC, the i8259 stays as the fallback for machines without one
+
 #include "i8259.h"
+#include "ioapic.h"
+#include "lapic.h"
 #include "lib.h"
 
 /* Interrupt masks to determine which interrupts
- * are enabled and disabled */
+ * are enabled and disabled, cached so masking is a single port write */
 uint8_t master_mask; /* IRQs 0-7 */
 uint8_t slave_mask; /* IRQs 8-15 */
+uint32_t irq_count[NUM_IRQS];
 
 #define INIT_MASK 0xFF 				//bitmask to mask all IRQ lines
 #define PIC_PORT_LIM 8 				//number of IRQs for each PIC
@@ -42,7 +49,42 @@ i8259_init(void)
 
 	outb(INIT_MASK, MASTER_8259_DATA);
 	outb(INIT_MASK, SLAVE_8259_DATA);
+	master_mask = INIT_MASK;
+	slave_mask = INIT_MASK;
+}
 
+/*
+* int32_t i8259_to_ioapic(uint32_t dest_apic_id, uint32_t imcr)
+*   Inputs: dest_apic_id = local APIC of cpu 0
+*		imcr = the chipset has an IMCR that has to be switched over
+*   Return Value: 0 if the irqs now come through the IOAPIC, -1 if they stay
+*		on the i8259
+*	Function: unmasks on the IOAPIC whatever is unmasked on the i8259, then
+*		masks every line of the i8259
+*/
+int32_t
+i8259_to_ioapic(uint32_t dest_apic_id, uint32_t imcr)
+{
+	uint32_t flags, irq;
+	uint16_t unmasked;
+
+	if(ioapic_init(dest_apic_id) != 0)
+		return -1;
+	cli_and_save(flags);
+	unmasked = ~((slave_mask << PIC_PORT_LIM) | master_mask);
+	for(irq = 0; irq < NUM_IRQS; irq++){
+		if(unmasked & (1 << irq))
+			ioapic_enable(irq);
+	}
+	outb(INIT_MASK, MASTER_8259_DATA);
+	outb(INIT_MASK, SLAVE_8259_DATA);
+	if(imcr){
+		outb(IMCR_INDEX, IMCR_SELECT);
+		outb(IMCR_APIC, IMCR_DATA);
+	}
+	ioapic_active = 1;
+	restore_flags(flags);
+	return 0;
 }
 
 /*
@@ -54,21 +96,20 @@ i8259_init(void)
 void
 enable_irq(uint32_t irq_num)
 {
-	uint16_t port;
-	uint8_t value;
-
+	if(ioapic_active){
+		ioapic_enable(irq_num);
+		return;
+	}
 	//irq is on master PIC
-	if(irq_num < PIC_PORT_LIM)
-		port = MASTER_8259_DATA;
-
+	if(irq_num < PIC_PORT_LIM){
+		master_mask &= ~(1 << irq_num);
+		outb(master_mask, MASTER_8259_DATA);
+	}
 	//irq is on slave PIC
 	else{
-		port = SLAVE_8259_DATA;
-		irq_num -= PIC_PORT_LIM;
+		slave_mask &= ~(1 << (irq_num - PIC_PORT_LIM));
+		outb(slave_mask, SLAVE_8259_DATA);
 	}
-	value = inb(port) & ~(1 << irq_num);
-	outb(value, port);
-
 }
 
 /*
@@ -80,17 +121,18 @@ enable_irq(uint32_t irq_num)
 void
 disable_irq(uint32_t irq_num)
 {
-	uint16_t port;
-	uint8_t value;
-
-	if(irq_num < PIC_PORT_LIM)
-		port = MASTER_8259_DATA;
+	if(ioapic_active){
+		ioapic_disable(irq_num);
+		return;
+	}
+	if(irq_num < PIC_PORT_LIM){
+		master_mask |= 1 << irq_num;
+		outb(master_mask, MASTER_8259_DATA);
+	}
 	else{
-		port = SLAVE_8259_DATA;
-		irq_num -= PIC_PORT_LIM;
+		slave_mask |= 1 << (irq_num - PIC_PORT_LIM);
+		outb(slave_mask, SLAVE_8259_DATA);
 	}
-	value = inb(port) | (1 << irq_num);
-	outb(value, port);
 }
 
 
@@ -98,12 +140,18 @@ disable_irq(uint32_t irq_num)
 * void send_eoi(uint32_t irq_num)
 *   Inputs: none
 *   Return Value: none
-*	Function: Send end-of-interrupt signal for the specified IRQ
+*	Function: Send end-of-interrupt signal for the specified IRQ, every
+*		handler sends one so this is where interrupts get counted. with the
+*		IOAPIC it is one write to the local APIC instead of one or two ports
 */
 void
 send_eoi(uint32_t irq_num)
 {
-	
+	irq_count[irq_num]++;
+	if(ioapic_active){
+		lapic_eoi();
+		return;
+	}
 	if(irq_num >= PIC_PORT_LIM){
 		//have to get the actual EOI and pass it to slave if originated on slave PIC
 		outb(EOI | (irq_num - PIC_PORT_LIM) , SLAVE_8259_PORT);
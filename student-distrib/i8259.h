@@ -28,12 +28,16 @@
 #define KEYBOARD_IRQ 1
 #define SLAVE_IRQ 2
 #define RTC_IRQ 8
+#define NUM_IRQS 16
 
 /* End-of-interrupt byte.  This gets OR'd with
  * the interrupt number and sent out to the PIC
  * to declare the interrupt finished */
 #define EOI             0x60
 
+/* Interrupts handled on each line since boot, counted at EOI */
+extern uint32_t irq_count[NUM_IRQS];
+
 /* Externally-visible functions */
 
 /* Initialize both PICs */
@@ -44,5 +48,7 @@ extern void enable_irq(uint32_t irq_num);
 extern void disable_irq(uint32_t irq_num);
 /* Send end-of-interrupt signal for the specified IRQ */
 extern void send_eoi(uint32_t irq_num);
+/* Hand the irqs over to the IOAPIC */
+extern int32_t i8259_to_ioapic(uint32_t dest_apic_id, uint32_t imcr);
 
 #endif /* _I8259_H */
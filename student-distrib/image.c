@@ -0,0 +1,207 @@
+#include "image.h"
+#include "paging.h"
+#include "fs.h"
+#include "swap.h"
+#include "lib.h"
+#include "spinlock.h"
+
+#define IMAGE_FREE 0
+#define IMAGE_USED 1
+#define USER_READ_ONLY 0x5 					//user, read only, present
+#define PROG_EXEC_ADDR 0x08048000
+#define USER_REGION 0x08000000 				//128MB
+
+static image_t images[MAX_IMAGES];
+//the cache and the refcounts, held while an image loads so a second execute
+//of the same program waits for it instead of loading it again
+static spinlock_t image_lock = SPIN_LOCK_INIT("image");
+
+static void image_release(image_t* image);
+
+/*
+* int32_t page_is_written(uint32_t inode, uint32_t page)
+*   Inputs: inode = inode of the executable, page = page index from PROG_EXEC_ADDR
+*   Return Value: 1 if a writable segment lands on the page, 0 if it is read only
+*	Function: programs are copied flat to PROG_EXEC_ADDR, so a page of the file
+*		is only ever written if a writable PT_LOAD segment (data or bss) covers its
+*		address. files without a readable program header are treated as writable
+*/
+static int32_t page_is_written(uint32_t inode, uint32_t page){
+	uint8_t header[ELF_HEADER_SIZE];
+	elf_phdr_t phdr;
+	uint32_t phoff, i;
+	uint16_t phentsize, phnum;
+	uint32_t start = PROG_EXEC_ADDR + page * FRAME_SIZE;
+	uint32_t end = start + FRAME_SIZE;
+
+	if(read_data(inode, 0, header, ELF_HEADER_SIZE) != ELF_HEADER_SIZE)
+		return 1;
+	memcpy(&phoff, &header[ELF_PHOFF], sizeof(phoff));
+	memcpy(&phentsize, &header[ELF_PHENTSIZE], sizeof(phentsize));
+	memcpy(&phnum, &header[ELF_PHNUM], sizeof(phnum));
+	if(phnum == 0 || phentsize < sizeof(elf_phdr_t))
+		return 1;
+
+	for(i = 0; i < phnum; i++){
+		if(read_data(inode, phoff + i * phentsize, (uint8_t*) &phdr, sizeof(phdr)) != sizeof(phdr))
+			return 1;
+		if(phdr.type != PT_LOAD || !(phdr.flags & PF_W))
+			continue;
+		if(phdr.vaddr < end && phdr.vaddr + phdr.memsz > start)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+* image_t* image_get(uint32_t inode)
+*   Inputs: inode = inode of the executable
+*   Return Value: cached image, or NULL if the cache is full or out of frames
+*	Function: looks the executable up in the image cache. the first instance
+*		loads every read only page into a shared frame, later ones just take a reference
+*/
+image_t* image_get(uint32_t inode){
+	int32_t i, free_slot = -1;
+	uint32_t page, flags;
+	image_t* image;
+
+	spin_lock_irqsave(&image_lock, flags);
+	for(i = 0; i < MAX_IMAGES; i++){
+		if(images[i].flags == IMAGE_USED && images[i].inode == inode){
+			images[i].refcount++;
+			spin_unlock_irqrestore(&image_lock, flags);
+			return &images[i];
+		}
+		if(images[i].flags == IMAGE_FREE && free_slot == -1)
+			free_slot = i;
+	}
+	if(free_slot == -1){
+		spin_unlock_irqrestore(&image_lock, flags);
+		return NULL;
+	}
+
+	image = &images[free_slot];
+	image->inode = inode;
+	image->length = read_file_length(inode);
+	image->num_pages = (image->length + FRAME_SIZE - 1) / FRAME_SIZE;
+	image->refcount = 1;
+	image->flags = IMAGE_USED;
+
+	for(page = 0; page < MAX_IMAGE_PAGES; page++){
+		image->frames[page] = NO_FRAME;
+		if(page >= image->num_pages || page_is_written(inode, page))
+			continue;
+		image->frames[page] = alloc_zeroed_frame();
+		if(image->frames[page] == NO_FRAME){
+			image_release(image);
+			spin_unlock_irqrestore(&image_lock, flags);
+			return NULL;
+		}
+		read_data(inode, page * FRAME_SIZE, (uint8_t*) image->frames[page], FRAME_SIZE);
+	}
+	spin_unlock_irqrestore(&image_lock, flags);
+	return image;
+}
+
+/*
+* void image_put(image_t* image)
+*   Inputs: image = image from image_get
+*   Return Value: none
+*	Function: drops a reference, the shared frames are freed when the last
+*		running instance halts
+*/
+void image_put(image_t* image){
+	uint32_t flags;
+
+	if(image == NULL)
+		return;
+	spin_lock_irqsave(&image_lock, flags);
+	image_release(image);
+	spin_unlock_irqrestore(&image_lock, flags);
+}
+
+/*
+* void image_release(image_t* image)
+*   Inputs: image = image from image_get
+*   Return Value: none
+*	Function: image_put with image_lock held
+*/
+static void image_release(image_t* image){
+	uint32_t page;
+	if(--image->refcount > 0)
+		return;
+	for(page = 0; page < MAX_IMAGE_PAGES; page++){
+		if(image->frames[page] != NO_FRAME)
+			free_frame(image->frames[page]);
+		image->frames[page] = NO_FRAME;
+	}
+	image->flags = IMAGE_FREE;
+}
+
+/*
+* int32_t image_map(image_t* image, uint32_t* table)
+*   Inputs: image = image from image_get, table = empty page table for the 128MB region
+*   Return Value: 0 on success, -1 if out of frames
+*	Function: maps the shared read only pages and copies the rest of the file into
+*		private frames. stack and bss pages past the file are left unmapped and
+*		are filled with zeroed frames on first touch
+*/
+int32_t image_map(image_t* image, uint32_t* table){
+	uint32_t page, frame;
+	uint32_t first = (PROG_EXEC_ADDR - USER_REGION) / FRAME_SIZE;
+
+	for(page = 0; page < image->num_pages && first + page < USER_PAGES; page++){
+		if(page < MAX_IMAGE_PAGES && image->frames[page] != NO_FRAME){
+			table[first + page] = image->frames[page] | USER_READ_ONLY;
+			continue;
+		}
+		frame = alloc_zeroed_frame();
+		if(frame == NO_FRAME)
+			return -1;
+		read_data(image->inode, page * FRAME_SIZE, (uint8_t*) frame, FRAME_SIZE);
+		table[first + page] = frame | USERREADPRESENT;
+	}
+	return 0;
+}
+
+/*
+* void user_table_release(uint32_t* table)
+*   Inputs: table = page table of the 128MB region of a halting process
+*   Return Value: none
+*	Function: frees the private frames and the table. shared read only frames
+*		belong to the image and are left alone
+*/
+void user_table_release(uint32_t* table){
+	uint32_t i;
+	if(table == NULL)
+		return;
+	for(i = 0; i < USER_PAGES; i++){
+		if((table[i] & PAGE_PRESENT_BIT) && (table[i] & PAGE_RW))
+			free_frame(table[i]);
+		else if(table[i] & PAGE_SWAPPED)
+			swap_discard(table[i]);
+	}
+	free_frame((uint32_t) table);
+}
+
+/*
+* uint32_t image_cache_frames()
+*   Inputs: none
+*   Return Value: number of shared frames held by the image cache
+*	Function: used for memory accounting
+*/
+uint32_t image_cache_frames(){
+	uint32_t i, page, flags, count = 0;
+
+	spin_lock_irqsave(&image_lock, flags);
+	for(i = 0; i < MAX_IMAGES; i++){
+		if(images[i].flags != IMAGE_USED)
+			continue;
+		for(page = 0; page < MAX_IMAGE_PAGES; page++){
+			if(images[i].frames[page] != NO_FRAME)
+				count++;
+		}
+	}
+	spin_unlock_irqrestore(&image_lock, flags);
+	return count;
+}
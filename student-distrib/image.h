@@ -0,0 +1,46 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include "types.h"
+
+//executable image cache, read-only pages of a program are shared by every
+//running instance of it
+#define MAX_IMAGES 16
+#define MAX_IMAGE_PAGES 64 					//pages past this are always private
+#define USER_PAGES 1024 					//4KB pages in the 4MB user program region
+
+//ELF header fields used to find the loadable segments
+#define ELF_PHOFF 28
+#define ELF_PHENTSIZE 42
+#define ELF_PHNUM 44
+#define ELF_HEADER_SIZE 52
+#define PT_LOAD 1
+#define PF_W 0x2
+
+typedef struct elf_phdr_t {
+	uint32_t type;
+	uint32_t offset;
+	uint32_t vaddr;
+	uint32_t paddr;
+	uint32_t filesz;
+	uint32_t memsz;
+	uint32_t flags;
+	uint32_t align;
+} elf_phdr_t;
+
+typedef struct image_t {
+	uint32_t inode;
+	uint32_t length; 						//file length in bytes
+	uint32_t num_pages; 					//pages the file covers starting at PROG_EXEC_ADDR
+	uint32_t frames[MAX_IMAGE_PAGES]; 		//shared read-only frame, NO_FRAME if the page is private
+	uint32_t refcount; 						//running processes using this image
+	uint32_t flags;
+} image_t;
+
+image_t* image_get(uint32_t inode);
+void image_put(image_t* image);
+int32_t image_map(image_t* image, uint32_t* table);
+void user_table_release(uint32_t* table);
+uint32_t image_cache_frames();
+
+#endif /* IMAGE_H */
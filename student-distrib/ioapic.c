@@ -0,0 +1,146 @@
+#include "ioapic.h"
+#include "i8259.h"
+#include "lib.h"
+#include "paging.h"
+
+//ISA irqs keep the vectors the i8259 gave them, so the same IDT entries and
+//handlers are used either way. all of them go to cpu 0, like with the i8259.
+//the routing table starts out identity mapped, edge triggered and active high
+//as the ISA bus is, and the MP table overrides entries that are wired
+//differently (irq 0 is usually on pin 2)
+
+uint32_t ioapic_base;
+uint32_t ioapic_active;
+
+typedef struct irq_route_t {
+	uint8_t pin; 						//IOAPIC_NO_PIN if it isn't wired
+	uint32_t flags; 					//IOAPIC_LEVEL, IOAPIC_ACTIVE_LOW
+} irq_route_t;
+
+static irq_route_t routes[NUM_IRQS];
+static uint32_t routes_set; 			//the defaults were filled in
+static uint32_t redir_low[IOAPIC_MAX_PINS]; 	//what each pin was last written with
+static uint32_t num_pins;
+
+/*
+* uint32_t ioapic_read(uint32_t reg)
+*   Inputs: reg = register index
+*   Return Value: register value
+*/
+static uint32_t ioapic_read(uint32_t reg){
+	volatile uint32_t* io = (volatile uint32_t*)ioapic_base;
+	io[IOAPIC_REGSEL >> 2] = reg;
+	return io[IOAPIC_WIN >> 2];
+}
+
+/*
+* void ioapic_write(uint32_t reg, uint32_t val)
+*   Inputs: reg = register index, val = value to write
+*   Return Value: none
+*/
+static void ioapic_write(uint32_t reg, uint32_t val){
+	volatile uint32_t* io = (volatile uint32_t*)ioapic_base;
+	io[IOAPIC_REGSEL >> 2] = reg;
+	io[IOAPIC_WIN >> 2] = val;
+}
+
+/*
+* void routes_default()
+*   Inputs: none
+*   Return Value: none
+*	Function: every irq on the pin of the same number, except the cascade
+*		which doesn't exist without the i8259
+*/
+static void routes_default(){
+	uint32_t irq;
+
+	if(routes_set)
+		return;
+	for(irq = 0; irq < NUM_IRQS; irq++){
+		routes[irq].pin = (irq == SLAVE_IRQ) ? IOAPIC_NO_PIN : irq;
+		routes[irq].flags = 0;
+	}
+	routes_set = 1;
+}
+
+/*
+* void ioapic_route(uint32_t irq, uint32_t pin, uint32_t flags)
+*   Inputs: irq = ISA irq, pin = IOAPIC input it is wired to
+*		flags = IOAPIC_LEVEL and IOAPIC_ACTIVE_LOW, 0 for an ISA line
+*   Return Value: none
+*	Function: fills in the routing table from an MP interrupt entry, before
+*		ioapic_init
+*/
+void ioapic_route(uint32_t irq, uint32_t pin, uint32_t flags){
+	routes_default();
+	//some tables list the cascade on the pin irq 0 was moved to
+	if(irq >= NUM_IRQS || irq == SLAVE_IRQ || pin >= IOAPIC_MAX_PINS)
+		return;
+	routes[irq].pin = pin;
+	routes[irq].flags = flags & (IOAPIC_LEVEL | IOAPIC_ACTIVE_LOW);
+}
+
+/*
+* int32_t ioapic_init(uint32_t dest_apic_id)
+*   Inputs: dest_apic_id = local APIC every irq is sent to
+*   Return Value: 0 on success, -1 if there is no IOAPIC
+*	Function: maps the registers and writes the whole redirection table
+*		masked. the caller unmasks the irqs that were on with the i8259
+*/
+int32_t ioapic_init(uint32_t dest_apic_id){
+	uint32_t irq, pin;
+
+	if(ioapic_base == 0)
+		return -1;
+	routes_default();
+	map_mmio(ioapic_base);
+	num_pins = ((ioapic_read(IOAPIC_VER) >> IOAPIC_MAX_REDIR_SHIFT) & IOAPIC_MAX_REDIR_MASK) + 1;
+	if(num_pins > IOAPIC_MAX_PINS)
+		num_pins = IOAPIC_MAX_PINS;
+
+	for(pin = 0; pin < num_pins; pin++){
+		redir_low[pin] = IOAPIC_MASKED;
+		ioapic_write(IOAPIC_REDIR + 2 * pin, IOAPIC_MASKED);
+	}
+	for(irq = 0; irq < NUM_IRQS; irq++){
+		pin = routes[irq].pin;
+		if(pin >= num_pins){
+			routes[irq].pin = IOAPIC_NO_PIN;
+			continue;
+		}
+		//fixed delivery, physical destination
+		redir_low[pin] = IOAPIC_MASKED | routes[irq].flags | (ICW2_MASTER + irq);
+		ioapic_write(IOAPIC_REDIR + 2 * pin + 1, dest_apic_id << IOAPIC_DEST_SHIFT);
+		ioapic_write(IOAPIC_REDIR + 2 * pin, redir_low[pin]);
+	}
+	return 0;
+}
+
+/*
+* void ioapic_enable(uint32_t irq)
+*   Inputs: irq = ISA irq to unmask
+*   Return Value: none
+*	Function: one register write, the rest of the entry is kept in redir_low
+*/
+void ioapic_enable(uint32_t irq){
+	uint32_t pin = routes[irq].pin;
+
+	if(pin == IOAPIC_NO_PIN)
+		return;
+	redir_low[pin] &= ~IOAPIC_MASKED;
+	ioapic_write(IOAPIC_REDIR + 2 * pin, redir_low[pin]);
+}
+
+/*
+* void ioapic_disable(uint32_t irq)
+*   Inputs: irq = ISA irq to mask
+*   Return Value: none
+*/
+void ioapic_disable(uint32_t irq){
+	uint32_t pin = routes[irq].pin;
+
+	if(pin == IOAPIC_NO_PIN)
+		return;
+	redir_low[pin] |= IOAPIC_MASKED;
+	ioapic_write(IOAPIC_REDIR + 2 * pin, redir_low[pin]);
+}
@@ -0,0 +1,41 @@
+#ifndef IOAPIC_H
+#define IOAPIC_H
+
+#include "types.h"
+
+//I/O APIC, the device irqs come in through its redirection table and are
+//ended by the local APIC. the registers are reached through an index and a
+//data window
+#define IOAPIC_DEFAULT_BASE 0xFEC00000
+#define IOAPIC_REGSEL 0x00
+#define IOAPIC_WIN 0x10
+#define IOAPIC_VER 0x01
+#define IOAPIC_MAX_REDIR_SHIFT 16 			//in IOAPIC_VER, pins - 1
+#define IOAPIC_MAX_REDIR_MASK 0xFF
+#define IOAPIC_REDIR 0x10 					//two registers per pin, low then high
+#define IOAPIC_DEST_SHIFT 24 				//in the high register
+#define IOAPIC_MAX_PINS 24
+
+//redirection entry, low register. also the flags of a route
+#define IOAPIC_ACTIVE_LOW 0x02000
+#define IOAPIC_LEVEL 0x08000
+#define IOAPIC_MASKED 0x10000
+
+#define IOAPIC_NO_PIN 0xFF
+
+//interrupt mode configuration register. chipsets that have it send the
+//i8259's interrupts straight to the cpu until it is switched to the APIC
+#define IMCR_SELECT 0x22
+#define IMCR_DATA 0x23
+#define IMCR_INDEX 0x70
+#define IMCR_APIC 0x01
+
+extern uint32_t ioapic_base; 			//0 if there is none, set from the MP table
+extern uint32_t ioapic_active; 			//irqs come through the IOAPIC, not the i8259
+
+void ioapic_route(uint32_t irq, uint32_t pin, uint32_t flags);
+int32_t ioapic_init(uint32_t dest_apic_id);
+void ioapic_enable(uint32_t irq);
+void ioapic_disable(uint32_t irq);
+
+#endif /* IOAPIC_H */
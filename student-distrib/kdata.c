@@ -0,0 +1,98 @@
+#include "kdata.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "sysenter.h"
+#include "timer.h"
+
+//the clock is written into every page by cpu 0's timer interrupt and the
+//task fields by the cpu that switches, the writers take kdata_lock so their
+//seq updates don't mix
+
+typedef union kdata_page_t {
+	kdata_t data;
+	uint8_t page[KDATA_PAGE_SIZE]; 		//each one gets a page of its own
+} kdata_page_t;
+
+static kdata_page_t pages[MAX_CPUS] __attribute__((aligned(KDATA_PAGE_SIZE)));
+static spinlock_t kdata_lock = SPIN_LOCK_INIT("kdata");
+
+/*
+* void kdata_write_begin(kdata_t* k)
+*   Inputs: k = page about to change
+*   Return Value: none
+*	Function: makes seq odd, readers retry until kdata_write_end
+*/
+static inline void kdata_write_begin(kdata_t* k){
+	k->seq++;
+	asm volatile("" : : : "memory");
+}
+
+/*
+* void kdata_write_end(kdata_t* k)
+*   Inputs: k = page that changed
+*   Return Value: none
+*	Function: makes seq even again. x86 keeps stores in order, the compiler
+*		has to be told
+*/
+static inline void kdata_write_end(kdata_t* k){
+	asm volatile("" : : : "memory");
+	k->seq++;
+}
+
+/*
+* uint32_t kdata_map(uint32_t cpu)
+*   Inputs: cpu = index of the cpu setting up its paging
+*   Return Value: address of its page, the kernel is identity mapped so this
+*		is also the physical address for the page table
+*/
+uint32_t kdata_map(uint32_t cpu){
+	pages[cpu].data.cpu = cpu;
+	pages[cpu].data.clock_shift = CLOCK_SHIFT;
+	pages[cpu].data.pid = -1;
+	pages[cpu].data.terminal = -1;
+	pages[cpu].data.sysenter = sysenter_ok;
+	return (uint32_t)&pages[cpu];
+}
+
+/*
+* void kdata_clock(uint32_t ticks, uint32_t time, uint64_t tsc, uint64_t ns, uint32_t mult)
+*   Inputs: ticks = scheduler ticks since boot, time = seconds since 1970
+*		tsc, ns = TSC and monotonic clock of the timer interrupt
+*		mult = ns per cycle << CLOCK_SHIFT, 0 without a TSC
+*   Return Value: none
+*	Function: called by every timer interrupt, updates every cpu's page
+*/
+void kdata_clock(uint32_t ticks, uint32_t time, uint64_t tsc, uint64_t ns, uint32_t mult){
+	kdata_t* k;
+	uint32_t cpu, flags;
+
+	spin_lock_irqsave(&kdata_lock, flags);
+	for(cpu = 0; cpu < num_cpus; cpu++){
+		k = &pages[cpu].data;
+		kdata_write_begin(k);
+		k->ticks = ticks;
+		k->time = time;
+		k->base_tsc = tsc;
+		k->base_ns = ns;
+		k->clock_mult = mult;
+		kdata_write_end(k);
+	}
+	spin_unlock_irqrestore(&kdata_lock, flags);
+}
+
+/*
+* void kdata_task(int32_t pid, int32_t terminal)
+*   Inputs: pid, terminal = of the process this cpu is about to run
+*   Return Value: none
+*/
+void kdata_task(int32_t pid, int32_t terminal){
+	kdata_t* k = &pages[cpu_id()].data;
+	uint32_t flags;
+
+	spin_lock_irqsave(&kdata_lock, flags);
+	kdata_write_begin(k);
+	k->pid = pid;
+	k->terminal = terminal;
+	kdata_write_end(k);
+	spin_unlock_irqrestore(&kdata_lock, flags);
+}
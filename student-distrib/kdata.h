@@ -0,0 +1,33 @@
+#ifndef KDATA_H
+#define KDATA_H
+
+#include "types.h"
+
+//read only page every process sees at KDATA_ADDR, so reading the clock, the
+//tick count or its own pid needs no system call. every cpu has its own, in
+//its vidmap page table, the clock fields are the same in all of them
+#define KDATA_ADDR 0x08401000 				//the page after vidmap's at 132MB
+#define KDATA_INDEX 1 						//in the vidmap page table
+#define KDATA_PAGE_SIZE 0x1000
+
+//seqlock: the kernel makes seq odd while it writes. a reader copies the
+//fields and tries again if seq was odd or changed meanwhile
+typedef struct kdata_t {
+	volatile uint32_t seq;
+	uint32_t cpu; 						//cpu this page belongs to
+	uint32_t ticks; 					//scheduler ticks since boot
+	uint32_t time; 						//seconds since 1970 at base_ns
+	uint64_t base_tsc; 					//TSC at base_ns
+	uint64_t base_ns; 					//monotonic clock at the last timer interrupt
+	uint32_t clock_mult; 				//ns per TSC cycle << clock_shift, 0 without a TSC
+	uint32_t clock_shift;
+	int32_t pid; 						//process running on this cpu
+	int32_t terminal;
+	uint32_t sysenter; 					//the user library may use sysenter
+} kdata_t;
+
+uint32_t kdata_map(uint32_t cpu);
+void kdata_clock(uint32_t ticks, uint32_t time, uint64_t tsc, uint64_t ns, uint32_t mult);
+void kdata_task(int32_t pid, int32_t terminal);
+
+#endif /* KDATA_H */
@@ -12,6 +12,8 @@
 #include "keyboard.h"
 #include "paging.h"
 #include "fs.h"
+#include "smp.h"
+#include "sysenter.h"
 
 /* Macros. */
 /* Check if the bit BIT in FLAGS is set. */
@@ -161,13 +163,16 @@ entry (unsigned long magic, unsigned long addr)
 
 
 	set_exeptions();		//set up known exceptions in table
-	paging_init();			//enable paging
+	sysenter_init();		//fast system calls, before paging_init publishes them
+	paging_init(mbi);		//enable paging, the frame pool is clipped to the ram in the memory map
 
 	lidt(idt_desc_ptr); 		//load interrupt descriptor table
 
 
 	/* Init the PIC */
 	i8259_init();
+	fpu_init();									//lazy fpu/sse switching
+	worker_init();								//bottom halves for the irqs
 	rtc_init();									//init RTC
 	//unmask needed irq lines
 	enable_irq(KEYBOARD_IRQ);			//enable keyboard
@@ -275,19 +280,17 @@ entry (unsigned long magic, unsigned long addr)
 	curr_task[2] = NULL; 			//set first task to 0
 	//set initial terminal to 0
 	current_terminal = 0;
-
-	// sys_execute((uint8_t *)"shell", 0, 0);
-	int8_t* file = "shell\0";
-	asm volatile("	movl $2, %%eax \n\
-			movl %0, %%ebx  \n\
-			int $0x80"
+	//start the scheduler tick and the other cpus, they go to their idle loops
+	sched_init();
+	smp_init();
+
+	/* Execute the first program (`shell') ... the idle loop starts a shell on
+	 * every terminal. it runs on its own stack, the boot stack is the kernel
+	 * stack of pid 0 */
+	asm volatile("movl %0, %%esp \n\
+			call sched_idle"
 			:
-			:"g"(file)
-			:"memory", "eax"
+			: "r"(idle_stack_top(0))
+			: "memory"
 			);
-
-	/* Execute the first program (`shell') ... */
-
-	/* Spin (nicely, so we don't chew up cycles) */
-	asm volatile(".1: hlt; jmp .1;");
 }
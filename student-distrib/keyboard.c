@@ -3,6 +3,8 @@
 #include "i8259.h"
 #include "paging.h"
 #include "exceptions.h"
+#include "uaccess.h"
+#include "spinlock.h"
 
 //https://www.kernel.org/pub/linux/kernel/people/marcelo/linux-2.4/drivers/char/keyboard.c
 //http://www.electro.fisica.unlp.edu.ar/temas/lkmpg/node25.html
@@ -58,7 +60,21 @@ uint8_t kbbuf_index[NUM_TERMINALS];
 uint8_t kb_buffer[NUM_TERMINALS][MAXBUFLEN];
 uint8_t out_buffer[NUM_TERMINALS][MAXBUFLEN];
 uint8_t kb_buf_read[NUM_TERMINALS]; //flag for whether or not buffer is ready for reading. 1 is ready, 0 is not
+static uint8_t kb_scan[KB_SCAN_QUEUE]; //scancodes the handler left for keyboard_work
+static volatile uint8_t kb_scan_head; //written by the handler
+static volatile uint8_t kb_scan_tail; //written by keyboard_work
+static work_t kb_work;
+static void keyboard_work(work_t* work);
+static int32_t keyboard_process(uint8_t scancode);
+static int32_t output_terminal; //terminal putc currently draws on
+static wait_queue_t kb_wait[NUM_TERMINALS]; //processes sleeping in terminal_read
 kb_flags_t keyboard_status; //flags for shift, caps lock, etc
+//out_buffer and kb_buf_read of each terminal, shared with its reader
+static spinlock_t tty_lock[NUM_TERMINALS] = {
+	SPIN_LOCK_INIT("tty0"), SPIN_LOCK_INIT("tty1"), SPIN_LOCK_INIT("tty2")
+};
+//putc's cursor, output_terminal and video memory. taken before a tty lock
+static spinlock_t console_lock = SPIN_LOCK_INIT("console");
 
 //these will store screen positions when switching terminals - moved to header, externally visible
 //int terminal_screenx[3];
@@ -77,19 +93,21 @@ kb_flags_t keyboard_status; //flags for shift, caps lock, etc
 */
 void clear_buffer(int clear_keyboard){
 	int i;
-	cli();
+	int32_t terminal = current_terminal;
+	uint32_t flags;
+	spin_lock_irqsave(&tty_lock[terminal], flags);
 	if(clear_keyboard){
 		for(i = 0; i < MAXBUFLEN; i++)
-			kb_buffer[current_terminal][i] = '\0';
-		kbbuf_index[current_terminal] = 0; //reset index pointer
+			kb_buffer[terminal][i] = '\0';
+		kbbuf_index[terminal] = 0; //reset index pointer
 	}
 	else{
 		for(i = 0; i < MAXBUFLEN; i++){
-			out_buffer[current_terminal][i] = '\0';
+			out_buffer[terminal][i] = '\0';
 		}
-		kb_buf_read[current_terminal] = 0; //reset flag
+		kb_buf_read[terminal] = 0; //reset flag
 	}
-	sti();
+	spin_unlock_irqrestore(&tty_lock[terminal], flags);
 }
 
 /*
@@ -117,21 +135,36 @@ void clear_screen(void){
 * 	calling terminal read should give a clear buffer
 */
 int32_t terminal_read(int32_t fd, uint8_t* buf, int32_t length){
+	//the terminal the reading process runs on, not necessarily the one on screen
+	int32_t terminal = running_terminal;
+	uint8_t line[MAXBUFLEN]; 	//copied out under the lock, copy_to_user may sleep
+	uint32_t flags;
+	int i;
 	if(buf == NULL || length < 0)
 		return -1;
-	//wait until ready to read
-	sti();
-	while(!kb_buf_read[current_terminal]){}
-	cli();
-
-	memcpy(buf, &(out_buffer[current_terminal]), length < MAXBUFLEN ? length:MAXBUFLEN); //this might need to be < index instead
+	//sleep until enter is pressed on this terminal
+	spin_lock_irqsave(&tty_lock[terminal], flags);
+	while(!kb_buf_read[terminal]){
+		if(signal_pending(curr_task[running_slot])){
+			spin_unlock_irqrestore(&tty_lock[terminal], flags);
+			return ERESTART; 	//read again once the signal is handled
+		}
+		//the lock is let go once on the wait queue, so enter can't be missed
+		sleep_on(&kb_wait[terminal], &tty_lock[terminal]);
+	}
 
-	sti();
-	clear_buffer(0);
+	for(i = 0; i < MAXBUFLEN; i++){
+		line[i] = out_buffer[terminal][i];
+		out_buffer[terminal][i] = '\0';
+	}
 	//after reading need to reset buffer index and ready to read
 	//kbbuf_index = 0;
-	kb_buf_read[current_terminal] = 0;
+	kb_buf_read[terminal] = 0;
+	spin_unlock_irqrestore(&tty_lock[terminal], flags);
 
+	//a bad buffer still consumes the line
+	if(copy_to_user(buf, line, length < MAXBUFLEN ? length:MAXBUFLEN) != 0) //this might need to be < index instead
+		return -1;
 	return length < MAXBUFLEN ? length:MAXBUFLEN;
 }
 
@@ -139,110 +172,53 @@ int32_t terminal_read(int32_t fd, uint8_t* buf, int32_t length){
 * int32_t terminal_switch(int newterminalindex)
 *   Inputs: int newterminalindex = index of new terminal to be changed to
 *   Return Value: return 1 on success, 0 on failure
-*	Function: switch to new terminal specified
+*	Function: shows another terminal. every terminal keeps running under the
+*		scheduler, this only swaps what is in video memory
 */
 int32_t terminal_switch(int newterminalindex){
-	cli();
+	uint32_t flags;
 	//there are only 3 possible terminals: 0, 1, 2
-	if(newterminalindex < 0 || newterminalindex > 2){
+	if(newterminalindex < 0 || newterminalindex >= NUM_TERMINALS)
 		return 0;
-	}
-	//save screen positions
-	terminal_screenx[current_terminal] = screen_x;
-	terminal_screeny[current_terminal] = screen_y;
-
-	//save task info
-	//need to save esp0 into somewhere - still need to find out where
-	//save registers for old task
-	curr_task[current_terminal]->registers.esp0 = tss.esp0;
-
-	asm volatile(
-		"pushl %%eax \n\
-		pushl %%ebx \n\
-		pushl %%ecx \n\
-		pushl %%edx \n\
-		pushl %%esi \n\
-		pushl %%edi \n\
-		pushl %%ecx \n\
-		movl %%cr3, %%ecx \n\
-		movl %%ecx, %0 \n\
-		popl %%ecx \n\
-		movl %%ebp, %1 \n\
-		movl %%esp, %2 \n\
-	"
-		:"=g"(curr_task[current_terminal]->registers.cr3), "=g"(curr_task[current_terminal]->registers.ebp), "=g"(curr_task[current_terminal]->registers.esp)
-
-	);
-
-	asm volatile (
-		"leal GETEIP, %%ecx \n\
-		"
-		: : :"ecx");
-
-	asm volatile(
-		"movl %%ecx, %0 \n\
-		": "=g"(curr_task[current_terminal]->registers.eip)
-	);
-
-
-
-
-	//output, input, clobbered registers
-
-	//get page address, first video page is at 132MB, each new page is 4kb later
-	uint32_t* temppage = get_terminal_back_page(current_terminal);
-	//copy video memory into backing page
-	memcpy(temppage, (uint32_t *) VIDEO, FOURKB);
-	uint32_t* newpage = get_terminal_back_page(newterminalindex);
+	if(newterminalindex == current_terminal)
+		return 1;
 
+	spin_lock_irqsave(&console_lock, flags);
+	//save the screen being hidden into its backing page, show the new one
+	memcpy(get_terminal_back_page(current_terminal), (uint32_t *) VIDEO, FOURKB);
+	memcpy((uint32_t *) VIDEO, get_terminal_back_page(newterminalindex), FOURKB);
 	current_terminal = newterminalindex;
 
-	//check if task is running, else start new shell
-	if(!pid_used[current_terminal][0]){
-		clear();
-		sti(); 
-		send_eoi(KEYBOARD_IRQ);
-		screen_x = 0;
-		screen_y = 0;
-		sys_execute((uint8_t*) "shell", 0, 0);
-	}
-	//copy next terminals stuff to video memory, only call if other task exists
-	memcpy((uint8_t *) VIDEO, newpage, FOURKB);
-
-	screen_x = terminal_screenx[current_terminal]; //current_terminal will have been updated in terminal switch
-	screen_y = terminal_screeny[current_terminal];
-
-	update_cursor(screen_x, screen_y);
+	//the terminal putc draws on and the running process may have moved on
+	//or off the screen, the other cpus remap theirs when the interrupt
+	//brings them into the kernel
+	terminal_output(output_terminal);
+	map_running_video();
+	reset_cr3();
+	smp_kick_others();
+	update_cursor(terminal_screenx[current_terminal], terminal_screeny[current_terminal]);
+	spin_unlock_irqrestore(&console_lock, flags);
+	return 1;
+}
 
-	//restore stack
-	tss.esp0 = curr_task[current_terminal]->registers.esp0;
-	asm volatile(
-		"movl %0, %%cr3\n\
-		movl %1, %%ebp \n\
-		movl %2, %%esp \n\
-		popl %%edi \n\
-		popl %%esi \n\
-		popl %%edx \n\
-		popl %%ecx \n\
-		popl %%ebx \n\
-		popl %%eax \n\
-		"
-		:
-		: "r"(curr_task[current_terminal]->registers.cr3), "r"(curr_task[current_terminal]->registers.ebp), "r"(curr_task[current_terminal]->registers.esp)
-	);
-
-	asm volatile(
-		"pushl %0 \n\
-		"
-		:
-		:"g"(curr_task[current_terminal]->registers.eip)
-	);
-
-	sti();
-	//these 2 things let us get eip stuff
-	asm volatile("ret");
-	asm volatile("GETEIP:");
-	return 0;
+/*
+* void terminal_output(int32_t terminal)
+*   Inputs: terminal = terminal that putc should draw on
+*   Return Value: none
+*	Function: saves the cursor of the terminal being printed to and loads the
+*		one of the new terminal. output goes to video memory if it is on screen,
+*		otherwise to its backing page
+*/
+void terminal_output(int32_t terminal){
+	terminal_screenx[output_terminal] = screen_x;
+	terminal_screeny[output_terminal] = screen_y;
+	output_terminal = terminal;
+	screen_x = terminal_screenx[terminal];
+	screen_y = terminal_screeny[terminal];
+	if(terminal == current_terminal)
+		set_video_mem((char*) VIDEO);
+	else
+		set_video_mem((char*) get_terminal_back_page(terminal));
 }
 
 
@@ -259,17 +235,34 @@ int32_t terminal_switch(int newterminalindex){
 int32_t terminal_write(int32_t fd, uint8_t* buf, int32_t length){
 
 	int byteswritten = 0;
+	int32_t terminal = running_terminal; 	//putc is shared by every cpu
+	uint8_t chunk[MAXBUFLEN]; 	//user bytes are copied in a line at a time
+	int i, count;
+	uint32_t flags;
 
 	if((buf == NULL) || (length < 0))
 		return -1;
-	int i;
-	cli();
-	for(i = 0; i < length; i++){
-		putc(buf[i]); //not sure this is right
-		byteswritten++;
+	while(byteswritten < length){
+		count = (length - byteswritten < MAXBUFLEN) ? length - byteswritten : MAXBUFLEN;
+		if(copy_from_user(chunk, &buf[byteswritten], count) != 0)
+			break;
+		//a character at a time so echo and other writers aren't held off
+		for(i = 0; i < count; i++){
+			spin_lock_irqsave(&console_lock, flags);
+			if(output_terminal != terminal)
+				terminal_output(terminal);
+			putc(chunk[i]);
+			spin_unlock_irqrestore(&console_lock, flags);
+		}
+		byteswritten += count;
 	}
-	sti();
-	update_cursor(screen_x, screen_y);
+	//the hardware cursor belongs to the terminal on screen
+	spin_lock_irqsave(&console_lock, flags);
+	if(output_terminal != terminal)
+		terminal_output(terminal);
+	if(terminal == current_terminal)
+		update_cursor(screen_x, screen_y);
+	spin_unlock_irqrestore(&console_lock, flags);
 	return byteswritten;
 }
 
@@ -336,10 +329,23 @@ void keyboard_init(void){
 	//initial terminal index
 	current_terminal = 0;
 
-	int j;
+	int i, j;
 	for(j = 0; j < MAXBUFLEN; j++){
 			kb_buffer[current_terminal][j] = '\0';
 	}
+	//hidden terminals start out blank
+	uint8_t* page;
+	for(j = 0; j < NUM_TERMINALS; j++){
+		page = (uint8_t*) get_terminal_back_page(j);
+		for(i = 0; i < NUM_ROWS * NUM_COLS; i++){
+			page[i << 1] = ' ';
+			page[(i << 1) + 1] = ATTRIB;
+		}
+		terminal_screenx[j] = 0;
+		terminal_screeny[j] = 0;
+	}
+	output_terminal = current_terminal;
+	work_init(&kb_work, keyboard_work);
 	enable_irq(KEYBOARD_IRQ); //enable keyboard interrupts - may need more here but it's a starting point
 	//https://www.win.tue.nl/~aeb/linux/kbd/scancodes-11.html#inputport
 
@@ -356,174 +362,212 @@ void keyboard_init(void){
 * void keyboard_handler(void);
 *   Inputs: none
 *   Return Value: none
-*	Function: handler fills the keyboard buffer and then prints it to terminal
+*	Function: only reads the scancode and queues it, the echo, scrolling and
+*		terminal switches run in keyboard_work with interrupts on
 */
 void keyboard_handler(void){
-	uint8_t scancode, keycode;
+	uint8_t scancode;
 	if(inb(KB_STATUS) & KB_STATUS_MASK){
 		scancode = inb(KB_PORT);
+		//a full queue drops the key, like the controller does
+		if((uint8_t)(kb_scan_head - kb_scan_tail) < KB_SCAN_QUEUE){
+			kb_scan[kb_scan_head % KB_SCAN_QUEUE] = scancode;
+			kb_scan_head++;
+		}
+		queue_work(&kb_work);
+	}
+	send_eoi(KEYBOARD_IRQ); //done with interrupt
+}
 
-		switch(scancode){
-			case LCTRL_ON:
-				keyboard_status.ctrl = 1;
-				break;
-			case LCTRL_OFF:
-				keyboard_status.ctrl = 0;
-				break;
-			case LSHIFT_ON:
-				keyboard_status.shift = 1;
-				break;
-			case LSHIFT_OFF:
-				keyboard_status.shift = 0;
-				break;
-			case RSHIFT_ON:
-				keyboard_status.shift = 1;
-				break;
-			case RSHIFT_OFF:
-				keyboard_status.shift = 0;
-				break;
-			case LALT_ON:
-				keyboard_status.alt = 1;
-				break;
-			case LALT_OFF:
-				keyboard_status.alt = 0;
-				break;
-			case CAPSLOCK:
-				if(!keyboard_status.capslock)
-					keyboard_status.capslock = 1;
-				else
-					keyboard_status.capslock = 0;
-				break;
-			case ENTER:
-				cli();
-				kb_buffer[current_terminal][kbbuf_index[current_terminal]] = '\n'; //not sure if we need/want this
-
-				putc('\n');
-				//copy keyboard buffer to out_buffer for reading
-				int i;
-				for(i = 0; i < kbbuf_index[current_terminal]; i++){
-					out_buffer[current_terminal][i] = kb_buffer[current_terminal][i];
+/*
+* void keyboard_work(work_t* work);
+*   Inputs: work = the keyboard's work item
+*   Return Value: none
+*	Function: runs in the worker thread, handles the queued scancodes. echo
+*		goes to the terminal on screen, whichever process was interrupted
+*/
+static void keyboard_work(work_t* work){
+	int32_t interrupted, next;
+	uint32_t flags;
+
+	while(kb_scan_tail != kb_scan_head){
+		spin_lock_irqsave(&console_lock, flags);
+		interrupted = output_terminal;
+		terminal_output(current_terminal);
+		next = keyboard_process(kb_scan[kb_scan_tail % KB_SCAN_QUEUE]);
+		kb_scan_tail++;
+		terminal_output(interrupted);
+		spin_unlock_irqrestore(&console_lock, flags);
+		if(next != KB_DEFER_NONE)
+			terminal_switch(next);
+	}
+}
+
+/*
+* int32_t keyboard_process(uint8_t scancode);
+*   Inputs: scancode = scancode read by the handler
+*   Return Value: terminal to switch to, KB_DEFER_NONE if none
+*	Function: fills the keyboard buffer and then prints it to terminal.
+*		called with the console lock held
+*/
+static int32_t keyboard_process(uint8_t scancode){
+	uint8_t keycode = 0;
+	int32_t next = KB_DEFER_NONE;
+	uint32_t flags;
+	switch(scancode){
+		case LCTRL_ON:
+			keyboard_status.ctrl = 1;
+			break;
+		case LCTRL_OFF:
+			keyboard_status.ctrl = 0;
+			break;
+		case LSHIFT_ON:
+			keyboard_status.shift = 1;
+			break;
+		case LSHIFT_OFF:
+			keyboard_status.shift = 0;
+			break;
+		case RSHIFT_ON:
+			keyboard_status.shift = 1;
+			break;
+		case RSHIFT_OFF:
+			keyboard_status.shift = 0;
+			break;
+		case LALT_ON:
+			keyboard_status.alt = 1;
+			break;
+		case LALT_OFF:
+			keyboard_status.alt = 0;
+			break;
+		case CAPSLOCK:
+			if(!keyboard_status.capslock)
+				keyboard_status.capslock = 1;
+			else
+				keyboard_status.capslock = 0;
+			break;
+		case ENTER:
+			kb_buffer[current_terminal][kbbuf_index[current_terminal]] = '\n'; //not sure if we need/want this
+
+			putc('\n');
+			//copy keyboard buffer to out_buffer for reading
+			spin_lock_irqsave(&tty_lock[current_terminal], flags);
+			int i;
+			for(i = 0; i < kbbuf_index[current_terminal]; i++){
+				out_buffer[current_terminal][i] = kb_buffer[current_terminal][i];
+			}
+			kb_buf_read[current_terminal] = 1;
+			wake_up(&kb_wait[current_terminal]);
+			spin_unlock_irqrestore(&tty_lock[current_terminal], flags);
+			//kbbuf_index = 0;
+			clear_buffer(1);
+			update_cursor(screen_x, screen_y);
+			break;
+		case BACKSPACE:
+			if(kbbuf_index[current_terminal] > 0){
+				kbbuf_index[current_terminal]--;
+				kb_buffer[current_terminal][kbbuf_index[current_terminal]] = '\0';
+
+				if(screen_x == 0 && screen_y > 0){
+					screen_x = 79;
+					screen_y--;
+					putc(' ');
+					screen_x = 79;
+					screen_y--;
+				}
+				else{
+					screen_x--;
+					putc(' ');
+					screen_x--;//have to decrement cursor again after adding space
 				}
-				sti();
-				//kbbuf_index = 0;
-				clear_buffer(1);
-				kb_buf_read[current_terminal] = 1;
+
 				update_cursor(screen_x, screen_y);
-				break;
-			case BACKSPACE:
-				if(kbbuf_index[current_terminal] > 0){
-					kbbuf_index[current_terminal]--;
-					kb_buffer[current_terminal][kbbuf_index[current_terminal]] = '\0';
-
-					if(screen_x == 0 && screen_y > 0){
-						screen_x = 79;
-						screen_y--;
-						putc(' ');
-						screen_x = 79;
-						screen_y--;
-					}
-					else{
-						screen_x--;
-						putc(' ');
-						screen_x--;//have to decrement cursor again after adding space
-					}
+			}
+			break;
+
+		//process scancode and add correct character to buffer
+		default:
+			if(!(scancode & KB_PRESS_MASK)){
 
+				//ctl+L clears screen
+				if(keyboard_status.ctrl && scancode == L){
+					scroll_to_top();	//moves current line and lower up to the top of the terminal
 					update_cursor(screen_x, screen_y);
+					update_attrib();
+					break;
+				}
+				//ctrl+C terminates a program
+				else if(keyboard_status.ctrl && scancode == C){
+						clear_buffer(1);
+						//INTERRUPT kills the processes unless they have a handler, the
+						//whole pipeline. one asleep is woken and handles it on its way
+						//out of the kernel
+						signal_terminal(current_terminal, SIG_INTERRUPT);
+						break;
 				}
-				break;
 
-			//process scancode and add correct character to buffer
-			default:
-				if(!(scancode & KB_PRESS_MASK)){
+				/*
+				TERMINAL SWITCHING NOTES
+				will need to store screen position for each terminal, need to track current terminal
+				need to store video memory of each terminal
+				probably need separate keyboard buffers for each terminal
+				probably some more stuff I'm missing
+				need to initialize current_terminal somewhere, probably in kernel on boot
+				*/
 
-					//ctl+L clears screen
-					if(keyboard_status.ctrl && scancode == L){
-						scroll_to_top();	//moves current line and lower up to the top of the terminal
-						update_cursor(screen_x, screen_y);
-						update_attrib();
-						break;
-					}
-					//ctrl+C terminates a program
-					else if(keyboard_status.ctrl && scancode == C){
-							clear_buffer(1);
-							send_eoi(KEYBOARD_IRQ);	//have to send keyboard eoi since we won't return
-							int8_t ret = 1;	//return value to shell set this to whatever we want
-							asm volatile("	movl $1, %%eax \n\
-									movl %0, %%ebx  \n\
-									int $0x80"
-									:
-									:"g"(ret)
-									:"memory", "eax"
-									);
-							break;
-					}
-
-					/*
-					TERMINAL SWITCHING NOTES
-					will need to store screen position for each terminal, need to track current terminal
-					need to store video memory of each terminal
-					probably need separate keyboard buffers for each terminal
-					probably some more stuff I'm missing
-					need to initialize current_terminal somewhere, probably in kernel on boot
-					*/
-
-
-
-
-					//switch terminal case, F2 is 3C, F1 is 3B, alt f2 is 69? alt f1 is 68 - not sure if want these
-					else if(keyboard_status.alt && scancode == F1){
-						terminal_switch(0);
 
-						break;
-					}
-					//F2 case
-					else if(keyboard_status.alt && scancode == F2){
-						terminal_switch(1);
-						break;
-					}
-					//F3 case
-					else if(keyboard_status.alt && scancode == F3){
-						terminal_switch(2);
-						break;
-					}
-
-					else if(keyboard_status.ctrl && keyboard_status.shift && scancode == TAB){
-						text_color(1);
-					}
-					else if(keyboard_status.ctrl && scancode == TAB){
-						text_color(0);
-					}
-
-					//no shift no caps
-					else if(!keyboard_status.shift && !keyboard_status.capslock){
-						keycode = KBkeys[0][scancode];
-					}
-					//only shift
-					else if(keyboard_status.shift && !keyboard_status.capslock){
-						keycode = KBkeys[1][scancode];
-					}
-					//only capslock
-					else if(!keyboard_status.shift && keyboard_status.capslock){
-						keycode = KBkeys[2][scancode];
-					}
-					//capslock and shift
-					else if(keyboard_status.shift && keyboard_status.capslock){
-						keycode = KBkeys[3][scancode];
-					}
-
-					//put into buffer
-					if(kbbuf_index[current_terminal] < MAXBUFLEN && keycode){
-						kb_buffer[current_terminal][kbbuf_index[current_terminal]] = keycode;
-						kbbuf_index[current_terminal]++;
-						putc(keycode);
-						update_cursor(screen_x, screen_y);
-					}
+
+
+				//switch terminal case, F2 is 3C, F1 is 3B, alt f2 is 69? alt f1 is 68 - not sure if want these
+				else if(keyboard_status.alt && scancode == F1){
+					next = 0; //switched once the echo is done
+
+					break;
+				}
+				//F2 case
+				else if(keyboard_status.alt && scancode == F2){
+					next = 1; //switched once the echo is done
+					break;
+				}
+				//F3 case
+				else if(keyboard_status.alt && scancode == F3){
+					next = 2; //switched once the echo is done
+					break;
 				}
-				break;
-		}
-	}
 
-	send_eoi(KEYBOARD_IRQ); //done with interrupt
+				else if(keyboard_status.ctrl && keyboard_status.shift && scancode == TAB){
+					text_color(1);
+				}
+				else if(keyboard_status.ctrl && scancode == TAB){
+					text_color(0);
+				}
 
+				//no shift no caps
+				else if(!keyboard_status.shift && !keyboard_status.capslock){
+					keycode = KBkeys[0][scancode];
+				}
+				//only shift
+				else if(keyboard_status.shift && !keyboard_status.capslock){
+					keycode = KBkeys[1][scancode];
+				}
+				//only capslock
+				else if(!keyboard_status.shift && keyboard_status.capslock){
+					keycode = KBkeys[2][scancode];
+				}
+				//capslock and shift
+				else if(keyboard_status.shift && keyboard_status.capslock){
+					keycode = KBkeys[3][scancode];
+				}
+
+				//put into buffer
+				if(kbbuf_index[current_terminal] < MAXBUFLEN && keycode){
+					kb_buffer[current_terminal][kbbuf_index[current_terminal]] = keycode;
+					kbbuf_index[current_terminal]++;
+					putc(keycode);
+					update_cursor(screen_x, screen_y);
+				}
+			}
+			break;
+	}
 
+	return next;
 }
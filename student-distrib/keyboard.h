@@ -2,6 +2,7 @@
 #define KEYBOARD_H
 
 #include "types.h"
+#include "workqueue.h"
 
 #define KB_PORT 0x60 			//I/O port number for keyboard
 #define KB_STATUS 0x64 			//not-used for this checkpoint
@@ -12,6 +13,9 @@
 #define KBKEY_ARRAY 4
 #define NUM_TERMINALS 3
 #define FOURKB 4096
+//terminal switch keyboard_process leaves for the worker, none pending
+#define KB_DEFER_NONE -1
+#define KB_SCAN_QUEUE 64 		//scancodes waiting for the worker, divides 256
 
 //special keycodes
 #define BACKSPACE 0x0E
@@ -195,6 +199,7 @@ void clear_screen(void);
 void clear_buffer(int clear_keyboard);
 int32_t terminal_read(int32_t fd, uint8_t* buf, int32_t length);
 int32_t terminal_switch(int newterminalindex);
+void terminal_output(int32_t terminal);
 int32_t terminal_write(int32_t fd, uint8_t* buf, int32_t length);
 int32_t terminal_open(int32_t fd, uint8_t* buf, int32_t length);
 int32_t terminal_close(int32_t fd, uint8_t* buf, int32_t length);
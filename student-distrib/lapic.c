@@ -0,0 +1,127 @@
+#include "lapic.h"
+#include "lib.h"
+#include "paging.h"
+#include "timer.h"
+
+//the local APIC starts the other cpus and sends them interrupts. on cpu 0 it
+//also ends the device irqs once they come through the IOAPIC, and its timer
+//drives the scheduler tick
+
+static volatile uint32_t* lapic;
+
+/*
+* uint32_t lapic_read(uint32_t reg)
+*   Inputs: reg = register offset
+*   Return Value: register value
+*/
+static uint32_t lapic_read(uint32_t reg){
+	return lapic[reg >> 2];
+}
+
+/*
+* void lapic_write(uint32_t reg, uint32_t val)
+*   Inputs: reg = register offset, val = value to write
+*   Return Value: none
+*	Function: registers are 32 bits wide at 16 byte aligned offsets
+*/
+static void lapic_write(uint32_t reg, uint32_t val){
+	lapic[reg >> 2] = val;
+	(void)lapic[LAPIC_ID >> 2]; 	//read back so the write is done
+}
+
+/*
+* void lapic_init_ap()
+*   Inputs: none
+*   Return Value: none
+*	Function: software enables the local APIC of the calling cpu, its
+*		spurious interrupts go to a vector that only irets
+*/
+void lapic_init_ap(){
+	lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_SPURIOUS_IDT);
+	lapic_write(LAPIC_ESR, 0);
+	lapic_write(LAPIC_ESR, 0);
+	lapic_eoi();
+}
+
+/*
+* void lapic_init(uint32_t base)
+*   Inputs: base = physical address of the local APICs from the MP table
+*   Return Value: none
+*	Function: maps the registers uncached and enables the APIC of cpu 0
+*/
+void lapic_init(uint32_t base){
+	map_mmio(base);
+	lapic = (volatile uint32_t*)base;
+	lapic_init_ap();
+}
+
+/*
+* uint32_t lapic_id()
+*   Inputs: none
+*   Return Value: APIC id of the calling cpu
+*/
+uint32_t lapic_id(){
+	return lapic_read(LAPIC_ID) >> LAPIC_ID_SHIFT;
+}
+
+/*
+* void lapic_eoi()
+*   Inputs: none
+*   Return Value: none
+*	Function: ends the interrupt the local APIC delivered
+*/
+void lapic_eoi(){
+	lapic_write(LAPIC_EOI, 0);
+}
+
+/*
+* void lapic_send_ipi(uint32_t apic_id, uint32_t command)
+*   Inputs: apic_id = cpu to interrupt, ignored with ICR_ALL_BUT_SELF
+*		command = ICR_* delivery mode and flags, or'd with the vector
+*   Return Value: none
+*	Function: waits until the APIC has sent the interrupt
+*/
+void lapic_send_ipi(uint32_t apic_id, uint32_t command){
+	uint32_t flags;
+
+	cli_and_save(flags);
+	lapic_write(LAPIC_ICR_HIGH, apic_id << LAPIC_ICR_DEST_SHIFT);
+	lapic_write(LAPIC_ICR_LOW, command);
+	while(lapic_read(LAPIC_ICR_LOW) & ICR_PENDING);
+	restore_flags(flags);
+}
+
+/*
+* uint32_t lapic_timer_calibrate()
+*   Inputs: none
+*   Return Value: timer counts per ms, 0 if it can't be measured
+*	Function: lets the timer count down masked for LAPIC_CALIBRATE_MS of the
+*		TSC clock. the bus clock isn't known otherwise
+*/
+uint32_t lapic_timer_calibrate(){
+	uint64_t end;
+	uint32_t counted;
+
+	if(tsc_khz == 0)
+		return 0;
+	lapic_write(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIV16);
+	lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_MASKED | LAPIC_TIMER_IDT);
+	end = clock_ns() + (uint64_t)LAPIC_CALIBRATE_MS * NSEC_PER_MSEC;
+	lapic_write(LAPIC_TIMER_INIT, LAPIC_TIMER_MAX);
+	while(clock_ns() < end);
+	counted = LAPIC_TIMER_MAX - lapic_read(LAPIC_TIMER_CURRENT);
+	lapic_write(LAPIC_TIMER_INIT, 0);
+	lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_IDT); 	//stopped until it is armed
+	return counted / LAPIC_CALIBRATE_MS;
+}
+
+/*
+* void lapic_timer_arm(uint32_t count)
+*   Inputs: count = timer counts until the interrupt, 0 stops the timer
+*   Return Value: none
+*	Function: one-shot, on LAPIC_TIMER_IDT. a single register write instead
+*		of the PIT's three port writes
+*/
+void lapic_timer_arm(uint32_t count){
+	lapic_write(LAPIC_TIMER_INIT, count);
+}
@@ -0,0 +1,50 @@
+#ifndef LAPIC_H
+#define LAPIC_H
+
+#include "types.h"
+
+//local APIC of each cpu, memory mapped at the same address on every cpu
+#define LAPIC_DEFAULT_BASE 0xFEE00000
+#define LAPIC_ID 0x020
+#define LAPIC_ID_SHIFT 24
+#define LAPIC_EOI 0x0B0
+#define LAPIC_SVR 0x0F0 					//spurious vector, bit 8 enables the APIC
+#define LAPIC_ESR 0x280
+#define LAPIC_ICR_LOW 0x300
+#define LAPIC_ICR_HIGH 0x310
+#define LAPIC_ICR_DEST_SHIFT 24
+#define LAPIC_LVT_TIMER 0x320
+#define LAPIC_TIMER_INIT 0x380 			//initial count, writing it starts the count
+#define LAPIC_TIMER_CURRENT 0x390
+#define LAPIC_TIMER_DIVIDE 0x3E0
+
+#define LAPIC_SVR_ENABLE 0x100
+#define LAPIC_SPURIOUS_IDT 0xFF 			//low nibble must be all ones on old APICs
+
+//the timer counts down the bus clock divided by 16, one-shot. it takes over
+//the scheduler tick from the PIT once irqs come through the IOAPIC
+#define LAPIC_TIMER_IDT 0xEF
+#define LAPIC_TIMER_DIV16 0x3
+#define LAPIC_TIMER_MASKED 0x10000
+#define LAPIC_TIMER_MAX 0xFFFFFFFF
+#define LAPIC_CALIBRATE_MS 10
+
+//interrupt command register
+#define ICR_FIXED 0x00000
+#define ICR_INIT 0x00500
+#define ICR_STARTUP 0x00600
+#define ICR_PENDING 0x01000 				//delivery status, still being sent
+#define ICR_ASSERT 0x04000
+#define ICR_LEVEL 0x08000
+#define ICR_ALL_BUT_SELF 0xC0000
+
+void lapic_init(uint32_t base);
+void lapic_init_ap();
+uint32_t lapic_id();
+void lapic_eoi();
+void lapic_send_ipi(uint32_t apic_id, uint32_t command);
+uint32_t lapic_timer_calibrate();
+void lapic_timer_arm(uint32_t count);
+void spurious_entry();
+
+#endif /* LAPIC_H */
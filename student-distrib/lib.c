@@ -14,6 +14,19 @@ int screen_x;
 int screen_y;
 static char* video_mem = (char *)VIDEO;
 uint8_t ATTRIB = 0x07;
+
+/*
+* void set_video_mem(char* mem);
+*   Inputs: mem = video memory or the backing page of a hidden terminal
+*   Return Value: none
+*	Function: redirects everything printed from now on, so a process on a
+*		terminal that isn't shown writes into that terminal's backing page
+*/
+void
+set_video_mem(char* mem)
+{
+	video_mem = mem;
+}
 /*
 * void clear(void);
 *   Inputs: void
@@ -622,6 +635,31 @@ strncpy(int8_t* dest, const int8_t* src, uint32_t n)
 	return dest;
 }
 
+/*
+* uint32_t div64(uint64_t* n, uint32_t base)
+*   Inputs: n = dividend, replaced by the quotient
+*		base = divisor
+*   Return Value: the remainder
+*	Function: divides a 64 bit number by a 32 bit one. gcc would call into
+*		libgcc for this, which the kernel doesn't link. the high half is
+*		divided first so divl can't overflow
+*/
+uint32_t
+div64(uint64_t* n, uint32_t base)
+{
+	uint32_t high = (uint32_t)(*n >> 32);
+	uint32_t low = (uint32_t)*n;
+	uint32_t q_high = high / base;
+	uint32_t rem;
+
+	high %= base;
+	asm("divl %4"
+			: "=a"(low), "=d"(rem)
+			: "0"(low), "1"(high), "rm"(base) );
+	*n = ((uint64_t)q_high << 32) | low;
+	return rem;
+}
+
 /*
 * void test_interrupts(void)
 *   Inputs: void
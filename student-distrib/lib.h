@@ -22,6 +22,7 @@ int8_t *itoa(uint32_t value, int8_t* buf, int32_t radix);
 int8_t *strrev(int8_t* s);
 uint32_t strlen(const int8_t* s);
 void clear(void);
+void set_video_mem(char* mem);
 void test_interrupts(void);
 
 void* memset(void* s, int32_t c, uint32_t n);
@@ -37,6 +38,37 @@ int8_t* strncpy(int8_t* dest, const int8_t*src, uint32_t n);
 int32_t bad_userspace_addr(const void* addr, int32_t len);
 int32_t safe_strncpy(int8_t* dest, const int8_t* src, int32_t n);
 
+/* 64 bit division without libgcc, n becomes the quotient */
+uint32_t div64(uint64_t* n, uint32_t base);
+
+/* Reads the time stamp counter */
+static inline uint64_t rdtsc(void)
+{
+	uint64_t val;
+	asm volatile("rdtsc"
+			: "=A"(val)
+			:
+			: "memory" );
+	return val;
+}
+
+/* Runs cpuid for the given leaf, regs gets eax, ebx, ecx and edx */
+static inline void cpuid(uint32_t leaf, uint32_t* regs)
+{
+	asm volatile("cpuid"
+			: "=a"(regs[0]), "=b"(regs[1]), "=c"(regs[2]), "=d"(regs[3])
+			: "a"(leaf), "c"(0) );
+}
+
+/* Writes a model specific register */
+static inline void wrmsr(uint32_t msr, uint64_t val)
+{
+	asm volatile("wrmsr"
+			:
+			: "c"(msr), "A"(val)
+			: "memory" );
+}
+
 /* Port read functions */
 /* Inb reads a byte and returns its value as a zero-extended 32-bit
  * unsigned int */
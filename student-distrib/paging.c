@@ -1,5 +1,12 @@
 #include "paging.h"
 #include "keyboard.h"
+#include "kdata.h"
+#include "lib.h"
+#include "multiboot.h"
+#include "shm.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "swap.h"
 
 //references: 	http://wiki.osdev.org/Setting_Up_Paging
 //		http://wiki.osdev.org/Paging
@@ -25,25 +32,64 @@
 #define FOUR_MB 0x0400000
 #define USERBIT 0x4
 #define VIRT_VID_INDEX 33				//maps to 132MB
-#define USERREADPRESENT 7
 #define TERM_1 0xB9
 #define TERM_2 0xBA
 #define TERM_3 0xBB
 #define _132MB 0x8400000
+#define USER_PD_FIRST 32 				//128MB, user regions up to the shared memory one
+#define PAGE_PWT 0x8
+#define PAGE_PCD 0x10 					//uncached, for device registers
+#define LOW_PAGES 256 					//4KB pages below 1MB
+#define MB_MEM_FLAG 0x1 				//multiboot mem_lower and mem_upper are valid
+#define MB_MODS_FLAG 0x8 				//multiboot module list is valid
+#define MB_MMAP_FLAG 0x40 				//multiboot memory map is valid
+#define MMAP_AVAILABLE 1 				//memory map type of usable ram
+#define ONE_MB 0x100000 				//mem_upper counts from here
+#define ONE_KB 1024
 
-uint32_t page_directory[NUM_INDEXES] __attribute__((aligned(ALIGN_SIZE)));
+//every cpu has its own directory and vidmap table, they only differ in the
+//user regions of the process each one runs. the kernel entries are the
+//same in all of them and don't change once the other cpus are started
+uint32_t page_directory[MAX_CPUS][NUM_INDEXES] __attribute__((aligned(ALIGN_SIZE)));
 uint32_t first_page_table[NUM_INDEXES] __attribute__((aligned(ALIGN_SIZE)));
-uint32_t video_page_table[NUM_INDEXES] __attribute__((aligned(ALIGN_SIZE)));
+uint32_t video_page_table[MAX_CPUS][NUM_INDEXES] __attribute__((aligned(ALIGN_SIZE)));
+
+#define this_directory() (page_directory[cpu_id()])
+
+static void paging_enable(uint32_t* dir);
+static int32_t frame_usable(multiboot_info_t* mbi, uint32_t frame);
+
+//stack of free physical frames in the frame pool, pop/push are O(1)
+static uint32_t free_frames[NUM_POOL_FRAMES];
+static uint32_t num_free_frames;
+static uint32_t num_pool_frames; 		//frames of the pool that exist as ram
+
+//frames that were zeroed ahead of time by the idle loop
+static uint32_t zeroed_frames[ZERO_POOL_HIGH];
+static zero_pool_stats_t zero_pool;
+static uint8_t zero_pool_refilling;
+
+//free frames in each 4MB region, a region with every frame free can back a large page
+static uint16_t region_free[FRAME_POOL_END / FOUR_MB];
+static large_page_stats_t large_pages;
+
+//the free stack, region_free and large_pages. any cpu allocates, irqs too
+static spinlock_t frame_lock = SPIN_LOCK_INIT("frame");
+//the zero pool, taken on its own so zeroing never holds up allocation
+static spinlock_t zero_lock = SPIN_LOCK_INIT("zero");
 
 
 
 /*
 * void paging init();
-*   Inputs: none
+*   Inputs: mbi = multiboot information from the boot loader, NULL if there was none
 *   Return Value: none
-*	Function: enables paging
+*	Function: enables paging. the frame pool only gets the frames the boot
+*		loader reports as usable ram
 */
-void paging_init(){
+void paging_init(multiboot_info_t* mbi){
+	uint32_t* dir = this_directory();
+	uint32_t* video = video_page_table[cpu_id()];
 
 	//initialize the directory to empty
 	uint32_t i;
@@ -53,7 +99,7 @@ void paging_init(){
 	    //   Supervisor: Only kernel-mode can access them
 	    //   Write Enabled: It can be both read from and written to
 	    //   Not Present: The page table is not present
-	    page_directory[i] = NOT_PRESENT;
+	    dir[i] = NOT_PRESENT;
 
 	    //first_page_table[i] = (i * 0x1000) | 3; //x1000 is just 4096
 	}
@@ -61,22 +107,94 @@ void paging_init(){
 
 	first_page_table[VID_MEM_LOC] = (VID_MEM_LOC * ALIGN_SIZE) | USERREADPRESENT; //map memory 0mb to 4mb to the table
 	//first_page_table[VID_MEM_LOC] = VID_MEM_LOC | USERREADPRESENT;
-	video_page_table[0] = (VID_MEM_LOC * ALIGN_SIZE) | USERREADPRESENT; //map memory 0mb to 4mb to the table
+	video[0] = (VID_MEM_LOC * ALIGN_SIZE) | USERREADPRESENT; //map memory 0mb to 4mb to the table
 	//video_page_table[VID_MEM_LOC] = VID_MEM_LOC * ALIGN_SIZE | USERREADPRESENT;
-	video_page_table[TERM_1] = (TERM_1  * ALIGN_SIZE) | USERREADPRESENT;
-	video_page_table[TERM_2] = (TERM_2  * ALIGN_SIZE) | USERREADPRESENT;
- 	video_page_table[TERM_3] = (TERM_3  * ALIGN_SIZE) | USERREADPRESENT;
+	video[TERM_1] = (TERM_1  * ALIGN_SIZE) | USERREADPRESENT;
+	video[TERM_2] = (TERM_2  * ALIGN_SIZE) | USERREADPRESENT;
+ 	video[TERM_3] = (TERM_3  * ALIGN_SIZE) | USERREADPRESENT;
+	video[KDATA_INDEX] = kdata_map(0) | USER_RO_PRESENT;
 
-	page_directory[0] = ((uint32_t)first_page_table) | PRESENT;
+	dir[0] = ((uint32_t)first_page_table) | PRESENT;
 	//directory 1 is kernel
-	page_directory[1] = KERNEL_VIRTADR | (PAGE_DIREC_SIZE_MASK | PRESENT); //map kernel as present
+	dir[1] = KERNEL_VIRTADR | (PAGE_DIREC_SIZE_MASK | PRESENT); //map kernel as present
 	add_vidpage();
 
+	//identity map the frame pool as kernel only 4MB pages so frames can be
+	//zeroed and used as page tables by the kernel
+	for(i = FRAME_POOL_START / FOUR_MB; i < FRAME_POOL_END / FOUR_MB; i++)
+		dir[i] = (i * FOUR_MB) | PAGE_DIREC_SIZE_MASK | PRESENT;
+
+	//every frame in the pool that is backed by ram starts out free, a region
+	//missing some never has all of its frames free so it is never promoted
+	num_free_frames = 0;
+	for(i = FRAME_POOL_START; i < FRAME_POOL_END; i += FRAME_SIZE){
+		if(!frame_usable(mbi, i))
+			continue;
+		free_frames[num_free_frames++] = i;
+		region_free[i / FOUR_MB]++;
+	}
+	num_pool_frames = num_free_frames;
+
+	paging_enable(dir);
+}
+
+/*
+* int32_t frame_usable(multiboot_info_t* mbi, uint32_t frame)
+*   Inputs: mbi = multiboot information, NULL if there was none
+*		frame = physical address of a frame in the pool range
+*   Return Value: 1 if the frame may go in the pool, 0 if not
+*	Function: the frame has to lie in an available region of the memory map,
+*		or below the top of upper memory when there is no map, and must not
+*		hold a boot module. with no information at all the whole range is used.
+*		runs before paging is on so the boot loader's tables can be read
+*/
+static int32_t frame_usable(multiboot_info_t* mbi, uint32_t frame){
+	memory_map_t* mmap;
+	module_t* mod;
+	uint32_t i, end;
+
+	if(mbi == NULL)
+		return 1;
+	if(mbi->flags & MB_MODS_FLAG){
+		mod = (module_t*) mbi->mods_addr;
+		for(i = 0; i < mbi->mods_count; i++){
+			if(frame < mod[i].mod_end && frame + FRAME_SIZE > mod[i].mod_start)
+				return 0;
+		}
+	}
+	if(mbi->flags & MB_MMAP_FLAG){
+		for(mmap = (memory_map_t*) mbi->mmap_addr;
+				(uint32_t) mmap < mbi->mmap_addr + mbi->mmap_length;
+				mmap = (memory_map_t*) ((uint32_t) mmap + mmap->size + sizeof(mmap->size))){
+			if(mmap->type != MMAP_AVAILABLE || mmap->base_addr_high != 0)
+				continue;
+			end = mmap->base_addr_low + mmap->length_low;
+			if(mmap->length_high != 0 || end < mmap->base_addr_low)
+				end = 0xFFFFFFFF; 		//runs past 4GB
+			if(frame >= mmap->base_addr_low && frame + FRAME_SIZE <= end)
+				return 1;
+		}
+		return 0;
+	}
+	if(mbi->flags & MB_MEM_FLAG)
+		return frame + FRAME_SIZE <= ONE_MB + mbi->mem_upper * ONE_KB;
+	return 1;
+}
+
+/*
+* void paging_enable(uint32_t* dir)
+*   Inputs: dir = page directory of the calling cpu
+*   Return Value: none
+*	Function: turns paging on for the calling cpu
+*/
+static void paging_enable(uint32_t* dir){
 	//the assembly below loads the page directory
 	//the first instruction loads the page directory into cr3
 	//the next 3 instructions set bits 4&7 of cr4 which allows pages to be
 	//4MB(pse) and address translations may be shared between address spaces (PGE)
 	//the finally the last 3 instructions set bit 31 of cr0 which enables paging
+	//and bit 16 (WP) so the kernel also faults on read-only user pages, which
+	//copy_to_user relies on to catch writes into shared program text
 
 	//the first or might need to change the 9 to a 1
 	asm volatile (
@@ -86,14 +204,64 @@ void paging_init(){
 			orl $0x00000010, %%eax	\n\
 			movl %%eax, %%cr4	\n\
 			movl %%cr0, %%eax	\n\
-			orl $0x80000000, %%eax	\n\
+			orl $0x80010000, %%eax	\n\
 			movl %%eax, %%cr0"
 			:			//outputs
-			:"g"(page_directory)	//inputs
+			:"g"(dir)	//inputs
 			:"eax"			//clobbered registers
 
 		);
+}
 
+/*
+* void paging_init_ap()
+*   Inputs: none
+*   Return Value: none
+*	Function: called by each of the other cpus as it starts. its directory
+*		gets the kernel entries of cpu 0's and no user regions, its vidmap
+*		table starts out like cpu 0's
+*/
+void paging_init_ap(){
+	uint32_t* dir = this_directory();
+	uint32_t* video = video_page_table[cpu_id()];
+	uint32_t i;
+
+	memcpy(dir, page_directory[0], sizeof(page_directory[0]));
+	memcpy(video, video_page_table[0], sizeof(video_page_table[0]));
+	video[KDATA_INDEX] = kdata_map(cpu_id()) | USER_RO_PRESENT;
+	for(i = USER_PD_FIRST; i <= SHM_PD_INDEX; i++)
+		dir[i] = NOT_PRESENT;
+	dir[VIRT_VID_INDEX] = ((uint32_t) video) | USERREADPRESENT;
+	paging_enable(dir);
+}
+
+/*
+* void map_mmio(uint32_t phys)
+*   Inputs: phys = address of device registers above the frame pool
+*   Return Value: none
+*	Function: maps the 4MB around it uncached and kernel only. must be done
+*		before the other cpus start, they copy cpu 0's kernel entries
+*/
+void map_mmio(uint32_t phys){
+	uint32_t* dir = this_directory();
+	dir[phys / FOUR_MB] = (phys & ~(FOUR_MB - 1)) | PAGE_DIREC_SIZE_MASK | PAGE_PCD | PAGE_PWT | PRESENT;
+	reset_cr3();
+}
+
+/*
+* void map_low_memory(int32_t map)
+*   Inputs: map = 1 to identity map the first 1MB, 0 to unmap it again
+*   Return Value: none
+*	Function: the bios tables and the startup code of the other cpus live
+*		there. only video memory stays mapped, so NULL still faults
+*/
+void map_low_memory(int32_t map){
+	uint32_t i;
+	for(i = 0; i < LOW_PAGES; i++){
+		if(i != VID_MEM_LOC)
+			first_page_table[i] = map ? ((i * ALIGN_SIZE) | PRESENT) : 0;
+	}
+	reset_cr3();
 }
 //find empty page directory entry index
 // uint32_t find_empty_page(){
@@ -103,12 +271,12 @@ void paging_init(){
 // }
 // //
 void add_page(uint32_t pde, uint32_t pd_index){
-	page_directory[pd_index] = pde;
+	this_directory()[pd_index] = pde;
 }
 //will need to change some things for new terminals
 void add_vidpage(){
-	page_directory[VIRT_VID_INDEX] = (uint32_t) &video_page_table;
-	page_directory[VIRT_VID_INDEX] |= USERREADPRESENT; //just in case
+	this_directory()[VIRT_VID_INDEX] = (uint32_t) video_page_table[cpu_id()];
+	this_directory()[VIRT_VID_INDEX] |= USERREADPRESENT; //just in case
 	reset_cr3();
 }
 
@@ -117,9 +285,21 @@ uint32_t* get_terminal_back_page(int terminal_index){
 	return (uint32_t*) (_132MB + (TERM_1 + terminal_index )* ALIGN_SIZE);
 }
 
-uint32_t calc_pde_val(uint32_t processid){
-	uint32_t pde = (FOUR_MB + (processid + 1) * FOUR_MB) | USERBIT | PAGE_DIREC_SIZE_MASK | PRESENT;
-	return pde;
+/*
+* void map_terminal_video(int terminal_index, int visible)
+*   Inputs: terminal_index = terminal of the process about to run
+*		visible = nonzero if that terminal is the one on screen
+*   Return Value: none
+*	Function: points the page vidmap gives user programs on this cpu at video
+*		memory, or at the terminal's backing page when it is hidden. caller
+*		must reset cr3
+*/
+void map_terminal_video(int terminal_index, int visible){
+	uint32_t* video = video_page_table[cpu_id()];
+	if(visible)
+		video[0] = (VID_MEM_LOC * ALIGN_SIZE) | USERREADPRESENT;
+	else
+		video[0] = ((TERM_1 + terminal_index) * ALIGN_SIZE) | USERREADPRESENT;
 }
 
 void reset_cr3(){
@@ -128,7 +308,399 @@ void reset_cr3(){
 		movl %%eax, %%cr3 \n\
 		"
 		:
-		:"c"(page_directory)
+		:"c"(this_directory())
 		: "eax"
 	);
 }
+
+/*
+* uint32_t alloc_frame()
+*   Inputs: none
+*   Return Value: physical address of a free 4KB frame, NO_FRAME if the pool is empty
+*	Function: pops a frame off the free frame stack, reclaiming cold pages into
+*		the compressed swap pool if the stack is empty
+*/
+uint32_t alloc_frame(){
+	uint32_t frame = alloc_frame_noreclaim();
+
+	//out of frames, compress cold pages of idle processes and try again
+	if(frame == NO_FRAME && swap_reclaim(SWAP_BATCH) > 0)
+		frame = alloc_frame_noreclaim();
+	return frame;
+}
+
+/*
+* uint32_t alloc_frame_noreclaim()
+*   Inputs: none
+*   Return Value: physical address of a free 4KB frame, NO_FRAME if the stack is empty
+*	Function: pops a frame off the free frame stack without falling back to
+*		swap, for allocations that are only worth making out of spare memory
+*/
+uint32_t alloc_frame_noreclaim(){
+	uint32_t flags, frame = NO_FRAME;
+	spin_lock_irqsave(&frame_lock, flags);
+	if(num_free_frames > 0){
+		frame = free_frames[--num_free_frames];
+		region_free[frame / FOUR_MB]--;
+	}
+	spin_unlock_irqrestore(&frame_lock, flags);
+	return frame;
+}
+
+/*
+* void free_frame(uint32_t frame)
+*   Inputs: frame = physical address of a frame from alloc_frame
+*   Return Value: none
+*	Function: pushes the frame back onto the free frame stack
+*/
+void free_frame(uint32_t frame){
+	uint32_t flags;
+	if(frame < FRAME_POOL_START || frame >= FRAME_POOL_END)
+		return;
+	spin_lock_irqsave(&frame_lock, flags);
+	free_frames[num_free_frames++] = frame & ~(FRAME_SIZE - 1);
+	region_free[frame / FOUR_MB]++;
+	spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/*
+* uint32_t alloc_zeroed_frame()
+*   Inputs: none
+*   Return Value: physical address of a zero filled 4KB frame, NO_FRAME if out of memory
+*	Function: takes a frame from the pre-zeroed pool, falling back to zeroing a
+*		free frame on the spot when the pool is empty
+*/
+uint32_t alloc_zeroed_frame(){
+	uint32_t flags, frame = NO_FRAME;
+	spin_lock_irqsave(&zero_lock, flags);
+	if(zero_pool.count > 0){
+		frame = zeroed_frames[--zero_pool.count];
+		zero_pool.hits++;
+	}
+	else
+		zero_pool.misses++;
+	spin_unlock_irqrestore(&zero_lock, flags);
+
+	if(frame == NO_FRAME){
+		frame = alloc_frame();
+		if(frame != NO_FRAME)
+			memset((void*) frame, 0, FRAME_SIZE);
+	}
+	return frame;
+}
+
+/*
+* int32_t zero_pool_refill()
+*   Inputs: none
+*   Return Value: 1 if a frame was zeroed, 0 if there was nothing to do
+*	Function: called when the cpu would otherwise idle. Once the pool drops below
+*		the low watermark, zeroes one free frame per call until the high watermark
+*		is reached so each call only does a bounded amount of work. idle cpus
+*		may refill at the same time, the push drops a frame the pool has no
+*		room left for
+*/
+int32_t zero_pool_refill(){
+	uint32_t frame;
+	uint32_t flags;
+
+	spin_lock_irqsave(&zero_lock, flags);
+	if(zero_pool.count < ZERO_POOL_LOW)
+		zero_pool_refilling = 1;
+	if(!zero_pool_refilling || zero_pool.count >= ZERO_POOL_HIGH){
+		zero_pool_refilling = 0;
+		spin_unlock_irqrestore(&zero_lock, flags);
+		return 0;
+	}
+	spin_unlock_irqrestore(&zero_lock, flags);
+
+	//compressing process pages to prezero frames would cost more than it saves
+	frame = alloc_frame_noreclaim();
+	if(frame == NO_FRAME){
+		zero_pool_refilling = 0;
+		return 0;
+	}
+	//zero with interrupts on, only the push needs the lock
+	memset((void*) frame, 0, FRAME_SIZE);
+
+	spin_lock_irqsave(&zero_lock, flags);
+	if(zero_pool.count < ZERO_POOL_HIGH){
+		zeroed_frames[zero_pool.count++] = frame;
+		frame = NO_FRAME;
+	}
+	spin_unlock_irqrestore(&zero_lock, flags);
+	if(frame != NO_FRAME)
+		free_frame(frame);
+	return 1;
+}
+
+/*
+* uint32_t free_frame_count()
+*   Inputs: none
+*   Return Value: number of frames on the free frame stack
+*	Function: used for memory accounting
+*/
+uint32_t free_frame_count(){
+	return num_free_frames;
+}
+
+/*
+* uint32_t pool_frame_count()
+*   Inputs: none
+*   Return Value: number of frames the pool was given at boot
+*	Function: used for memory accounting, the pool range can be larger than
+*		the machine's memory
+*/
+uint32_t pool_frame_count(){
+	return num_pool_frames;
+}
+
+/*
+* uint32_t table_frame_count(uint32_t* table)
+*   Inputs: table = page table of a user region, or NULL
+*   Return Value: frames held privately through the table, counting the table itself
+*	Function: read-only entries point at shared frames that belong to someone
+*		else (image cache or shared memory) so they are not counted
+*/
+uint32_t table_frame_count(uint32_t* table){
+	uint32_t i, count;
+	if(table == NULL)
+		return 0;
+	count = 1;
+	for(i = 0; i < PAGES_PER_REGION; i++){
+		if((table[i] & PAGE_PRESENT_BIT) && (table[i] & PAGE_RW))
+			count++;
+	}
+	return count;
+}
+
+/*
+* void get_zero_pool_stats(zero_pool_stats_t* stats)
+*   Inputs: stats = struct to fill in
+*   Return Value: none
+*	Function: copies out the hit/miss counters and current size of the zero pool
+*/
+void get_zero_pool_stats(zero_pool_stats_t* stats){
+	uint32_t flags;
+	if(stats == NULL)
+		return;
+	spin_lock_irqsave(&zero_lock, flags);
+	*stats = zero_pool;
+	spin_unlock_irqrestore(&zero_lock, flags);
+}
+
+/*
+* int32_t heap_grow(uint32_t** table, uint32_t old_brk, uint32_t new_brk)
+*   Inputs: table = pointer to the heap page table of the process (allocated if NULL)
+*		old_brk = current end of the heap
+*		new_brk = requested end of the heap
+*   Return Value: 0 on success, -1 if out of frames
+*	Function: maps zeroed frames for every page between old_brk and new_brk
+*/
+int32_t heap_grow(uint32_t** table, uint32_t old_brk, uint32_t new_brk){
+	uint32_t first = (old_brk - USER_HEAP_START + FRAME_SIZE - 1) / FRAME_SIZE;
+	uint32_t last = (new_brk - USER_HEAP_START + FRAME_SIZE - 1) / FRAME_SIZE;
+	uint32_t i, frame;
+
+	if(first == last)
+		return 0;
+
+	if(*table == NULL){
+		frame = alloc_zeroed_frame();
+		if(frame == NO_FRAME)
+			return -1;
+		*table = (uint32_t*) frame;
+	}
+
+	for(i = first; i < last; i++){
+		frame = alloc_zeroed_frame();
+		if(frame == NO_FRAME){
+			//undo the partial grow so the heap stays at old_brk
+			heap_shrink(*table, USER_HEAP_START + i * FRAME_SIZE, old_brk);
+			return -1;
+		}
+		(*table)[i] = frame | USERREADPRESENT;
+	}
+	return 0;
+}
+
+/*
+* void heap_shrink(uint32_t* table, uint32_t old_brk, uint32_t new_brk)
+*   Inputs: table = heap page table of the process
+*		old_brk = current end of the heap
+*		new_brk = new (lower) end of the heap
+*   Return Value: none
+*	Function: unmaps and frees every page that lies completely above new_brk
+*/
+void heap_shrink(uint32_t* table, uint32_t old_brk, uint32_t new_brk){
+	uint32_t first = (new_brk - USER_HEAP_START + FRAME_SIZE - 1) / FRAME_SIZE;
+	uint32_t last = (old_brk - USER_HEAP_START + FRAME_SIZE - 1) / FRAME_SIZE;
+	uint32_t i;
+
+	if(table == NULL)
+		return;
+	for(i = first; i < last; i++){
+		if(table[i] & PRESENT){
+			free_frame(table[i]);
+			table[i] = 0;
+		}
+		else if(table[i] & PAGE_SWAPPED){
+			swap_discard(table[i]);
+			table[i] = 0;
+		}
+	}
+	reset_cr3();
+}
+
+/*
+* void heap_release(uint32_t* table)
+*   Inputs: table = heap page table of a halting process
+*   Return Value: none
+*	Function: frees every heap frame and the page table itself
+*/
+void heap_release(uint32_t* table){
+	if(table == NULL)
+		return;
+	heap_shrink(table, USER_HEAP_END, USER_HEAP_START);
+	free_frame((uint32_t) table);
+}
+
+/*
+* void set_heap_table(uint32_t* table, uint32_t large)
+*   Inputs: table = heap page table of the process being switched to, or NULL
+*		large = nonzero if the heap is promoted to a large page
+*   Return Value: none
+*	Function: installs the heap at 136MB, caller must reset cr3
+*/
+void set_heap_table(uint32_t* table, uint32_t large){
+	this_directory()[HEAP_PD_INDEX] = region_pde(table, large);
+}
+
+/*
+* uint32_t region_pde(uint32_t* table, uint32_t large)
+*   Inputs: table = page table of a 4MB user region, or NULL
+*		large = nonzero if the region is promoted to a large page
+*   Return Value: page directory entry for the region
+*	Function: a promoted region maps the 4MB block its pages live in with one
+*		PSE entry, otherwise the page table is used
+*/
+uint32_t region_pde(uint32_t* table, uint32_t large){
+	if(table == NULL)
+		return NOT_PRESENT;
+	if(large)
+		return (table[0] & ~(FOUR_MB - 1)) | PAGE_DIREC_SIZE_MASK | USERREADPRESENT;
+	return ((uint32_t) table) | USERREADPRESENT;
+}
+
+/*
+* uint32_t take_free_region()
+*   Inputs: none
+*   Return Value: base of a 4MB aligned block of free frames, NO_FRAME if none
+*	Function: removes every frame of a completely free 4MB region from the free
+*		frame stack. this walks the whole stack so it is only used for promotion
+*/
+static uint32_t take_free_region(){
+	uint32_t flags, r, i, kept = 0;
+	uint32_t base = NO_FRAME;
+
+	spin_lock_irqsave(&frame_lock, flags);
+	for(r = FRAME_POOL_START / FOUR_MB; r < FRAME_POOL_END / FOUR_MB; r++){
+		if(region_free[r] == PAGES_PER_REGION){
+			base = r * FOUR_MB;
+			break;
+		}
+	}
+	if(base != NO_FRAME){
+		for(i = 0; i < num_free_frames; i++){
+			if(free_frames[i] / FOUR_MB != r)
+				free_frames[kept++] = free_frames[i];
+		}
+		num_free_frames = kept;
+		region_free[r] = 0;
+	}
+	spin_unlock_irqrestore(&frame_lock, flags);
+	return base;
+}
+
+/*
+* int32_t promote_table(uint32_t* table)
+*   Inputs: table = page table of a 4MB user region
+*   Return Value: 0 if the region can now be mapped as a large page, -1 otherwise
+*	Function: checks that all 1024 pages are present and private. if their frames
+*		already form an aligned 4MB block (e.g. after a demotion) nothing moves,
+*		otherwise the pages are copied into a free 4MB block and the old frames
+*		are freed. the table is rewritten to point into the block
+*/
+int32_t promote_table(uint32_t* table){
+	uint32_t i, base, frame, flags;
+	uint32_t contiguous = 1, copied = 0;
+
+	if(table == NULL)
+		return -1;
+	base = table[0] & ~(FRAME_SIZE - 1);
+	for(i = 0; i < PAGES_PER_REGION; i++){
+		if(!(table[i] & PAGE_PRESENT_BIT) || !(table[i] & PAGE_RW))
+			return -1;
+		if((table[i] & ~(FRAME_SIZE - 1)) != base + i * FRAME_SIZE)
+			contiguous = 0;
+	}
+
+	if(!contiguous || base % FOUR_MB != 0){
+		base = take_free_region();
+		if(base == NO_FRAME)
+			return -1;
+		for(i = 0; i < PAGES_PER_REGION; i++){
+			frame = table[i] & ~(FRAME_SIZE - 1);
+			memcpy((void*) (base + i * FRAME_SIZE), (void*) frame, FRAME_SIZE);
+			free_frame(frame);
+			table[i] = (base + i * FRAME_SIZE) | USERREADPRESENT;
+		}
+		copied = 1;
+	}
+	spin_lock_irqsave(&frame_lock, flags);
+	large_pages.copied += copied;
+	large_pages.promotions++;
+	spin_unlock_irqrestore(&frame_lock, flags);
+	return 0;
+}
+
+/*
+* void count_demotion()
+*   Inputs: none
+*   Return Value: none
+*	Function: records that a large page was split back into its 4KB table.
+*		splitting is free since the table still describes every page
+*/
+void count_demotion(){
+	uint32_t flags;
+	spin_lock_irqsave(&frame_lock, flags);
+	large_pages.demotions++;
+	spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/*
+* void get_large_page_stats(large_page_stats_t* stats)
+*   Inputs: stats = struct to fill in
+*   Return Value: none
+*	Function: copies out the promotion and demotion counters
+*/
+void get_large_page_stats(large_page_stats_t* stats){
+	uint32_t flags;
+	if(stats == NULL)
+		return;
+	spin_lock_irqsave(&frame_lock, flags);
+	*stats = large_pages;
+	spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/*
+* void set_shm_table(uint32_t* table)
+*   Inputs: table = shared memory page table of the process being switched to, or NULL
+*   Return Value: none
+*	Function: installs the shared memory page table at 140MB, caller must reset cr3
+*/
+void set_shm_table(uint32_t* table){
+	if(table == NULL)
+		this_directory()[SHM_PD_INDEX] = NOT_PRESENT;
+	else
+		this_directory()[SHM_PD_INDEX] = ((uint32_t) table) | USERREADPRESENT;
+}
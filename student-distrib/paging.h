@@ -2,18 +2,85 @@
 #define _PAGING_H
 
 #include "types.h"
+#include "multiboot.h"
 
+//physical frame pool used for dynamically allocated 4KB pages (8MB - 128MB),
+//clipped to the ram the boot loader reports
+#define FRAME_POOL_START 0x00800000
+#define FRAME_POOL_END 0x08000000
+#define FRAME_SIZE 0x1000
+#define NUM_POOL_FRAMES ((FRAME_POOL_END - FRAME_POOL_START) / FRAME_SIZE)
+#define NO_FRAME 0
+#define USERREADPRESENT 7 					//user, read/write, present
+#define USER_RO_PRESENT 5 					//user, read only, present
+#define PAGE_PRESENT_BIT 0x1
+#define PAGE_RW 0x2 						//clear for shared read only text pages
+#define PAGE_ACCESSED 0x20 					//set by the cpu whenever the page is touched
+#define PAGE_SWAPPED 0x200 					//available bit 9, page lives in the compressed swap pool
+#define SWAP_INDEX_SHIFT 12 				//swap entry index is kept where the frame address would be
 
+//pre-zeroed frames kept ready for page tables and demand-zero pages
+#define ZERO_POOL_LOW 16 					//idle loop starts zeroing below this
+#define ZERO_POOL_HIGH 64 					//and stops once the pool is this full
+
+typedef struct zero_pool_stats_t {
+	uint32_t hits; 						//allocations served from the pool
+	uint32_t misses; 					//allocations that had to zero on the spot
+	uint32_t count; 					//frames currently in the pool
+} zero_pool_stats_t;
+
+//a heap grown to fill its 4MB region, all 1024 pages private and present, is
+//promoted to a single PSE large page. the 4KB table is kept as a description
+//of the pages. the program region never is, one large page can't keep its
+//shared text read only
+#define LARGE_HEAP 0x2 						//heap region at 136MB is promoted
+#define PAGES_PER_REGION 1024
+//video memory and the three terminal backing pages, fixed pages below 4MB
+#define VIDEO_FRAMES 4
+
+typedef struct large_page_stats_t {
+	uint32_t promotions; 				//regions collapsed into a large page
+	uint32_t copied; 					//promotions that had to copy into a free 4MB block
+	uint32_t demotions; 				//large pages split back into 4KB pages
+} large_page_stats_t;
+
+//user heap, grown by sbrk, lives in its own page table at 136MB
+#define USER_HEAP_START 0x08800000
+#define USER_HEAP_END 0x08C00000
+#define HEAP_PD_INDEX 34
 
 //paging functions
-void paging_init();
+void paging_init(multiboot_info_t* mbi);
+void paging_init_ap();
+void map_mmio(uint32_t phys);
+void map_low_memory(int32_t map);
 //uint32_t add_page();
 //uint32_t find_empty_page();
-uint32_t calc_pde_val(uint32_t processid);
 void add_vidpage();
 void add_page(uint32_t pde, uint32_t pd_index);
 void reset_cr3();
 uint32_t* get_terminal_back_page(int terminal_index);
+void map_terminal_video(int terminal_index, int visible);
+
+//frame pool and user heap functions
+uint32_t alloc_frame();
+uint32_t alloc_frame_noreclaim();
+void free_frame(uint32_t frame);
+uint32_t alloc_zeroed_frame();
+int32_t zero_pool_refill();
+void get_zero_pool_stats(zero_pool_stats_t* stats);
+int32_t heap_grow(uint32_t** table, uint32_t old_brk, uint32_t new_brk);
+void heap_shrink(uint32_t* table, uint32_t old_brk, uint32_t new_brk);
+void heap_release(uint32_t* table);
+void set_heap_table(uint32_t* table, uint32_t large);
+uint32_t region_pde(uint32_t* table, uint32_t large);
+int32_t promote_table(uint32_t* table);
+void count_demotion();
+void get_large_page_stats(large_page_stats_t* stats);
+uint32_t free_frame_count();
+uint32_t pool_frame_count();
+uint32_t table_frame_count(uint32_t* table);
+void set_shm_table(uint32_t* table);
 
 
 #endif
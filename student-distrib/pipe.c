@@ -0,0 +1,206 @@
+#include "pipe.h"
+#include "exceptions.h"
+#include "lib.h"
+#include "paging.h"
+#include "uaccess.h"
+
+//a pipe connects two processes, usually two stages of a shell pipeline in
+//different slots of curr_task. readers block until there is data or every
+//write end is closed, writers block until there is room. the descriptors of
+//both ends keep the pipe index in their device field
+
+static pipe_t pipes[MAX_PIPES] = {
+	{SPIN_LOCK_INIT("pipe0")}, {SPIN_LOCK_INIT("pipe1")}, {SPIN_LOCK_INIT("pipe2")}, {SPIN_LOCK_INIT("pipe3")},
+	{SPIN_LOCK_INIT("pipe4")}, {SPIN_LOCK_INIT("pipe5")}, {SPIN_LOCK_INIT("pipe6")}, {SPIN_LOCK_INIT("pipe7")}
+};
+
+/*
+* pipe_t* fd_pipe(int32_t fd, int32_t* end)
+*   Inputs: fd = descriptor of the current process, end = gets PIPE_READ or PIPE_WRITE
+*   Return Value: the pipe the descriptor is open on
+*	Function: only the read end has a read function
+*/
+static pipe_t* fd_pipe(int32_t fd, int32_t* end){
+	file_descriptor_t* file = &curr_task[running_slot]->file_array[fd];
+	*end = (file->opt->read != NULL) ? PIPE_READ : PIPE_WRITE;
+	return &pipes[file->device];
+}
+
+/*
+* int32_t pipe_create()
+*   Inputs: none
+*   Return Value: index of a new pipe with one reader and one writer, -1 if
+*		every pipe is in use or the pool is out of frames
+*	Function: gets the ring buffer from the frame pool
+*/
+int32_t pipe_create(){
+	uint32_t frame, flags;
+	int32_t i;
+
+	frame = alloc_frame();
+	if(frame == NO_FRAME)
+		return -1;
+	for(i = 0; i < MAX_PIPES; i++){
+		spin_lock_irqsave(&pipes[i].lock, flags);
+		if(pipes[i].buf == NULL){
+			pipes[i].buf = (uint8_t*)frame;
+			pipes[i].head = 0;
+			pipes[i].tail = 0;
+			pipes[i].readers = 1;
+			pipes[i].writers = 1;
+			pipes[i].read_wait.head = NULL;
+			pipes[i].write_wait.head = NULL;
+			spin_unlock_irqrestore(&pipes[i].lock, flags);
+			return i;
+		}
+		spin_unlock_irqrestore(&pipes[i].lock, flags);
+	}
+	free_frame(frame);
+	return -1;
+}
+
+/*
+* void pipe_dup(int32_t pipe, int32_t end)
+*   Inputs: pipe = pipe index, end = PIPE_READ or PIPE_WRITE
+*   Return Value: none
+*	Function: counts another descriptor on the end, e.g. one handed to a child
+*/
+void pipe_dup(int32_t pipe, int32_t end){
+	uint32_t flags;
+
+	spin_lock_irqsave(&pipes[pipe].lock, flags);
+	if(end == PIPE_READ)
+		pipes[pipe].readers++;
+	else
+		pipes[pipe].writers++;
+	spin_unlock_irqrestore(&pipes[pipe].lock, flags);
+}
+
+/*
+* int32_t pipe_read(int32_t fd, uint8_t* buf, int32_t length)
+*   Inputs: fd = read end, buf = user buffer, length = most bytes to read
+*   Return Value: bytes read, 0 at the end of the data once no writer is
+*		left, -1 on a bad buffer or length
+*	Function: sleeps while the pipe is empty, then takes whatever is there
+*/
+int32_t pipe_read(int32_t fd, uint8_t* buf, int32_t length){
+	int32_t end;
+	pipe_t* p = fd_pipe(fd, &end);
+	uint32_t tail, count, first, flags;
+
+	//a read of 0 bytes would return 0, which readers take for the end
+	if(buf == NULL || length <= 0)
+		return -1;
+	spin_lock_irqsave(&p->lock, flags);
+	while(p->head == p->tail){
+		if(p->writers == 0){
+			spin_unlock_irqrestore(&p->lock, flags);
+			return 0;
+		}
+		if(signal_pending(curr_task[running_slot])){
+			spin_unlock_irqrestore(&p->lock, flags);
+			return ERESTART;
+		}
+		//the lock is let go once on the wait queue, so a write can't be missed
+		sleep_on(&p->read_wait, &p->lock);
+	}
+
+	tail = p->tail;
+	count = p->head - tail;
+	if(count > (uint32_t)length)
+		count = length;
+	first = PIPE_SIZE - (tail & PIPE_MASK);
+	if(first > count)
+		first = count;
+	if(copy_to_user(buf, p->buf + (tail & PIPE_MASK), first) != 0 ||
+			copy_to_user(buf + first, p->buf, count - first) != 0){
+		spin_unlock_irqrestore(&p->lock, flags);
+		return -1;
+	}
+	p->tail = tail + count;
+	wake_up(&p->write_wait);
+	spin_unlock_irqrestore(&p->lock, flags);
+	return count;
+}
+
+/*
+* int32_t pipe_write(int32_t fd, uint8_t* buf, int32_t length)
+*   Inputs: fd = write end, buf = user buffer, length = bytes to write
+*   Return Value: length, fewer if a signal or a bad buffer stopped it part
+*		way, -1 if no reader is left
+*	Function: copies in as much as fits, sleeping while the pipe is full
+*/
+int32_t pipe_write(int32_t fd, uint8_t* buf, int32_t length){
+	int32_t end;
+	pipe_t* p = fd_pipe(fd, &end);
+	uint32_t head, count, first, flags;
+	int32_t written = 0;
+
+	if(buf == NULL || length < 0)
+		return -1;
+	while(written < length){
+		spin_lock_irqsave(&p->lock, flags);
+		while(p->readers != 0 && p->head - p->tail == PIPE_SIZE){
+			if(signal_pending(curr_task[running_slot])){
+				spin_unlock_irqrestore(&p->lock, flags);
+				return (written > 0) ? written : ERESTART;
+			}
+			sleep_on(&p->write_wait, &p->lock);
+		}
+		if(p->readers == 0){
+			spin_unlock_irqrestore(&p->lock, flags);
+			return -1; 		//nobody will ever read it
+		}
+
+		head = p->head;
+		count = PIPE_SIZE - (head - p->tail);
+		if(count > (uint32_t)(length - written))
+			count = length - written;
+		first = PIPE_SIZE - (head & PIPE_MASK);
+		if(first > count)
+			first = count;
+		if(copy_from_user(p->buf + (head & PIPE_MASK), buf + written, first) != 0 ||
+				copy_from_user(p->buf, buf + written + first, count - first) != 0){
+			spin_unlock_irqrestore(&p->lock, flags);
+			return (written > 0) ? written : -1;
+		}
+		p->head = head + count;
+		written += count;
+		wake_up(&p->read_wait);
+		spin_unlock_irqrestore(&p->lock, flags);
+	}
+	return written;
+}
+
+/*
+* int32_t pipe_close(int32_t fd, uint8_t* buf, int32_t length)
+*   Inputs: fd = either end
+*   Return Value: 0
+*	Function: wakes the other end when the last descriptor of this end goes,
+*		so a reader sees the end of the data and a writer stops. the frame
+*		goes back once both ends are closed
+*/
+int32_t pipe_close(int32_t fd, uint8_t* buf, int32_t length){
+	int32_t end;
+	pipe_t* p = fd_pipe(fd, &end);
+	uint8_t* ring = NULL;
+	uint32_t flags;
+
+	spin_lock_irqsave(&p->lock, flags);
+	if(end == PIPE_READ){
+		if(--p->readers == 0)
+			wake_up(&p->write_wait);
+	}
+	else{
+		if(--p->writers == 0)
+			wake_up(&p->read_wait);
+	}
+	if(p->readers == 0 && p->writers == 0){
+		ring = p->buf;
+		p->buf = NULL;
+	}
+	spin_unlock_irqrestore(&p->lock, flags);
+	if(ring != NULL)
+		free_frame((uint32_t)ring);
+	return 0;
+}
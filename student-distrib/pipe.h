@@ -0,0 +1,35 @@
+#ifndef PIPE_H
+#define PIPE_H
+
+#include "types.h"
+#include "sched.h"
+#include "spinlock.h"
+
+//kernel pipes, a 4KB ring from the frame pool per pipe
+#define MAX_PIPES 8
+#define PIPE_SIZE 4096 					//one frame, a power of two
+#define PIPE_MASK (PIPE_SIZE - 1)
+#define PIPE_READ 0 					//ends, the order pipe returns them in
+#define PIPE_WRITE 1
+
+//ring of bytes, both ends may be open in processes on different cpus. the
+//lock covers the counts and the copies in and out, at most a frame. head
+//and tail count bytes and wrap at 2^32
+typedef struct pipe_t {
+	spinlock_t lock;
+	uint8_t* buf; 						//NULL if the pipe is free
+	volatile uint32_t head; 			//bytes written
+	volatile uint32_t tail; 			//bytes read
+	uint32_t readers; 					//descriptors open on each end
+	uint32_t writers;
+	wait_queue_t read_wait; 			//reader waiting for data or the last writer
+	wait_queue_t write_wait; 			//writer waiting for room or the last reader
+} pipe_t;
+
+int32_t pipe_create();
+void pipe_dup(int32_t pipe, int32_t end);
+int32_t pipe_read(int32_t fd, uint8_t* buf, int32_t length);
+int32_t pipe_write(int32_t fd, uint8_t* buf, int32_t length);
+int32_t pipe_close(int32_t fd, uint8_t* buf, int32_t length);
+
+#endif /* PIPE_H */
@@ -1,6 +1,10 @@
 #include "rtc.h"
+#include "exceptions.h"
 #include "i8259.h"
 #include "lib.h"
+#include "paging.h"
+#include "uaccess.h"
+#include "spinlock.h"
 
 
 //rtc based off motorola MC146818 - there are some newer variants
@@ -8,19 +12,51 @@
 //https://www.kernel.org/doc/Documentation/rtc.txt
 
 
-//rate must be above 2 and not over 15
-#define RTC_RATE 15
+//rate must be above 2 and not over 15, 6 is MAX_FREQ. the hardware always
+//runs this fast and every descriptor divides it down to its own rate
+#define RTC_RATE 6
 #define RTC_MASK1 0x0F
 #define RTC_MASK2 0xF0
 #define RTC_IRQ 8
+#define RTC_FREE 0
+#define RTC_USED 1
 
-volatile int interrupt_flag; //used to check next interrupt
+//one virtual rtc per open descriptor
+typedef struct rtc_vdev_t {
+	uint32_t flags;
+	uint32_t freq;
+	uint32_t divider; 				//hardware ticks per virtual tick
+	uint32_t count; 				//hardware ticks left until the next virtual tick
+	uint32_t ticks; 				//virtual ticks since open
+	uint32_t fired_at; 				//hardware tick of the last virtual tick
+	uint32_t read_ticks; 			//ticks when the last read returned
+	uint32_t missed;
+	uint32_t reads;
+	uint32_t jitter_max;
+	uint32_t jitter_sum;
+	wait_queue_t wait; 				//reader sleeping until the next tick
+} rtc_vdev_t;
+
+static rtc_vdev_t vdevs[RTC_VDEVS];
+static uint32_t vdevs_open;
+static volatile uint32_t rtc_ticks; 	//hardware ticks while any rtc is open
+//the virtual rtcs and the cmos index port, the irq takes it too
+static spinlock_t rtc_lock = SPIN_LOCK_INIT("rtc");
 
 
 //code is referenced from link below
 //http://wiki.osdev.org/RTC
+/*
+* void rtc_init()
+*   Inputs: none
+*   Return Value: none
+*	Function: turns on periodic interrupts at MAX_FREQ. the irq stays masked
+*		until the first rtc is opened so an idle system isn't interrupted
+*		a thousand times a second
+*/
 void rtc_init(void){
 	char prev;
+	uint32_t flags;
 	//select register B for reading
 	outb(RTC_REG_B, RTC_CMD);
 	//store current value stored in register B
@@ -33,75 +69,195 @@ void rtc_init(void){
 	int rate = (int) RTC_RATE;
 	rate &= RTC_MASK1;
  	// select register A for reading
- 	cli();
+	spin_lock_irqsave(&rtc_lock, flags);
 	outb(RTC_REG_A, RTC_CMD);
 	prev = inb(RTC_MEM);
 	outb(RTC_REG_A, RTC_CMD);
 	outb((prev & RTC_MASK2) | rate, RTC_MEM);
-	sti();
-	enable_irq(RTC_IRQ);
+	spin_unlock_irqrestore(&rtc_lock, flags);
 }
 //will need an interrupt handler is in exceptions.c
 
-//return 0 after an interrupt has occurred
+/*
+* uint8_t cmos_read(uint8_t reg)
+*   Inputs: reg = cmos register
+*   Return Value: its value
+*	Function: reads one register of the cmos clock
+*/
+static uint8_t cmos_read(uint8_t reg){
+	outb(reg, RTC_CMD);
+	return inb(RTC_MEM);
+}
+
+//days before the first of each month in a non leap year
+static const uint16_t month_days[12] = {0, 31, 59, 90, 120, 151, 181, 212, 243, 273, 304, 334};
+
+/*
+* uint32_t rtc_read_time()
+*   Inputs: none
+*   Return Value: seconds since 1970 (utc if the cmos clock is kept in utc)
+*	Function: reads the date and time off the cmos clock. reads again if it
+*		updated in between so the fields belong to the same second
+*/
+uint32_t rtc_read_time(void){
+	uint8_t sec, min, hour, day, month, year, regb;
+	uint32_t years, days, flags;
+	int32_t pm;
+
+	spin_lock_irqsave(&rtc_lock, flags);
+	do{
+		while(cmos_read(RTC_REG_A) & CMOS_UPDATING)
+			;
+		sec = cmos_read(CMOS_SECONDS);
+		min = cmos_read(CMOS_MINUTES);
+		hour = cmos_read(CMOS_HOURS);
+		day = cmos_read(CMOS_DAY);
+		month = cmos_read(CMOS_MONTH);
+		year = cmos_read(CMOS_YEAR);
+	} while(sec != cmos_read(CMOS_SECONDS));
+	regb = cmos_read(RTC_REG_B);
+	spin_unlock_irqrestore(&rtc_lock, flags);
+
+	pm = hour & CMOS_PM;
+	hour &= ~CMOS_PM;
+	if(!(regb & CMOS_BINARY)){
+		//bcd, one decimal digit per nibble
+		sec = (sec & RTC_MASK1) + (sec >> 4) * 10;
+		min = (min & RTC_MASK1) + (min >> 4) * 10;
+		hour = (hour & RTC_MASK1) + (hour >> 4) * 10;
+		day = (day & RTC_MASK1) + (day >> 4) * 10;
+		month = (month & RTC_MASK1) + (month >> 4) * 10;
+		year = (year & RTC_MASK1) + (year >> 4) * 10;
+	}
+	if(!(regb & CMOS_24HOUR))
+		hour = (hour % 12) + (pm ? 12 : 0);
+	if(month < 1 || month > 12)
+		return 0;
+
+	//every 4th year is a leap year from 1972 until 2100
+	years = CMOS_CENTURY + year - EPOCH_YEAR;
+	days = years * 365 + (years + 1) / 4 + month_days[month - 1] + day - 1;
+	if((year % 4) == 0 && month > 2)
+		days++;
+	return ((days * 24 + hour) * 60 + min) * 60 + sec;
+}
+
+/*
+* void rtc_tick()
+*   Inputs: none
+*   Return Value: none
+*	Function: called by the rtc handler for every hardware tick. reads
+*		register C so the rtc interrupts again, counts down every open
+*		virtual rtc and wakes its reader when it ticks
+*/
+void rtc_tick(void){
+	uint32_t i;
+	rtc_vdev_t* v;
+
+	spin_lock(&rtc_lock); 	//interrupts are already off
+	//dont care about the contents
+	outb(RTC_REG_C, RTC_CMD);
+	inb(RTC_MEM);
+	rtc_ticks++;
+	for(i = 0; i < RTC_VDEVS; i++){
+		v = &vdevs[i];
+		if(v->flags == RTC_FREE || --v->count != 0)
+			continue;
+		v->count = v->divider;
+		v->ticks++;
+		v->fired_at = rtc_ticks;
+		wake_up(&v->wait);
+	}
+	spin_unlock(&rtc_lock);
+}
+
+/*
+* rtc_vdev_t* rtc_vdev(int32_t fd)
+*   Inputs: fd = rtc file descriptor of the running process
+*   Return Value: its virtual rtc
+*	Function: looks up the virtual rtc rtc_open gave the descriptor
+*/
+static rtc_vdev_t* rtc_vdev(int32_t fd){
+	return &vdevs[curr_task[running_slot]->file_array[fd].device];
+}
+
+/*
+* int32_t rtc_read(int32_t fd, uint8_t* buf, int32_t length)
+*   Inputs: fd = rtc file descriptor
+*		buf = gets the ticks since the last read if length is at least 4, or a
+*			whole rtc_info_t if it fits
+*		length = size of buf
+*   Return Value: 0 after the next tick, -1 if buf is bad
+*	Function: sleeps until the descriptor's virtual rtc ticks again
+*/
 int32_t rtc_read(int32_t fd, uint8_t* buf, int32_t length){
-	interrupt_flag = 1;
-  	sti();
-	while(interrupt_flag); //wait for interrupt to occur and then return 0
+	rtc_vdev_t* v = rtc_vdev(fd);
+	rtc_info_t info;
+	uint32_t start, latency, flags;
+
+	spin_lock_irqsave(&rtc_lock, flags);
+	start = v->ticks;
+	while(v->ticks == start){ //sleep until the next tick and then return 0
+		if(signal_pending(curr_task[running_slot])){
+			spin_unlock_irqrestore(&rtc_lock, flags);
+			return ERESTART;
+		}
+		//the lock is let go once on the wait queue, so the tick can't be missed
+		sleep_on(&v->wait, &rtc_lock);
+	}
+	//ticks the reader slept through are counted from the oldest unread one
+	latency = rtc_ticks - v->fired_at;
+	info.elapsed = v->ticks - v->read_ticks;
+	if(v->reads > 0)
+		v->missed += info.elapsed - 1;
+	v->read_ticks = v->ticks;
+	v->reads++;
+	v->jitter_sum += latency;
+	if(latency > v->jitter_max)
+		v->jitter_max = latency;
+	info.frequency = v->freq;
+	info.ticks = v->ticks;
+	info.missed = v->missed;
+	info.jitter_max = v->jitter_max;
+	info.jitter_avg = v->jitter_sum / v->reads;
+	spin_unlock_irqrestore(&rtc_lock, flags);
 
+	if(length >= (int32_t)sizeof(info)){
+		if(copy_to_user(buf, &info, sizeof(info)) != 0)
+			return -1;
+	}
+	else if(length >= (int32_t)sizeof(info.elapsed)){
+		if(copy_to_user(buf, &info.elapsed, sizeof(info.elapsed)) != 0)
+			return -1;
+	}
 	return 0;
 }
 
+/*
+* int32_t rtc_write(int32_t fd, uint8_t* buf, int32_t length)
+*   Inputs: fd = rtc file descriptor
+*		buf = 4 byte frequency, a power of 2 from MIN_FREQ to MAX_FREQ
+*		length = size of buf
+*   Return Value: 4 on success, -1 on a bad frequency
+*	Function: sets the rate of the descriptor's virtual rtc, the hardware and
+*		every other descriptor keep theirs
+*/
 int32_t rtc_write(int32_t fd, uint8_t* buf, int32_t length){
-	uint32_t freq = *((uint32_t*) buf);
-	int8_t rate;
-	char prev;
+	rtc_vdev_t* v = rtc_vdev(fd);
+	uint32_t freq, flags;
 
+	if(length < sizeof(freq) || copy_from_user(&freq, buf, sizeof(freq)) != 0)
+		return -1;
 	if(freq > MAX_FREQ || freq < MIN_FREQ)
 		return -1;
+	if((freq & (freq - 1)) != 0)
+		return -1; //frequency is not a power of 2 so fails
 
-	switch(freq){
-		case 1024:
-			rate = 6;
-			break;
-		case 512:
-			rate = 7;
-			break;
-		case 256:
-			rate = 8;
-			break;
-		case 128:
-			rate = 9;
-			break;
-		case 64:
-			rate = 10;
-			break;
-		case 32:
-			rate = 11;
-			break;
-		case 16:
-			rate = 12;
-			break;
-		case 8:
-			rate = 13;
-			break;
-		case 4:
-			rate = 14;
-			break;
-		case 2:
-			rate = 15;
-		case 0:
-			rate = 0;
-		default:
-			return -1; //frequency is not a power of 2 so fails
-	}
-	rate &= RTC_MASK1;
-	cli();
-	outb(RTC_REG_A, RTC_CMD);
-	prev = inb(RTC_MEM);
-	outb(RTC_REG_A, RTC_CMD);
-	outb((prev & RTC_MASK2) | rate, RTC_MEM);
-	sti();
+	spin_lock_irqsave(&rtc_lock, flags);
+	v->freq = freq;
+	v->divider = MAX_FREQ / freq;
+	v->count = v->divider; 	//the new rate starts from now
+	spin_unlock_irqrestore(&rtc_lock, flags);
 	return 4;
 }
 
@@ -111,12 +267,47 @@ entry corresponding to thenamed file, allocate an unused file descriptor, and se
 necessary to handle the given type of file (directory,RTC device, or regular file). If the
 named file does not exist or no descriptors are free, the call returns -1.
 */
-//init rtc to 2hz and return 0
+//give the descriptor a virtual rtc at 2hz, return 0 or -1 if none are left
 int32_t rtc_open(int32_t fd, uint8_t* buf, int32_t length){
-	rtc_init();
+	uint32_t i, flags;
+	rtc_vdev_t* v;
+
+	spin_lock_irqsave(&rtc_lock, flags);
+	for(i = 0; i < RTC_VDEVS; i++){
+		if(vdevs[i].flags == RTC_FREE)
+			break;
+	}
+	if(i == RTC_VDEVS){
+		spin_unlock_irqrestore(&rtc_lock, flags);
+		return -1;
+	}
+	v = &vdevs[i];
+	memset(v, 0, sizeof(*v));
+	v->flags = RTC_USED;
+	v->freq = MIN_FREQ;
+	v->divider = MAX_FREQ / MIN_FREQ;
+	v->count = v->divider;
+	curr_task[running_slot]->file_array[fd].device = i;
+
+	if(vdevs_open++ == 0){
+		//a stale interrupt left in register C would keep the irq line high
+		outb(RTC_REG_C, RTC_CMD);
+		inb(RTC_MEM);
+		enable_irq(RTC_IRQ);
+	}
+	spin_unlock_irqrestore(&rtc_lock, flags);
 	return 0;
 }
 
+//give the virtual rtc back, the irq is masked again once none are open
 int32_t rtc_close(int32_t fd, uint8_t* buf, int32_t length){
+	rtc_vdev_t* v = rtc_vdev(fd);
+	uint32_t flags;
+
+	spin_lock_irqsave(&rtc_lock, flags);
+	v->flags = RTC_FREE;
+	if(--vdevs_open == 0)
+		disable_irq(RTC_IRQ);
+	spin_unlock_irqrestore(&rtc_lock, flags);
 	return 0;
 }
@@ -1,6 +1,7 @@
 #ifndef RTC_H
 #define RTC_H
 #include "types.h"
+#include "sched.h"
 
 
 //ports used
@@ -13,11 +14,40 @@
 #define MAX_FREQ 1024
 #define MIN_FREQ 2
 
-volatile int interrupt_flag; //used to tell when interrupts occur
+//cmos clock registers, with the nmi disable bit like the ones above
+#define CMOS_SECONDS 0x80
+#define CMOS_MINUTES 0x82
+#define CMOS_HOURS 0x84
+#define CMOS_DAY 0x87
+#define CMOS_MONTH 0x88
+#define CMOS_YEAR 0x89
+#define CMOS_UPDATING 0x80 			//register A, clock is being updated
+#define CMOS_BINARY 0x04 			//register B, values aren't bcd
+#define CMOS_24HOUR 0x02 			//register B, hours aren't am/pm
+#define CMOS_PM 0x80
+#define EPOCH_YEAR 1970
+#define CMOS_CENTURY 2000 			//the year register only has two digits
+
+//every open rtc gets a virtual device ticking at its own rate, all of them
+//driven off the hardware running at MAX_FREQ
+#define RTC_VDEVS 32
+
+//filled in by rtc_read when the buffer is big enough, latencies are in
+//1/MAX_FREQ second hardware ticks
+typedef struct rtc_info_t {
+	uint32_t elapsed; 					//virtual ticks since the last read returned
+	uint32_t frequency; 				//rate set by rtc_write
+	uint32_t ticks; 					//virtual ticks since open
+	uint32_t missed; 					//ticks that passed while the reader was busy
+	uint32_t jitter_max; 				//worst tick to wakeup latency
+	uint32_t jitter_avg; 				//average tick to wakeup latency
+} rtc_info_t;
 
 
 //rtc initialization function
 void rtc_init(void);
+void rtc_tick(void);
+uint32_t rtc_read_time(void);
 int32_t rtc_read(int32_t fd, uint8_t* buf, int32_t length);
 int32_t rtc_write(int32_t fd, uint8_t* buf, int32_t length);
 int32_t rtc_close(int32_t fd, uint8_t* buf, int32_t length);
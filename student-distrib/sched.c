@@ -0,0 +1,884 @@
+#include "sched.h"
+#include "exceptions.h"
+#include "i8259.h"
+#include "kdata.h"
+#include "keyboard.h"
+#include "lib.h"
+#include "paging.h"
+#include "signal.h"
+#include "smp.h"
+#include "x86_desc.h"
+#include "workqueue.h"
+
+//PIT driven round robin scheduler over the slots of curr_task. every slot
+//runs at most one process, the newest one started in it, its parents wait
+//inside execute. the first MAX_TERMINALS slots belong to the terminals, the
+//others run pipeline stages started by spawn in the background of a terminal.
+//each slot is queued on one cpu, its home, which runs it round robin with
+//its other slots. a cpu with nothing of its own to run takes a runnable slot
+//from the busiest other cpu. terminal t starts out on cpu t % num_cpus, so
+//the terminals run in parallel. all of this is under sched_lock, which a
+//switch hands on to the process switched to, that one lets go of it
+
+volatile uint32_t pit_ticks;
+//curr_task, the slot and cpu tables below, task states, wait queues, pending
+//signals and the stats
+spinlock_t sched_lock = SPIN_LOCK_INIT("sched");
+
+static uint32_t timeslice = SCHED_DEFAULT_SLICE;
+static sched_stats_t stats;
+static uint64_t idle_ns;
+static int32_t slot_home[MAX_SLOTS]; 	//cpu whose run queue the slot is on
+static int32_t slot_cpu[MAX_SLOTS]; 	//cpu running the slot's process, -1 if none
+static uint8_t slot_claimed[MAX_SLOTS]; //execute is filling the empty slot
+static uint8_t idle_stack[MAX_CPUS][IDLE_STACK_SIZE] __attribute__((aligned(4)));
+
+static void cpu_idle();
+
+/*
+* void acct_charge(pcb_t* task, uint64_t* counter)
+*   Inputs: task = process, counter = its utime or stime
+*   Return Value: none
+*	Function: adds the time since the process was last charged to the counter.
+*		a syscall entry may be preempted, so the update is done with
+*		interrupts off
+*/
+static void acct_charge(pcb_t* task, uint64_t* counter){
+	uint64_t now;
+	uint32_t flags;
+
+	cli_and_save(flags);
+	now = clock_ns();
+	*counter += now - task->acct_stamp;
+	task->acct_stamp = now;
+	restore_flags(flags);
+}
+
+/*
+* uint32_t idle_stack_top(uint32_t cpu)
+*   Inputs: cpu = index in cpus
+*   Return Value: top of the stack its idle loop runs on
+*/
+uint32_t idle_stack_top(uint32_t cpu){
+	return (uint32_t)(idle_stack[cpu] + IDLE_STACK_SIZE);
+}
+
+/*
+* void sched_init()
+*   Inputs: none
+*   Return Value: none
+*	Function: starts the timer so the PIT ticks PIT_HZ times a second and
+*		enables IRQ0. every cpu starts out in its idle loop, which starts the
+*		shells of the terminals
+*/
+void sched_init(){
+	uint32_t cpu;
+	int32_t s;
+
+	for(cpu = 0; cpu < MAX_CPUS; cpu++){
+		cpus[cpu].slot = SLOT_IDLE;
+		cpus[cpu].terminal = 0;
+		cpus[cpu].shown_terminal = 0;
+		cpus[cpu].slice_left = timeslice;
+		cpus[cpu].dead_pid = -1;
+	}
+	for(s = 0; s < MAX_SLOTS; s++){
+		slot_home[s] = 0;
+		slot_cpu[s] = -1;
+		slot_claimed[s] = 0;
+	}
+	pit_ticks = 0;
+	timer_init();
+	enable_irq(PIT_IRQ);
+}
+
+/*
+* void sched_tick(uint32_t ticks)
+*   Inputs: ticks = scheduler ticks that passed, more than one after idle
+*   Return Value: none
+*	Function: charges the ticks to every process as running or blocked and
+*		counts down the time slices of all cpus, the PIT only interrupts cpu
+*		0. the switch itself happens in schedule once ex_32 is back on the
+*		process stack, the other cpus get an interrupt to do it. sched_lock
+*		is held
+*/
+static void sched_tick(uint32_t ticks){
+	int32_t s;
+	uint32_t c;
+	pcb_t* task;
+	cpu_t* cpu;
+
+	pit_ticks += ticks;
+	for(s = 0; s < MAX_SLOTS; s++){
+		task = curr_task[s];
+		if(task == NULL)
+			continue;
+		if(task->state == TASK_BLOCKED)
+			task->ticks_blocked += ticks;
+		else if(slot_cpu[s] != -1)
+			task->ticks_running += ticks;
+	}
+
+	for(c = 0; c < num_cpus; c++){
+		cpu = &cpus[c];
+		task = curr_task[cpu->slot];
+		if(task == NULL || task->state == TASK_BLOCKED)
+			stats.idle_ticks += ticks; 	//only a blocked process or the idle loop halts a cpu
+		cpu->slice_left = (cpu->slice_left > ticks) ? cpu->slice_left - ticks : 0;
+		if(cpu->slice_left == 0){
+			cpu->need_resched = 1;
+			if(!cpu->idle)
+				smp_kick(c);
+		}
+	}
+}
+
+/*
+* void pit_handler()
+*   Inputs: none
+*   Return Value: none
+*	Function: runs on the interrupt stack. runs the expired kernel timers, then
+*		accounts for every scheduler tick that is due. the PIT, or cpu 0's
+*		APIC timer, also interrupts between ticks for timers, those don't
+*		count as ticks. interrupts are off, the plain lock is enough
+*/
+void pit_handler(){
+	uint32_t ticks = timer_interrupt();
+
+	spin_lock(&sched_lock);
+	stats.timer_irqs++;
+	if(ticks > 1)
+		stats.ticks_skipped += ticks - 1;
+	if(ticks > 0)
+		sched_tick(ticks);
+	spin_unlock(&sched_lock);
+	send_eoi(PIT_IRQ);
+}
+
+/*
+* int32_t slot_ready(int32_t s, uint32_t cpu)
+*   Inputs: s = slot, cpu = index of the cpu looking for work
+*   Return Value: 1 if the cpu can run the slot from its own run queue
+*	Function: an empty slot is skipped, the idle loops start the shells of
+*		empty terminals. so is one running on another cpu
+*/
+static int32_t slot_ready(int32_t s, uint32_t cpu){
+	pcb_t* task = curr_task[s];
+
+	if(task == NULL || (slot_cpu[s] != -1 && slot_cpu[s] != (int32_t)cpu))
+		return 0;
+	return slot_home[s] == (int32_t)cpu && task->state == TASK_RUNNABLE;
+}
+
+/*
+* int32_t slot_stealable(int32_t s)
+*   Inputs: s = slot
+*   Return Value: 1 if it is runnable and waits on some cpu's run queue
+*/
+static int32_t slot_stealable(int32_t s){
+	return curr_task[s] != NULL && curr_task[s]->state == TASK_RUNNABLE && slot_cpu[s] == -1;
+}
+
+/*
+* int32_t steal_slot(uint32_t cpu)
+*   Inputs: cpu = index of the cpu with nothing to run
+*   Return Value: slot moved to its run queue, -1 if there is none
+*	Function: takes a waiting slot from the cpu with the most of them
+*/
+static int32_t steal_slot(uint32_t cpu){
+	uint32_t queued[MAX_CPUS];
+	int32_t s, victim = -1;
+	uint32_t c;
+
+	memset(queued, 0, sizeof(queued));
+	for(s = 0; s < MAX_SLOTS; s++){
+		if(slot_stealable(s))
+			queued[slot_home[s]]++;
+	}
+	for(c = 0; c < num_cpus; c++){
+		if(c != cpu && queued[c] > 0 && (victim == -1 || queued[c] > queued[victim]))
+			victim = c;
+	}
+	if(victim == -1)
+		return -1;
+	for(s = 0; s < MAX_SLOTS; s++){
+		if(slot_stealable(s) && slot_home[s] == victim){
+			slot_home[s] = cpu;
+			stats.migrations++;
+			return s;
+		}
+	}
+	return -1;
+}
+
+/*
+* int32_t pick_next()
+*   Inputs: none
+*   Return Value: slot to run next, -1 if nothing can run
+*	Function: round robin over this cpu's slots after the running one, ending
+*		with the running one itself, else steals one
+*/
+static int32_t pick_next(){
+	cpu_t* cpu = this_cpu();
+	int32_t i, s;
+	for(i = 1; i <= MAX_SLOTS; i++){
+		s = (cpu->slot + i) % MAX_SLOTS;
+		if(slot_ready(s, cpu->id))
+			return s;
+	}
+	return steal_slot(cpu->id);
+}
+
+/*
+* int32_t work_waiting(uint32_t cpu)
+*   Inputs: cpu = index of the cpu about to halt
+*   Return Value: 1 if pick_next would find something for it
+*/
+static int32_t work_waiting(uint32_t cpu){
+	int32_t s;
+	for(s = 0; s < MAX_SLOTS; s++){
+		if(slot_ready(s, cpu) || slot_stealable(s))
+			return 1;
+	}
+	return 0;
+}
+
+/*
+* int32_t fill_terminals()
+*   Inputs: none
+*   Return Value: number of shells started
+*	Function: starts a shell on every terminal without a process, at boot
+*		and after the shell of a terminal halted. called without sched_lock,
+*		execute takes the locks of the file system and the frame pool
+*/
+static int32_t fill_terminals(){
+	int32_t t, started = 0;
+	for(t = 0; t < MAX_TERMINALS; t++){
+		if(curr_task[t] == NULL && !slot_claimed[t] && start_shell(t) != -1)
+			started++;
+	}
+	return started;
+}
+
+/*
+* void map_running_video()
+*   Inputs: none
+*   Return Value: none
+*	Function: points this cpu's vidmap page at the screen or the backing
+*		page of the terminal it runs, whichever is right for the terminal on
+*		screen now. the caller flushes the TLB
+*/
+void map_running_video(){
+	cpu_t* cpu = this_cpu();
+	cpu->shown_terminal = current_terminal;
+	map_terminal_video(cpu->terminal, cpu->terminal == current_terminal);
+}
+
+/*
+* void switch_slot(int32_t slot, uint32_t* prev_esp)
+*   Inputs: slot = slot whose process gets the cpu, SLOT_IDLE for the idle loop
+*		prev_esp = where the running process parks its stack
+*   Return Value: none
+*	Function: parks the running process and switches to the process of the
+*		given slot. returns when the parked process is switched back to, maybe
+*		on another cpu. called with interrupts off and sched_lock held, the
+*		switch hands the lock on and it is held again on return
+*/
+static void switch_slot(int32_t slot, uint32_t* prev_esp){
+	cpu_t* cpu = this_cpu();
+	pcb_t* prev = curr_task[cpu->slot];
+	pcb_t* next = curr_task[slot];
+
+	if(prev != NULL)
+		acct_charge(prev, &prev->stime);
+	if(cpu->slot != SLOT_IDLE)
+		slot_cpu[cpu->slot] = -1;
+	cpu->slot = slot;
+	stats.switches++;
+	if(slot == SLOT_IDLE){
+		fpu_switch(NULL);
+		switch_to(prev_esp, cpu->idle_esp);
+		sched_reap();
+		return;
+	}
+
+	slot_cpu[slot] = cpu->id;
+	slot_home[slot] = cpu->id;
+	cpu->terminal = next->terminal;
+	map_running_video();
+	restore_task_paging(next);
+	set_kernel_stack(KERNEL_STACK_TOP(next->process_id));
+	fpu_switch(next);
+	kdata_task(next->process_id, next->terminal);
+	next->acct_stamp = clock_ns();
+	switch_to(prev_esp, next->registers.esp);
+	sched_reap(); 	//the process switched away from may have exited
+}
+
+/*
+* void schedule()
+*   Inputs: none
+*   Return Value: none
+*	Function: called by ex_32 with interrupts off. when the time slice is used
+*		up, moves on to the next slot with something to run. nothing
+*		happens on cpu 0 while another irq is on the interrupt stack or while
+*		the worker thread runs, nor while the cpu is between processes (a
+*		halting process leaving its stack). a sleeper halted in cpu_idle isn't
+*		switched away from either, its tick may be stopped and the halt isn't
+*		its time
+*/
+void schedule(){
+	cpu_t* cpu = this_cpu();
+	pcb_t* task;
+	int32_t next;
+
+	if(!cpu->need_resched || cpu->in_idle || (cpu->id == 0 && (irq_depth != 0 || worker_active())))
+		return;
+	spin_lock(&sched_lock);
+	task = curr_task[cpu->slot];
+	if(task == NULL){
+		spin_unlock(&sched_lock);
+		return;
+	}
+	cpu->need_resched = 0;
+	cpu->slice_left = timeslice;
+
+	next = pick_next();
+	if(next != -1 && next != cpu->slot){
+		task->nivcsw++;
+		switch_slot(next, &task->registers.esp);
+	}
+	spin_unlock(&sched_lock);
+}
+
+/*
+* void sched_exit(int32_t pid)
+*   Inputs: pid = process that halted without a parent
+*   Return Value: none, never returns
+*	Function: empties its slot and leaves its stack, an empty terminal gets a
+*		new shell. goes to the next runnable slot, else to the cpu's idle
+*		loop. the pid is freed by whatever runs next, until then its stack
+*		can't be reused
+*/
+void sched_exit(int32_t pid){
+	cpu_t* cpu;
+	int32_t next;
+
+	cli();
+	spin_lock(&sched_lock);
+	cpu = this_cpu();
+	curr_task[cpu->slot] = NULL;
+	slot_cpu[cpu->slot] = -1;
+	cpu->slot = SLOT_IDLE;
+	cpu->dead_pid = pid;
+	spin_unlock(&sched_lock);
+	fill_terminals();
+
+	spin_lock(&sched_lock);
+	next = pick_next();
+	if(next == -1)
+		next = SLOT_IDLE;
+	cpu->slice_left = timeslice;
+	switch_slot(next, &cpu->dead_esp); 	//the exited stack is never switched back to
+}
+
+/*
+* void sched_idle()
+*   Inputs: none
+*   Return Value: none, never returns
+*	Function: the idle loop of a cpu, where it waits while none of the slots
+*		it may run can run. starts shells on empty terminals, zeroes frames
+*		for the zero pool or halts until an interrupt. every cpu starts here
+*		on its idle stack
+*/
+void sched_idle(){
+	int32_t next, refilled;
+
+	cli();
+	while(1){
+		spin_lock(&sched_lock);
+		next = pick_next();
+		if(next != -1){
+			this_cpu()->slice_left = timeslice;
+			switch_slot(next, &this_cpu()->idle_esp);
+			spin_unlock(&sched_lock);
+			continue;
+		}
+		spin_unlock(&sched_lock);
+		sti();
+		refilled = fill_terminals() || zero_pool_refill();
+		cli();
+		if(!refilled)
+			cpu_idle();
+	}
+}
+
+/*
+* void sched_resume()
+*   Inputs: none
+*   Return Value: none
+*	Function: called by the reschedule interrupt. another cpu may have
+*		switched the terminal on screen, whose vidmap page this cpu still
+*		maps the old way
+*/
+void sched_resume(){
+	cpu_t* cpu = this_cpu();
+
+	if(cpu->shown_terminal != current_terminal){
+		map_running_video();
+		reset_cr3();
+	}
+}
+
+/*
+* int32_t sched_claim_slot(int32_t first, int32_t end)
+*   Inputs: first = first slot to look at, end = one past the last
+*   Return Value: empty slot now reserved for the caller, -1 if all are busy
+*	Function: execute fills the slot without sched_lock, the claim keeps
+*		another cpu from filling it too
+*/
+int32_t sched_claim_slot(int32_t first, int32_t end){
+	int32_t s, slot = -1;
+	uint32_t flags;
+
+	spin_lock_irqsave(&sched_lock, flags);
+	for(s = first; s < end; s++){
+		if(curr_task[s] == NULL && !slot_claimed[s]){
+			slot_claimed[s] = 1;
+			slot = s;
+			break;
+		}
+	}
+	spin_unlock_irqrestore(&sched_lock, flags);
+	return slot;
+}
+
+/*
+* void sched_unclaim(int32_t slot)
+*   Inputs: slot = slot from sched_claim_slot
+*   Return Value: none
+*	Function: gives it back when the program couldn't be started
+*/
+void sched_unclaim(int32_t slot){
+	uint32_t flags;
+
+	spin_lock_irqsave(&sched_lock, flags);
+	slot_claimed[slot] = 0;
+	spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/*
+* void sched_place(int32_t slot, pcb_t* task)
+*   Inputs: slot = slot of curr_task, task = process that runs in it now
+*   Return Value: none
+*	Function: puts the process in the slot. the running slot gets a child or
+*		its parent back. another slot is queued on the cpu it belongs to, a
+*		terminal's by number and a background one on this cpu, an idle cpu
+*		is woken to take it
+*/
+void sched_place(int32_t slot, pcb_t* task){
+	cpu_t* cpu;
+	uint32_t flags;
+
+	spin_lock_irqsave(&sched_lock, flags);
+	cpu = this_cpu();
+	curr_task[slot] = task;
+	slot_claimed[slot] = 0;
+	if(slot != cpu->slot){
+		slot_home[slot] = (slot < MAX_TERMINALS) ? slot % (int32_t)num_cpus : (int32_t)cpu->id;
+		smp_kick_idle();
+	}
+	spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/*
+* void sched_reap()
+*   Inputs: none
+*   Return Value: none
+*	Function: frees the pid of a process that exited on this cpu, now that
+*		nothing runs on its kernel stack anymore. interrupts must be off
+*/
+void sched_reap(){
+	cpu_t* cpu = this_cpu();
+
+	if(cpu->dead_pid != -1){
+		free_pid(cpu->dead_pid);
+		cpu->dead_pid = -1;
+	}
+}
+
+/*
+* void sched_first_run()
+*   Inputs: none
+*   Return Value: none
+*	Function: called by switch_to_new on the way to a new process' first
+*		instruction. lets go of sched_lock for the switch that got here
+*/
+void sched_first_run(){
+	spin_unlock(&sched_lock);
+	sched_reap();
+}
+
+/*
+* int32_t task_on_cpu(pcb_t* task)
+*   Inputs: task = process
+*   Return Value: 1 if some cpu is running it right now
+*	Function: sched_lock must be held
+*/
+int32_t task_on_cpu(pcb_t* task){
+	int32_t s;
+	for(s = 0; s < MAX_SLOTS; s++){
+		if(curr_task[s] == task && slot_cpu[s] != -1)
+			return 1;
+	}
+	return 0;
+}
+
+/*
+* void sched_kick(pcb_t* task)
+*   Inputs: task = process that has something new to handle, e.g. a signal
+*   Return Value: none
+*	Function: interrupts the cpu running it, so it enters the kernel.
+*		sched_lock must be held
+*/
+void sched_kick(pcb_t* task){
+	int32_t s;
+	for(s = 0; s < MAX_SLOTS; s++){
+		if(curr_task[s] == task && slot_cpu[s] != -1)
+			smp_kick(slot_cpu[s]);
+	}
+}
+
+/*
+* void cpu_idle()
+*   Inputs: none
+*   Return Value: none
+*	Function: halts until an interrupt, unless something became runnable since
+*		the caller looked. cpu 0 stops the scheduler tick if the other cpus
+*		are idle too, they need it for their time slices, so only kernel
+*		timers and devices wake it. records how long it was idle and which
+*		irqs woke it. called and returns with interrupts off and without
+*		sched_lock. the interrupt that wakes it doesn't reschedule, the caller
+*		looks for something to run
+*/
+static void cpu_idle(){
+	uint32_t before[NUM_IRQS];
+	uint64_t start;
+	int32_t i, stopped;
+	cpu_t* cpu = this_cpu();
+
+	memcpy(before, irq_count, sizeof(before));
+	start = clock_ns();
+	spin_lock(&sched_lock);
+	if(work_waiting(cpu->id)){
+		spin_unlock(&sched_lock);
+		return;
+	}
+	stopped = (cpu->id == 0 && smp_others_idle());
+	if(!stopped && cpus[0].idle)
+		smp_kick(0); 	//cpu 0 may stop the tick now
+	//a wakeup from now on sees the flag and kicks this cpu
+	cpu->idle = 1;
+	cpu->in_idle = 1;
+	spin_unlock(&sched_lock);
+	if(stopped)
+		timer_stop_tick();
+	//sti only takes effect after hlt so a wakeup can't slip in between
+	asm volatile("sti; hlt; cli");
+	if(stopped)
+		timer_restart_tick();
+
+	spin_lock(&sched_lock);
+	cpu->idle = 0;
+	cpu->in_idle = 0;
+	cpu->need_resched = 0;
+	idle_ns += clock_ns() - start;
+	stats.idle_entries++;
+	for(i = 0; i < NUM_IRQS; i++){
+		if(irq_count[i] != before[i])
+			stats.wakeups[i]++;
+	}
+	spin_unlock(&sched_lock);
+}
+
+/*
+* void sleep_on(wait_queue_t* queue, spinlock_t* lock)
+*   Inputs: queue = wait queue to sleep on
+*		lock = lock of the caller's condition, held, NULL if none
+*   Return Value: none
+*	Function: blocks the running process until wake_up is called on the queue.
+*		the caller's lock is dropped once the process is on the queue, so a
+*		wakeup can't be missed, and taken again before returning. a signal
+*		that came after the caller looked ends the sleep right away. other
+*		slots run in the meantime, when nothing can run the cpu zeroes frames
+*		for the zero pool or halts until the next interrupt. must be called
+*		with interrupts off and returns with them off, callers check their
+*		condition again in a loop
+*/
+void sleep_on(wait_queue_t* queue, spinlock_t* lock){
+	pcb_t* task;
+	int32_t next, refilled;
+
+	spin_lock(&sched_lock);
+	if(lock != NULL)
+		spin_unlock(lock);
+	task = curr_task[running_slot];
+	if(!signal_pending(task)){
+		task->state = TASK_BLOCKED;
+		task->waiting_on = queue;
+		task->wait_next = queue->head;
+		queue->head = task;
+		stats.sleeps++;
+	}
+
+	while(task->state == TASK_BLOCKED){
+		next = pick_next();
+		if(next != -1 && next != running_slot){
+			this_cpu()->slice_left = timeslice;
+			task->nvcsw++;
+			switch_slot(next, &task->registers.esp);
+			continue;
+		}
+		//nothing else to run, use the time to zero frames, else halt. the
+		//wakeup may have come while zeroing
+		spin_unlock(&sched_lock);
+		sti();
+		refilled = zero_pool_refill();
+		cli();
+		if(!refilled && task->state == TASK_BLOCKED){
+			//the halt isn't the sleeper's time
+			acct_charge(task, &task->stime);
+			cpu_idle();
+			task->acct_stamp = clock_ns();
+		}
+		spin_lock(&sched_lock);
+	}
+	spin_unlock(&sched_lock);
+	if(lock != NULL)
+		spin_lock(lock);
+}
+
+/*
+* void wake_up(wait_queue_t* queue)
+*   Inputs: queue = wait queue whose processes can run again
+*   Return Value: none
+*	Function: called from interrupt handlers, makes every sleeper runnable.
+*		they run the next time the scheduler reaches them, idle cpus are
+*		woken to look
+*/
+void wake_up(wait_queue_t* queue){
+	pcb_t* task;
+	uint32_t flags;
+
+	spin_lock_irqsave(&sched_lock, flags);
+	task = queue->head;
+	if(task != NULL){
+		while(task != NULL){
+			task->state = TASK_RUNNABLE;
+			task->waiting_on = NULL;
+			task = task->wait_next;
+		}
+		queue->head = NULL;
+		smp_kick_idle();
+	}
+	spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/*
+* void sched_wake_task(pcb_t* task)
+*   Inputs: task = process that has to stop sleeping
+*   Return Value: none
+*	Function: takes it off the wait queue it sleeps on and makes it
+*		runnable. sched_lock must be held
+*/
+void sched_wake_task(pcb_t* task){
+	pcb_t** link;
+
+	if(task->waiting_on != NULL){
+		for(link = &task->waiting_on->head; *link != NULL; link = &(*link)->wait_next){
+			if(*link == task){
+				*link = task->wait_next;
+				break;
+			}
+		}
+		task->waiting_on = NULL;
+	}
+	task->state = TASK_RUNNABLE;
+	smp_kick_idle();
+}
+
+/*
+* void wait_cancel(pcb_t* task)
+*   Inputs: task = process that is going away
+*   Return Value: none
+*	Function: takes a halting process off the wait queue it sleeps on, e.g. a
+*		shell killed by ctrl+C while it waits for a line
+*/
+void wait_cancel(pcb_t* task){
+	uint32_t flags;
+
+	spin_lock_irqsave(&sched_lock, flags);
+	sched_wake_task(task);
+	spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/*
+* void get_sched_stats(sched_stats_t* out)
+*   Inputs: out = struct to fill in
+*   Return Value: none
+*	Function: copies out the scheduler counters, with the idle time in ms
+*/
+void get_sched_stats(sched_stats_t* out){
+	uint64_t ms;
+	uint32_t flags, cpu;
+
+	if(out == NULL)
+		return;
+	spin_lock_irqsave(&sched_lock, flags);
+	stats.ticks = pit_ticks;
+	ms = clock_ns();
+	div64(&ms, NSEC_PER_MSEC);
+	stats.uptime_ms = (uint32_t)ms;
+	ms = idle_ns;
+	div64(&ms, NSEC_PER_MSEC);
+	stats.idle_ms = (uint32_t)ms;
+	stats.cpus = num_cpus;
+	stats.ipis = 0;
+	for(cpu = 0; cpu < num_cpus; cpu++)
+		stats.ipis += cpus[cpu].ipis;
+	*out = stats;
+	spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/*
+* int32_t sched_set_timeslice(uint32_t ticks)
+*   Inputs: ticks = PIT ticks each terminal runs before the next one gets the cpu
+*   Return Value: 0 on success, -1 if out of range
+*	Function: changes the time slice, takes effect at the next switch
+*/
+int32_t sched_set_timeslice(uint32_t ticks){
+	if(ticks == 0 || ticks > SCHED_MAX_SLICE)
+		return -1;
+	timeslice = ticks;
+	return 0;
+}
+
+/*
+* void acct_init(pcb_t* task)
+*   Inputs: task = new process
+*   Return Value: none
+*	Function: starts its cpu time at zero
+*/
+void acct_init(pcb_t* task){
+	task->utime = 0;
+	task->stime = 0;
+	task->child_utime = 0;
+	task->child_stime = 0;
+	task->nvcsw = 0;
+	task->nivcsw = 0;
+	task->start_ns = clock_ns();
+	task->acct_stamp = task->start_ns;
+}
+
+/*
+* void acct_enter(regs_t* regs)
+*   Inputs: regs = registers saved by the entry stub
+*   Return Value: none
+*	Function: called first thing by every stub. coming from user mode, the
+*		time since the process last entered user mode was user time
+*/
+void acct_enter(regs_t* regs){
+	pcb_t* task = curr_task[running_slot];
+	if((regs->cs & 0x3) == 0x3 && task != NULL)
+		acct_charge(task, &task->utime);
+}
+
+/*
+* void acct_exit(regs_t* regs)
+*   Inputs: regs = registers the stub is about to return with
+*   Return Value: none
+*	Function: called last thing by every stub. going back to user mode, the
+*		time in the kernel was system time
+*/
+void acct_exit(regs_t* regs){
+	pcb_t* task = curr_task[running_slot];
+	if((regs->cs & 0x3) == 0x3 && task != NULL)
+		acct_charge(task, &task->stime);
+}
+
+/*
+* void acct_halt(pcb_t* task)
+*   Inputs: task = halting process
+*   Return Value: none
+*	Function: adds its times and its children's to the parent, what
+*		getrusage reports for RUSAGE_CHILDREN
+*/
+void acct_halt(pcb_t* task){
+	acct_charge(task, &task->stime);
+	if(task->parent_task == NULL)
+		return;
+	task->parent_task->child_utime += task->utime + task->child_utime;
+	task->parent_task->child_stime += task->stime + task->child_stime;
+}
+
+/*
+* uint32_t ns_to_us(uint64_t ns)
+*   Inputs: ns = time in ns
+*   Return Value: the time in us, wraps after about 71 minutes
+*/
+static uint32_t ns_to_us(uint64_t ns){
+	div64(&ns, NSEC_PER_USEC);
+	return (uint32_t)ns;
+}
+
+/*
+* int32_t get_rusage(int32_t who, rusage_t* out)
+*   Inputs: who = pid, RUSAGE_SELF or RUSAGE_CHILDREN
+*		out = struct to fill in
+*   Return Value: 0 on success, -1 if there is no such process
+*	Function: reports the cpu time and context switches of a process. the
+*		running process is charged up to now first
+*/
+int32_t get_rusage(int32_t who, rusage_t* out){
+	pcb_t* self = curr_task[running_slot];
+	pcb_t* task;
+	uint64_t start;
+	uint32_t flags;
+
+	if(who == RUSAGE_SELF || who == RUSAGE_CHILDREN)
+		task = self;
+	else if(who >= 0 && who < MAX_PROCESSES)
+		task = process_table[who];
+	else
+		return -1;
+	if(task == NULL)
+		return -1;
+
+	spin_lock_irqsave(&sched_lock, flags);
+	acct_charge(self, &self->stime);
+	out->pid = task->process_id;
+	out->ppid = (task->parent_task != NULL) ? (int32_t)task->parent_task->process_id : -1;
+	out->terminal = task->terminal;
+	if(task == self || task_on_cpu(task))
+		out->state = PROC_RUNNING;
+	else if(task->child_task != NULL)
+		out->state = PROC_WAITING;
+	else
+		out->state = (task->state == TASK_BLOCKED) ? PROC_BLOCKED : PROC_RUNNABLE;
+	if(who == RUSAGE_CHILDREN){
+		out->utime_us = ns_to_us(task->child_utime);
+		out->stime_us = ns_to_us(task->child_stime);
+	}
+	else{
+		out->utime_us = ns_to_us(task->utime);
+		out->stime_us = ns_to_us(task->stime);
+	}
+	out->nvcsw = task->nvcsw;
+	out->nivcsw = task->nivcsw;
+	start = task->start_ns;
+	div64(&start, NSEC_PER_MSEC);
+	out->start_ms = (uint32_t)start;
+	memcpy(out->name, task->name, PROC_NAME_LEN);
+	spin_unlock_irqrestore(&sched_lock, flags);
+	return 0;
+}
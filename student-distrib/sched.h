@@ -0,0 +1,103 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include "types.h"
+#include "timer.h"
+#include "i8259.h"
+#include "smp.h"
+#include "spinlock.h"
+
+//round robin over the terminals, each runs for a time slice of PIT ticks.
+//every cpu has its own run queue, the slots whose home it is
+#define SCHED_DEFAULT_SLICE 3 			//30ms
+#define SCHED_MAX_SLICE PIT_HZ 			//a second
+
+//process states, only runnable processes are picked by the scheduler
+#define TASK_RUNNABLE 0
+#define TASK_BLOCKED 1
+
+//processes sleeping until an interrupt handler wakes them, linked through the pcb
+typedef struct wait_queue_t {
+	struct pcb_t* head;
+} wait_queue_t;
+
+typedef struct sched_stats_t {
+	uint32_t ticks; 					//PIT ticks since boot
+	uint32_t idle_ticks; 				//ticks the cpus spent halted with nothing runnable, summed
+	uint32_t switches; 					//context switches
+	uint32_t sleeps; 					//times a process blocked on a wait queue
+	uint32_t uptime_ms;
+	uint32_t idle_ms; 					//time the cpus spent halted, summed
+	uint32_t idle_entries; 				//times the cpu halted, each ends with a wakeup
+	uint32_t timer_irqs; 				//PIT interrupts, ticks and kernel timers
+	uint32_t ticks_skipped; 			//ticks that passed without an interrupt while idle
+	uint32_t wakeups[NUM_IRQS]; 		//irqs that ended an idle halt, by line
+	uint32_t cpus; 						//cpus running the scheduler
+	uint32_t migrations; 				//slots an idle cpu took from another's run queue
+	uint32_t ipis; 						//reschedule interrupts between cpus
+} sched_stats_t;
+
+//per process cpu time, returned by getrusage. who is a pid or one of these
+#define RUSAGE_SELF -1
+#define RUSAGE_CHILDREN -2 				//halted children of the caller, summed
+#define PROC_RUNNING 0 					//on the cpu
+#define PROC_RUNNABLE 1
+#define PROC_BLOCKED 2
+#define PROC_WAITING 3 					//in execute until its child halts
+#define PROC_NAME_LEN 32
+
+typedef struct rusage_t {
+	uint32_t pid;
+	int32_t ppid; 						//-1 without a parent
+	uint32_t terminal;
+	uint32_t state; 					//PROC_*
+	uint32_t utime_us; 					//time in user mode
+	uint32_t stime_us; 					//time in the kernel on its behalf, irqs included
+	uint32_t nvcsw; 					//switches away because it blocked
+	uint32_t nivcsw; 					//switches away at the end of its time slice
+	uint32_t start_ms; 					//when it started, since boot
+	uint8_t name[PROC_NAME_LEN];
+} rusage_t;
+
+#define running_slot (this_cpu()->slot) 			//slot of curr_task whose process has this cpu
+#define running_terminal (this_cpu()->terminal) 	//terminal that process runs on
+extern volatile uint32_t pit_ticks; 	//ticks since boot
+extern uint32_t irq_depth; 				//irqs running on the interrupt stack, see isr_wrapper.S
+extern spinlock_t sched_lock;
+
+struct pcb_t;
+struct regs_t;
+
+void sched_init();
+void pit_handler();
+void schedule();
+int32_t sched_set_timeslice(uint32_t ticks);
+void sleep_on(wait_queue_t* queue, spinlock_t* lock);
+void wake_up(wait_queue_t* queue);
+void wait_cancel(struct pcb_t* task);
+void sched_wake_task(struct pcb_t* task);
+void sched_exit(int32_t pid);
+void sched_idle();
+void sched_resume();
+int32_t sched_claim_slot(int32_t first, int32_t end);
+void sched_unclaim(int32_t slot);
+void sched_place(int32_t slot, struct pcb_t* task);
+void sched_reap();
+void sched_first_run();
+void map_running_video();
+void sched_kick(struct pcb_t* task);
+int32_t task_on_cpu(struct pcb_t* task);
+uint32_t idle_stack_top(uint32_t cpu);
+void get_sched_stats(sched_stats_t* out);
+void acct_init(struct pcb_t* task);
+void acct_enter(struct regs_t* regs);
+void acct_exit(struct regs_t* regs);
+void acct_halt(struct pcb_t* task);
+int32_t get_rusage(int32_t who, rusage_t* out);
+
+//context switch primitives, switch.S
+void switch_to(uint32_t* prev_esp, uint32_t next_esp);
+void switch_to_new();
+void ex_32();
+
+#endif /* SCHED_H */
@@ -0,0 +1,252 @@
+#include "shm.h"
+#include "paging.h"
+#include "lib.h"
+#include "spinlock.h"
+
+#define SHM_FREE 0
+#define SHM_USED 1
+
+static shm_segment_t segments[MAX_SHM_SEGMENTS];
+static spinlock_t shm_lock = SPIN_LOCK_INIT("shm"); 	//the segments and their refcounts
+
+static void shm_unmap(uint32_t* table, int32_t* slots, int32_t slot);
+
+/*
+* void shm_destroy(shm_segment_t* seg)
+*   Inputs: seg = segment with no attached processes
+*   Return Value: none
+*	Function: gives the frames of the segment back to the pool and frees the
+*		slot, ids of the old segment stop working
+*/
+static void shm_destroy(shm_segment_t* seg){
+	uint32_t i;
+	for(i = 0; i < seg->num_pages; i++)
+		free_frame(seg->frames[i]);
+	seg->num_pages = 0;
+	seg->gen = (seg->gen + 1) & SHM_GEN_MASK;
+	seg->flags = SHM_FREE;
+}
+
+/*
+* void shm_put(shm_segment_t* seg)
+*   Inputs: seg = segment that lost an attachment or its creator
+*   Return Value: none
+*	Function: the creator holds the segment like an attachment does, it is
+*		destroyed once neither is left
+*/
+static void shm_put(shm_segment_t* seg){
+	if(seg->refcount == 0 && seg->creator == SHM_NONE)
+		shm_destroy(seg);
+}
+
+/*
+* shm_segment_t* shm_lookup(int32_t id)
+*   Inputs: id = segment id from shm_create
+*   Return Value: the segment, NULL if the id is stale or bad
+*/
+static shm_segment_t* shm_lookup(int32_t id){
+	shm_segment_t* seg;
+
+	if(id < 0)
+		return NULL;
+	seg = &segments[id & SHM_INDEX_MASK];
+	if(seg->flags == SHM_FREE || seg->gen != ((uint32_t)id >> SHM_GEN_SHIFT))
+		return NULL;
+	return seg;
+}
+
+/*
+* int32_t shm_create(const uint8_t* name, uint32_t size, int32_t pid)
+*   Inputs: name = null terminated segment name
+*		size = size of the segment in bytes
+*		pid = calling process, keeps a new segment alive until it halts
+*   Return Value: segment id on success, -1 on fail
+*	Function: returns the segment with this name, creating it with zeroed frames if
+*		it doesn't exist yet. An existing segment must be at least size bytes
+*/
+int32_t shm_create(const uint8_t* name, uint32_t size, int32_t pid){
+	uint32_t pages = (size + FRAME_SIZE - 1) / FRAME_SIZE;
+	int32_t i, id, free_id = SHM_NONE;
+	uint32_t j, flags;
+
+	if(name == NULL || name[0] == '\0' || pages == 0 || pages > SHM_MAX_PAGES)
+		return -1;
+
+	spin_lock_irqsave(&shm_lock, flags);
+	for(i = 0; i < MAX_SHM_SEGMENTS; i++){
+		if(segments[i].flags == SHM_FREE){
+			if(free_id == SHM_NONE)
+				free_id = i;
+			continue;
+		}
+		if(strncmp((int8_t*) segments[i].name, (int8_t*) name, SHM_NAME_LEN) == 0){
+			id = (segments[i].num_pages >= pages) ? SHM_ID(i, segments[i].gen) : -1;
+			spin_unlock_irqrestore(&shm_lock, flags);
+			return id;
+		}
+	}
+	if(free_id == SHM_NONE){
+		spin_unlock_irqrestore(&shm_lock, flags);
+		return -1;
+	}
+
+	shm_segment_t* seg = &segments[free_id];
+	for(j = 0; j < pages; j++){
+		seg->frames[j] = alloc_zeroed_frame();
+		if(seg->frames[j] == NO_FRAME){
+			seg->num_pages = j;
+			shm_destroy(seg);
+			spin_unlock_irqrestore(&shm_lock, flags);
+			return -1;
+		}
+	}
+	strncpy((int8_t*) seg->name, (int8_t*) name, SHM_NAME_LEN - 1);
+	seg->name[SHM_NAME_LEN - 1] = '\0';
+	seg->num_pages = pages;
+	seg->refcount = 0;
+	seg->creator = pid;
+	seg->flags = SHM_USED;
+	id = SHM_ID(free_id, seg->gen);
+	spin_unlock_irqrestore(&shm_lock, flags);
+	return id;
+}
+
+/*
+* int32_t shm_attach(uint32_t** table, int32_t* slots, int32_t id)
+*   Inputs: table = pointer to the shared memory page table of the process (allocated if NULL)
+*		slots = attach slot array of the process
+*		id = segment id from shm_create
+*   Return Value: user address of the segment on success, -1 on fail
+*	Function: maps the frames of the segment into a free attach slot of the process
+*/
+int32_t shm_attach(uint32_t** table, int32_t* slots, int32_t id){
+	shm_segment_t* seg;
+	int32_t slot;
+	uint32_t i, frame, flags;
+
+	for(slot = 0; slot < SHM_MAX_ATTACH; slot++){
+		if(slots[slot] == SHM_NONE)
+			break;
+	}
+	if(slot == SHM_MAX_ATTACH)
+		return -1;
+
+	if(*table == NULL){
+		frame = alloc_zeroed_frame();
+		if(frame == NO_FRAME)
+			return -1;
+		*table = (uint32_t*) frame;
+	}
+
+	//the segment can't be destroyed between the lookup and the new reference
+	spin_lock_irqsave(&shm_lock, flags);
+	seg = shm_lookup(id);
+	if(seg == NULL){
+		spin_unlock_irqrestore(&shm_lock, flags);
+		return -1;
+	}
+	for(i = 0; i < seg->num_pages; i++)
+		(*table)[slot * SHM_MAX_PAGES + i] = seg->frames[i] | USERREADPRESENT;
+	slots[slot] = id & SHM_INDEX_MASK;
+	seg->refcount++;
+	spin_unlock_irqrestore(&shm_lock, flags);
+
+	set_shm_table(*table);
+	reset_cr3();
+	return SHM_START + slot * SHM_SLOT_SIZE;
+}
+
+/*
+* int32_t shm_detach(uint32_t* table, int32_t* slots, uint32_t addr)
+*   Inputs: table = shared memory page table of the process
+*		slots = attach slot array of the process
+*		addr = address returned by shm_attach
+*   Return Value: 0 on success, -1 on fail
+*	Function: unmaps the segment from the slot, the segment is destroyed once
+*		the last attached process detaches and its creator has halted
+*/
+int32_t shm_detach(uint32_t* table, int32_t* slots, uint32_t addr){
+	int32_t slot;
+	uint32_t flags;
+
+	if(table == NULL || addr < SHM_START || addr >= SHM_END || (addr - SHM_START) % SHM_SLOT_SIZE != 0)
+		return -1;
+	slot = (addr - SHM_START) / SHM_SLOT_SIZE;
+	if(slots[slot] == SHM_NONE)
+		return -1;
+
+	spin_lock_irqsave(&shm_lock, flags);
+	shm_unmap(table, slots, slot);
+	spin_unlock_irqrestore(&shm_lock, flags);
+	return 0;
+}
+
+/*
+* void shm_unmap(uint32_t* table, int32_t* slots, int32_t slot)
+*   Inputs: table = shared memory page table of the process
+*		slots = attach slot array of the process
+*		slot = attach slot in use
+*   Return Value: none
+*	Function: shm_detach with shm_lock held
+*/
+static void shm_unmap(uint32_t* table, int32_t* slots, int32_t slot){
+	int32_t id = slots[slot];
+	uint32_t i;
+
+	for(i = 0; i < SHM_MAX_PAGES; i++)
+		table[slot * SHM_MAX_PAGES + i] = 0;
+	reset_cr3();
+	slots[slot] = SHM_NONE;
+
+	segments[id].refcount--;
+	shm_put(&segments[id]);
+}
+
+/*
+* void shm_release(uint32_t* table, int32_t* slots, int32_t pid)
+*   Inputs: table = shared memory page table of a halting process, may be NULL
+*		slots = attach slot array of the process
+*		pid = the process, drops its hold on the segments it created
+*   Return Value: none
+*	Function: detaches every segment and frees the page table. segments it
+*		created that nobody has attached are destroyed
+*/
+void shm_release(uint32_t* table, int32_t* slots, int32_t pid){
+	int32_t slot, i;
+	uint32_t flags;
+
+	spin_lock_irqsave(&shm_lock, flags);
+	if(table != NULL){
+		for(slot = 0; slot < SHM_MAX_ATTACH; slot++){
+			if(slots[slot] != SHM_NONE)
+				shm_unmap(table, slots, slot);
+		}
+	}
+	for(i = 0; i < MAX_SHM_SEGMENTS; i++){
+		if(segments[i].flags != SHM_FREE && segments[i].creator == pid){
+			segments[i].creator = SHM_NONE;
+			shm_put(&segments[i]);
+		}
+	}
+	spin_unlock_irqrestore(&shm_lock, flags);
+	if(table != NULL)
+		free_frame((uint32_t) table);
+}
+
+/*
+* uint32_t shm_frames()
+*   Inputs: none
+*   Return Value: number of frames backing shared memory segments
+*	Function: used for memory accounting
+*/
+uint32_t shm_frames(){
+	uint32_t i, flags, count = 0;
+
+	spin_lock_irqsave(&shm_lock, flags);
+	for(i = 0; i < MAX_SHM_SEGMENTS; i++){
+		if(segments[i].flags != SHM_FREE)
+			count += segments[i].num_pages;
+	}
+	spin_unlock_irqrestore(&shm_lock, flags);
+	return count;
+}
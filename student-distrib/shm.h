@@ -0,0 +1,40 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include "types.h"
+
+//named shared memory segments, mapped into every attached process at 140MB
+#define MAX_SHM_SEGMENTS 16
+#define SHM_NAME_LEN 32
+#define SHM_MAX_PAGES 128 						//512KB per segment
+#define SHM_MAX_ATTACH 8 						//attach slots per process, one segment each
+#define SHM_START 0x08C00000 					//140MB
+#define SHM_END 0x09000000
+#define SHM_PD_INDEX 35
+#define SHM_SLOT_SIZE (SHM_MAX_PAGES * 0x1000)
+#define SHM_NONE -1
+
+//ids carry the slot in the low bits and its generation above them, an id
+//kept after its segment was destroyed doesn't find the slot's next segment
+#define SHM_INDEX_MASK (MAX_SHM_SEGMENTS - 1)
+#define SHM_GEN_SHIFT 4
+#define SHM_GEN_MASK 0x07FFFFFF 				//ids stay positive
+#define SHM_ID(index, gen) ((int32_t)(((gen) << SHM_GEN_SHIFT) | (index)))
+
+typedef struct shm_segment_t {
+	uint8_t name[SHM_NAME_LEN];
+	uint32_t num_pages;
+	uint32_t frames[SHM_MAX_PAGES]; 		//physical frames backing the segment
+	uint32_t refcount; 						//number of attached slots across all processes
+	int32_t creator; 						//pid that created it, SHM_NONE once it halted
+	uint32_t gen; 							//bumped every time the slot is freed
+	uint32_t flags;
+} shm_segment_t;
+
+int32_t shm_create(const uint8_t* name, uint32_t size, int32_t pid);
+int32_t shm_attach(uint32_t** table, int32_t* slots, int32_t id);
+int32_t shm_detach(uint32_t* table, int32_t* slots, uint32_t addr);
+void shm_release(uint32_t* table, int32_t* slots, int32_t pid);
+uint32_t shm_frames();
+
+#endif /* SHM_H */
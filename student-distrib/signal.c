@@ -0,0 +1,350 @@
+#include "signal.h"
+#include "exceptions.h"
+#include "lib.h"
+#include "sysenter.h"
+#include "uaccess.h"
+#include "x86_desc.h"
+
+//signals are only acted on when the process goes back to user mode. every
+//entry stub in isr_wrapper.S ends in signal_return, which calls
+//deliver_signals with the saved registers. a handler gets a frame on the user
+//stack and the iret lands in it, its return runs sigreturn through the
+//trampoline at the end of the frame
+
+//movl $10, %eax; int $0x80, padded with a nop
+static const uint8_t sig_trampoline[8] = {0xB8, 0x0A, 0x00, 0x00, 0x00, 0xCD, 0x80, 0x90};
+
+//exceptions in the kernel, or the ones a process can't recover from, stop the machine
+static void (*ex_fatal[NUM_EXCEPTIONS])() = {
+	ex_0, ex_1, ex_2, ex_3, ex_4, ex_5, ex_6, ex_7, ex_8, ex_9,
+	ex_10, ex_11, ex_12, ex_13, ex_14, ex_15, ex_16, ex_17, ex_18, ex_19
+};
+
+/*
+* void alarm_fire(ktimer_t* timer)
+*   Inputs: timer = alarm timer of a process
+*   Return Value: none
+*	Function: runs in the PIT interrupt, raises ALARM and sets up the next
+*		period. periods missed while the process couldn't run are dropped
+*/
+static void alarm_fire(ktimer_t* timer){
+	pcb_t* task = (pcb_t*)timer->data;
+	uint64_t period = (uint64_t)task->alarm_ms * NSEC_PER_MSEC;
+	uint64_t next = timer->expires + period;
+	uint64_t now = clock_ns();
+
+	send_signal(task, SIG_ALARM);
+	if(next <= now)
+		next = now + period;
+	timer_add(timer, next);
+}
+
+/*
+* void alarm_update(pcb_t* task)
+*   Inputs: task = process whose alarm setting changed
+*   Return Value: none
+*	Function: the alarm timer only runs while the process has an ALARM handler,
+*		ALARM is ignored by default so nobody would see it otherwise
+*/
+static void alarm_update(pcb_t* task){
+	timer_del(&task->alarm_timer);
+	if(task->alarm_ms != 0 && task->sig_handlers[SIG_ALARM] != NULL)
+		timer_add(&task->alarm_timer, clock_ns() + (uint64_t)task->alarm_ms * NSEC_PER_MSEC);
+}
+
+/*
+* void signal_init(pcb_t* task)
+*   Inputs: task = new process
+*   Return Value: none
+*	Function: every signal takes its default action, nothing is pending
+*/
+void signal_init(pcb_t* task){
+	int32_t i;
+	for(i = 0; i < NUM_SIGNALS; i++)
+		task->sig_handlers[i] = NULL;
+	task->sig_pending = 0;
+	task->sig_active = 0;
+	task->alarm_ms = ALARM_DEFAULT_MS;
+	timer_setup(&task->alarm_timer, alarm_fire, task);
+}
+
+/*
+* void signal_exit(pcb_t* task)
+*   Inputs: task = halting process
+*   Return Value: none
+*	Function: stops its alarm
+*/
+void signal_exit(pcb_t* task){
+	timer_del(&task->alarm_timer);
+	task->sig_pending = 0;
+}
+
+/*
+* uint32_t sig_deliverable(pcb_t* task)
+*   Inputs: task = process to check
+*   Return Value: bitmask of pending signals that can be acted on now
+*	Function: while a handler runs the signals with handlers wait for its
+*		sigreturn. ones whose default kills the process still go through
+*/
+static uint32_t sig_deliverable(pcb_t* task){
+	uint32_t mask = task->sig_pending;
+	int32_t i;
+
+	if(task->sig_active){
+		for(i = 0; i < NUM_SIGNALS; i++){
+			if(task->sig_handlers[i] != NULL)
+				mask &= ~SIG_BIT(i);
+		}
+	}
+	return mask;
+}
+
+/*
+* void raise_signal(pcb_t* task, int32_t sig)
+*   Inputs: task = process to signal, sig = signal number
+*   Return Value: none
+*	Function: marks the signal pending. signals that would be ignored are
+*		dropped here, others wake the process if it sleeps so its blocking
+*		call can return and the signal gets handled. sched_lock must be held
+*/
+static void raise_signal(pcb_t* task, int32_t sig){
+	if(task == NULL || sig < 0 || sig >= NUM_SIGNALS)
+		return;
+	if(task->sig_handlers[sig] == NULL && !(SIG_KILL_DEFAULT & SIG_BIT(sig)))
+		return;
+	task->sig_pending |= SIG_BIT(sig);
+	if(sig_deliverable(task) && task->state == TASK_BLOCKED)
+		sched_wake_task(task);
+	else
+		sched_kick(task); 	//running on another cpu, it notices on its way out
+}
+
+/*
+* void send_signal(pcb_t* task, int32_t sig)
+*   Inputs: task = process to signal, sig = signal number
+*   Return Value: none
+*	Function: raises the signal, safe from interrupts
+*/
+void send_signal(pcb_t* task, int32_t sig){
+	uint32_t flags;
+
+	spin_lock_irqsave(&sched_lock, flags);
+	raise_signal(task, sig);
+	spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/*
+* void signal_terminal(int32_t terminal, int32_t sig)
+*   Inputs: terminal = terminal whose processes get the signal, sig = signal number
+*   Return Value: none
+*	Function: signals the terminal's process and the background stages
+*		running on the same terminal, the slots can't change meanwhile
+*/
+void signal_terminal(int32_t terminal, int32_t sig){
+	int32_t s;
+	uint32_t flags;
+
+	spin_lock_irqsave(&sched_lock, flags);
+	raise_signal(curr_task[terminal], sig);
+	for(s = MAX_TERMINALS; s < MAX_SLOTS; s++){
+		if(curr_task[s] != NULL && curr_task[s]->terminal == terminal)
+			raise_signal(curr_task[s], sig);
+	}
+	spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/*
+* int32_t signal_pending(pcb_t* task)
+*   Inputs: task = process about to sleep
+*   Return Value: nonzero if a signal is waiting to be handled
+*	Function: blocking calls check this in their sleep loop and return
+*		ERESTART, the signal is handled on the way out of the kernel
+*/
+int32_t signal_pending(pcb_t* task){
+	return sig_deliverable(task) != 0;
+}
+
+/*
+* regs_t* user_regs(pcb_t* task)
+*   Inputs: task = process in a syscall or interrupt
+*   Return Value: the user registers saved at the top of its kernel stack
+*	Function: every way into the kernel from user mode leaves a regs_t there
+*/
+regs_t* user_regs(pcb_t* task){
+	return (regs_t*)(KERNEL_STACK_TOP(task->process_id) - sizeof(regs_t));
+}
+
+/*
+* void setup_frame(regs_t* regs, pcb_t* task, int32_t sig)
+*   Inputs: regs = user registers, task = current process, sig = signal to handle
+*   Return Value: none
+*	Function: pushes a sig_frame_t under the user stack and points the return
+*		to user mode at the handler. a process whose stack can't take the frame
+*		is killed
+*/
+static void setup_frame(regs_t* regs, pcb_t* task, int32_t sig){
+	sig_frame_t frame;
+	uint32_t sp = (regs->esp - sizeof(sig_frame_t)) & ~0x3;
+	uint16_t seg;
+
+	frame.ret_addr = sp + sizeof(frame) - sizeof(frame.trampoline);
+	frame.signum = sig;
+	frame.hw.ebx = regs->ebx;
+	frame.hw.ecx = regs->ecx;
+	frame.hw.edx = regs->edx;
+	frame.hw.esi = regs->esi;
+	frame.hw.edi = regs->edi;
+	frame.hw.ebp = regs->ebp;
+	frame.hw.eax = regs->eax;
+	asm volatile("movw %%ds, %0" : "=r"(seg));
+	frame.hw.ds = seg;
+	asm volatile("movw %%es, %0" : "=r"(seg));
+	frame.hw.es = seg;
+	asm volatile("movw %%fs, %0" : "=r"(seg));
+	frame.hw.fs = seg;
+	frame.hw.ds_pad = frame.hw.es_pad = frame.hw.fs_pad = 0;
+	frame.hw.vector = regs->vector;
+	frame.hw.err = regs->err;
+	frame.hw.eip = regs->eip;
+	frame.hw.cs = regs->cs;
+	frame.hw.eflags = regs->eflags;
+	frame.hw.esp = regs->esp;
+	frame.hw.ss = regs->ss;
+	memcpy(frame.trampoline, sig_trampoline, sizeof(sig_trampoline));
+
+	if(copy_to_user((void*)sp, &frame, sizeof(frame)) != 0){
+		process_halt(HALT_EXCEPTION);
+		return;
+	}
+	task->sig_active = 1;
+	regs->esp = sp;
+	regs->eip = (uint32_t)task->sig_handlers[sig];
+}
+
+/*
+* void deliver_signals(regs_t* regs)
+*   Inputs: regs = registers the kernel is about to return with
+*   Return Value: none
+*	Function: called by every entry stub before it returns, interrupts off.
+*		senders on other cpus set sig_pending under sched_lock. on the way back to user mode the lowest pending signal is handled,
+*		ALARM and USER1 are ignored by default, the others kill the process
+*/
+void deliver_signals(regs_t* regs){
+	pcb_t* task;
+	uint32_t mask;
+	int32_t sig;
+
+	if((regs->cs & 0x3) != 0x3)
+		return;
+	task = curr_task[running_slot];
+	if(task == NULL || task->sig_pending == 0)
+		return;
+	spin_lock(&sched_lock);
+	mask = sig_deliverable(task);
+	for(sig = 0; sig < NUM_SIGNALS && !(mask & SIG_BIT(sig)); sig++);
+	if(mask != 0)
+		task->sig_pending &= ~SIG_BIT(sig);
+	spin_unlock(&sched_lock);
+	if(mask == 0)
+		return;
+
+	if(task->sig_handlers[sig] != NULL && !task->sig_active){
+		setup_frame(regs, task, sig);
+		return;
+	}
+	if(SIG_KILL_DEFAULT & SIG_BIT(sig))
+		process_halt((SIG_EXCEPTIONS & SIG_BIT(sig)) ? HALT_EXCEPTION : HALT_INTERRUPT);
+}
+
+/*
+* void exception_handler(regs_t* regs)
+*   Inputs: regs = registers at the exception
+*   Return Value: none
+*	Function: an exception in the kernel stops the machine as before. a user
+*		process gets DIV_ZERO for a divide error and SEGFAULT for anything
+*		else, delivered when the stub returns. a fault while its handler for
+*		that signal runs would only repeat, so the process is killed
+*/
+void exception_handler(regs_t* regs){
+	pcb_t* task = curr_task[running_slot];
+	int32_t sig;
+
+	//user code single stepped into sysenter, which traps on the first
+	//instruction of sysenter_entry. the stepping ends there
+	if(regs->vector == EX_DEBUG && regs->eip == (uint32_t)sysenter_entry){
+		regs->eflags &= ~EFLAGS_TF;
+		return;
+	}
+	if((regs->cs & 0x3) != 0x3 || task == NULL || regs->vector == EX_NMI ||
+			regs->vector == EX_DOUBLE_FAULT || regs->vector == EX_MACHINE_CHECK){
+		ex_fatal[regs->vector]();
+		return;
+	}
+	sig = (regs->vector == EX_DIVIDE) ? SIG_DIV_ZERO : SIG_SEGFAULT;
+	if(task->sig_active && task->sig_handlers[sig] != NULL)
+		process_halt(HALT_EXCEPTION);
+	send_signal(task, sig);
+}
+
+/*
+* int32_t set_handler(int32_t sig, void* handler)
+*   Inputs: sig = signal number, handler = user function, NULL for the default
+*   Return Value: 0 on success, -1 on a bad signal number
+*	Function: installs the handler for the current process
+*/
+int32_t set_handler(int32_t sig, void* handler){
+	pcb_t* task = curr_task[running_slot];
+
+	if(sig < 0 || sig >= NUM_SIGNALS)
+		return -1;
+	task->sig_handlers[sig] = handler;
+	if(sig == SIG_ALARM)
+		alarm_update(task);
+	return 0;
+}
+
+/*
+* int32_t sigreturn(regs_t* regs)
+*   Inputs: regs = user registers of the sigreturn syscall
+*   Return Value: eax to return to, the process continues where the signal
+*		interrupted it
+*	Function: copies the saved registers back from the frame above the user
+*		stack. the handler may have changed them, but not to leave user mode
+*		or raise its io privilege
+*/
+int32_t sigreturn(regs_t* regs){
+	pcb_t* task = curr_task[running_slot];
+	hw_context_t hw;
+
+	if(!task->sig_active || copy_from_user(&hw, (void*)(regs->esp + sizeof(uint32_t)), sizeof(hw)) != 0)
+		return -1;
+	regs->ebx = hw.ebx;
+	regs->ecx = hw.ecx;
+	regs->edx = hw.edx;
+	regs->esi = hw.esi;
+	regs->edi = hw.edi;
+	regs->ebp = hw.ebp;
+	regs->eip = hw.eip;
+	regs->esp = hw.esp;
+	regs->eflags = (regs->eflags & ~EFLAGS_USER) | (hw.eflags & EFLAGS_USER);
+	regs->vector = SYSTEM_CALL_IDT; 	//iret, sysexit would lose ecx and edx
+	task->sig_active = 0;
+	return hw.eax;
+}
+
+/*
+* int32_t set_alarm(uint32_t ms)
+*   Inputs: ms = ALARM period in ms, 0 stops it
+*   Return Value: the previous period, -1 if out of range
+*	Function: the period starts over from now
+*/
+int32_t set_alarm(uint32_t ms){
+	pcb_t* task = curr_task[running_slot];
+	uint32_t old = task->alarm_ms;
+
+	if(ms > ALARM_MAX_MS)
+		return -1;
+	task->alarm_ms = ms;
+	alarm_update(task);
+	return old;
+}
@@ -0,0 +1,91 @@
+#ifndef SIGNAL_H
+#define SIGNAL_H
+
+//signal numbers, same order as enum signums in ece391syscall.h
+#define SIG_DIV_ZERO 0
+#define SIG_SEGFAULT 1
+#define SIG_INTERRUPT 2
+#define SIG_ALARM 3
+#define SIG_USER1 4
+#define NUM_SIGNALS 5
+
+#define SIG_BIT(sig) (1 << (sig))
+#define SIG_KILL_DEFAULT (SIG_BIT(SIG_DIV_ZERO) | SIG_BIT(SIG_SEGFAULT) | SIG_BIT(SIG_INTERRUPT))
+#define SIG_EXCEPTIONS (SIG_BIT(SIG_DIV_ZERO) | SIG_BIT(SIG_SEGFAULT))
+
+#define HALT_EXCEPTION 256 				//status execute returns for a process killed by an exception
+#define HALT_INTERRUPT 1 				//status of a process killed by ctrl+C
+
+#define ALARM_DEFAULT_MS 10000
+#define ALARM_MAX_MS 3600000 			//an hour
+
+//a blocking syscall interrupted by a signal. ex_128 backs the process up onto
+//its int $0x80 so the call starts over once the signal has been handled
+#define ERESTART -512
+#define INT80_LEN 2 					//bytes of the int $0x80 instruction
+
+//offsets into regs_t for the stubs
+#define REGS_EDX 20
+#define REGS_ECX 24
+#define REGS_EAX 28
+#define REGS_VECTOR 32
+#define REGS_EIP 40
+
+#define EFLAGS_USER 0x0CD5 			//CF PF AF ZF SF DF OF, all sigreturn may change
+
+#define NUM_EXCEPTIONS 20
+#define EX_DIVIDE 0
+#define EX_DEBUG 1
+#define EX_NMI 2
+#define EX_DOUBLE_FAULT 8
+#define EX_MACHINE_CHECK 18
+
+#ifndef ASM
+
+#include "types.h"
+
+//registers of the interrupted code, the layout every entry stub in
+//isr_wrapper.S leaves at the top of the kernel stack
+typedef struct regs_t {
+	uint32_t edi, esi, ebp, esp_dummy, ebx, edx, ecx, eax; //pusha
+	uint32_t vector;
+	uint32_t err; 						//error code, 0 for vectors without one
+	uint32_t eip, cs, eflags, esp, ss; 	//esp and ss only from user mode
+} regs_t;
+
+//saved user registers in the handler's frame, the order ece391sigtest expects
+typedef struct hw_context_t {
+	uint32_t ebx, ecx, edx, esi, edi, ebp, eax;
+	uint16_t ds, ds_pad;
+	uint16_t es, es_pad;
+	uint16_t fs, fs_pad;
+	uint32_t vector, err;
+	uint32_t eip, cs, eflags, esp, ss;
+} hw_context_t;
+
+//pushed on the user stack when a handler runs. the handler returns into the
+//trampoline code, which calls sigreturn
+typedef struct sig_frame_t {
+	uint32_t ret_addr;
+	uint32_t signum;
+	hw_context_t hw;
+	uint8_t trampoline[8];
+} sig_frame_t;
+
+struct pcb_t;
+
+void signal_init(struct pcb_t* task);
+void signal_exit(struct pcb_t* task);
+void send_signal(struct pcb_t* task, int32_t sig);
+void signal_terminal(int32_t terminal, int32_t sig);
+int32_t signal_pending(struct pcb_t* task);
+void deliver_signals(regs_t* regs);
+void exception_handler(regs_t* regs);
+int32_t set_handler(int32_t sig, void* handler);
+int32_t sigreturn(regs_t* regs);
+int32_t set_alarm(uint32_t ms);
+regs_t* user_regs(struct pcb_t* task);
+
+#endif /* ASM */
+
+#endif /* SIGNAL_H */
@@ -0,0 +1,386 @@
+#include "smp.h"
+#include "exceptions.h"
+#include "fpu.h"
+#include "i8259.h"
+#include "ioapic.h"
+#include "lapic.h"
+#include "lib.h"
+#include "paging.h"
+#include "sched.h"
+#include "signal.h"
+#include "spinlock.h"
+#include "sysenter.h"
+
+//multiprocessor support. the cpus are found through the MP table the bios
+//leaves in low memory, started with INIT and STARTUP interrupts and then
+//run the scheduler's idle loop until it gives them a process. they share
+//the GDT, each has its own TSS, page directory and run queue. every cpu runs
+//kernel code at once, each subsystem guards what it shares with its own
+//spinlock, the scheduler's is sched_lock
+
+cpu_t cpus[MAX_CPUS];
+uint32_t num_cpus = 1;
+uint32_t smp_active;
+
+static tss_t ap_tss[MAX_CPUS - 1];
+static uint32_t mp_imcr; 				//the chipset has an IMCR
+
+/*
+* uint8_t mp_checksum(uint8_t* addr, uint32_t len)
+*   Inputs: addr = start of an MP structure, len = its length
+*   Return Value: sum of its bytes, 0 for a valid structure
+*/
+static uint8_t mp_checksum(uint8_t* addr, uint32_t len){
+	uint8_t sum = 0;
+	uint32_t i;
+	for(i = 0; i < len; i++)
+		sum += addr[i];
+	return sum;
+}
+
+/*
+* mp_float_t* mp_scan(uint32_t addr, uint32_t len)
+*   Inputs: addr = physical address to search from, len = bytes to search
+*   Return Value: floating pointer structure found there, NULL if none
+*/
+static mp_float_t* mp_scan(uint32_t addr, uint32_t len){
+	mp_float_t* mp;
+	uint32_t end = addr + len;
+	for(; addr + sizeof(mp_float_t) <= end; addr += MP_ALIGN){
+		mp = (mp_float_t*)addr;
+		if(strncmp(mp->sig, MP_FLOAT_SIG, MP_SIG_LEN) == 0 && mp_checksum((uint8_t*)mp, mp->length * MP_ALIGN) == 0)
+			return mp;
+	}
+	return NULL;
+}
+
+/*
+* mp_config_t* mp_find()
+*   Inputs: none
+*   Return Value: MP configuration table, NULL if the bios has none
+*	Function: searches the first KB of the EBDA, the last KB of base memory
+*		and the bios rom, in that order, as the MP spec says. low memory
+*		must be mapped
+*/
+static mp_config_t* mp_find(){
+	mp_float_t* mp;
+	mp_config_t* config;
+	uint32_t ebda = (uint32_t)(*(uint16_t*)BDA_EBDA) << 4;
+	uint32_t base_kb = *(uint16_t*)BDA_BASE_KB;
+
+	mp = NULL;
+	if(ebda != 0)
+		mp = mp_scan(ebda, EBDA_SCAN_LEN);
+	if(mp == NULL)
+		mp = mp_scan(base_kb * EBDA_SCAN_LEN - EBDA_SCAN_LEN, EBDA_SCAN_LEN);
+	if(mp == NULL)
+		mp = mp_scan(BIOS_ROM, BIOS_ROM_LEN);
+	if(mp == NULL || mp->config == 0 || mp->config >= LOW_MEMORY_END)
+		return NULL; 	//default configurations aren't supported
+	mp_imcr = mp->features[1] & MP_IMCR;
+	config = (mp_config_t*)mp->config;
+	if(strncmp(config->sig, MP_CONFIG_SIG, MP_SIG_LEN) != 0 || mp_checksum((uint8_t*)config, config->length) != 0)
+		return NULL;
+	return config;
+}
+
+/*
+* void mp_read_ioint(mp_ioint_t* ioint, uint32_t isa_bus, uint32_t ioapic_id)
+*   Inputs: ioint = io interrupt entry, isa_bus = bus id of the ISA bus
+*		ioapic_id = id of the IOAPIC that is used
+*   Return Value: none
+*	Function: puts an ISA irq that isn't on the pin of its own number, or
+*		isn't edge triggered active high, into the IOAPIC routing table
+*/
+static void mp_read_ioint(mp_ioint_t* ioint, uint32_t isa_bus, uint32_t ioapic_id){
+	uint32_t flags = 0;
+
+	if(ioint->int_type != MP_INT || ioint->src_bus != isa_bus || ioint->dst_ioapic != ioapic_id)
+		return;
+	if((ioint->flags & MP_POLARITY) == MP_ACTIVE_LOW)
+		flags |= IOAPIC_ACTIVE_LOW;
+	if(((ioint->flags >> MP_TRIGGER_SHIFT) & MP_TRIGGER) == MP_LEVEL)
+		flags |= IOAPIC_LEVEL;
+	ioapic_route(ioint->src_irq, ioint->dst_pin, flags);
+}
+
+/*
+* void mp_read_config(mp_config_t* config)
+*   Inputs: config = MP configuration table
+*   Return Value: none
+*	Function: fills in cpus with the enabled processors, cpu 0 is the one
+*		running this. finds the first IOAPIC and how the ISA irqs are wired
+*		to it, the bus and IOAPIC entries come before the interrupt ones
+*/
+static void mp_read_config(mp_config_t* config){
+	uint8_t* entry = (uint8_t*)(config + 1);
+	uint8_t* end = (uint8_t*)config + config->length;
+	uint32_t self = lapic_id();
+	uint32_t isa_bus = MP_ID_NONE, ioapic_id = MP_ID_NONE;
+	mp_proc_t* proc;
+	mp_bus_t* bus;
+	mp_ioapic_t* ioapic;
+
+	cpus[0].apic_id = self;
+	while(entry < end && *entry <= MP_LAST_TYPE){
+		switch(*entry){
+			case MP_BUS:
+				bus = (mp_bus_t*)entry;
+				if(strncmp(bus->bus_type, MP_BUS_ISA, MP_BUS_TYPE_LEN) == 0)
+					isa_bus = bus->id;
+				break;
+			case MP_IOAPIC:
+				ioapic = (mp_ioapic_t*)entry;
+				if((ioapic->flags & MP_IOAPIC_ENABLED) && ioapic_base == 0){
+					ioapic_base = ioapic->addr;
+					ioapic_id = ioapic->id;
+				}
+				break;
+			case MP_IOINT:
+				mp_read_ioint((mp_ioint_t*)entry, isa_bus, ioapic_id);
+				break;
+		}
+		if(*entry != MP_PROC){
+			entry += MP_OTHER_LEN;
+			continue;
+		}
+		proc = (mp_proc_t*)entry;
+		entry += MP_PROC_LEN;
+		if(!(proc->flags & MP_PROC_ENABLED) || proc->apic_id == self || num_cpus == MAX_CPUS)
+			continue;
+		cpus[num_cpus].id = num_cpus;
+		cpus[num_cpus].apic_id = proc->apic_id;
+		num_cpus++;
+	}
+}
+
+/*
+* void ap_tss_init(uint32_t cpu)
+*   Inputs: cpu = index of one of the other cpus
+*   Return Value: none
+*	Function: builds its TSS and the GDT entry for it the same way kernel.c
+*		does for cpu 0's
+*/
+static void ap_tss_init(uint32_t cpu){
+	seg_desc_t the_tss_desc;
+	tss_t* ts = &ap_tss[cpu - 1];
+
+	the_tss_desc.granularity    = 0;
+	the_tss_desc.opsize         = 0;
+	the_tss_desc.reserved       = 0;
+	the_tss_desc.avail          = 0;
+	the_tss_desc.present        = 1;
+	the_tss_desc.dpl            = 0x0;
+	the_tss_desc.sys            = 0;
+	the_tss_desc.type           = 0x9;
+	SET_TSS_PARAMS(the_tss_desc, ts, tss_size);
+	ap_tss_desc_ptr[cpu - 1] = the_tss_desc;
+
+	memset(ts, 0, sizeof(tss_t));
+	ts->ldt_segment_selector = KERNEL_LDT;
+	ts->ss0 = KERNEL_DS;
+	ts->esp0 = idle_stack_top(cpu);
+}
+
+/*
+* void delay_us(uint32_t us)
+*   Inputs: us = time to wait
+*   Return Value: none
+*	Function: spins on the monotonic clock
+*/
+static void delay_us(uint32_t us){
+	uint64_t end = clock_ns() + (uint64_t)us * NSEC_PER_USEC;
+	while(clock_ns() < end);
+}
+
+/*
+* int32_t ap_start(uint32_t cpu)
+*   Inputs: cpu = index of the cpu to start
+*   Return Value: 0 once it is online, -1 if it never showed up
+*	Function: copies the startup code with this cpu's stack below 1MB and
+*		sends it INIT and two STARTUPs, as the MP spec says
+*/
+static int32_t ap_start(uint32_t cpu){
+	uint32_t apic_id = cpus[cpu].apic_id;
+	uint64_t timeout;
+
+	ap_tss_init(cpu);
+	ap_stack = idle_stack_top(cpu);
+	ap_cpu = cpu;
+	memcpy((void*)AP_TRAMPOLINE, ap_trampoline, ap_trampoline_end - ap_trampoline);
+
+	lapic_send_ipi(apic_id, ICR_INIT | ICR_ASSERT | ICR_LEVEL);
+	lapic_send_ipi(apic_id, ICR_INIT | ICR_LEVEL);
+	delay_us(AP_INIT_DELAY_US);
+	lapic_send_ipi(apic_id, ICR_STARTUP | AP_TRAMPOLINE_PAGE);
+	delay_us(AP_SIPI_DELAY_US);
+	if(!cpus[cpu].online)
+		lapic_send_ipi(apic_id, ICR_STARTUP | AP_TRAMPOLINE_PAGE);
+
+	timeout = clock_ns() + (uint64_t)AP_BOOT_TIMEOUT_MS * NSEC_PER_MSEC;
+	while(!cpus[cpu].online && clock_ns() < timeout);
+	return cpus[cpu].online ? 0 : -1;
+}
+
+/*
+* void smp_init()
+*   Inputs: none
+*   Return Value: none
+*	Function: moves the irqs to the IOAPIC and starts the other cpus, if
+*		the bios reports them. called once the scheduler is set up and with
+*		interrupts on, the clock must run. the others go to their idle loops
+*/
+void smp_init(){
+	mp_config_t* config;
+	uint32_t cpu;
+
+	cpus[0].id = 0;
+	cpus[0].online = 1;
+	SET_IDT_ENTRY(idt[IPI_IDT], ipi_entry);
+	set_interrupt_gate(IPI_IDT);
+	SET_IDT_ENTRY(idt[LAPIC_SPURIOUS_IDT], spurious_entry);
+	set_interrupt_gate(LAPIC_SPURIOUS_IDT);
+	SET_IDT_ENTRY(idt[LAPIC_TIMER_IDT], ex_32); 	//same tick as the PIT's
+	set_interrupt_gate(LAPIC_TIMER_IDT);
+
+	map_low_memory(1);
+	config = mp_find();
+	if(config == NULL){
+		map_low_memory(0);
+		return; 	//no MP table, a single cpu
+	}
+	lapic_init(config->lapic);
+	mp_read_config(config);
+	//without an IOAPIC the i8259 and the PIT stay
+	if(i8259_to_ioapic(cpus[0].apic_id, mp_imcr) == 0)
+		timer_use_lapic();
+	memcpy(ap_gdt_desc, (uint8_t*)&gdt_desc, GDT_DESC_LEN);
+
+	smp_active = 1;
+	for(cpu = 1; cpu < num_cpus; cpu++){
+		if(ap_start(cpu) != 0){
+			num_cpus = cpu; 	//cpus are numbered densely, the TSS selector gives the index
+			break;
+		}
+	}
+	map_low_memory(0);
+	if(num_cpus == 1)
+		smp_active = 0;
+}
+
+/*
+* void ap_main(uint32_t cpu)
+*   Inputs: cpu = index in cpus, from the startup code
+*   Return Value: never returns
+*	Function: first C code on the other cpus, on their idle stack. loads the
+*		descriptor tables, turns on paging and the fpu and goes idle
+*/
+void ap_main(uint32_t cpu){
+	if(cpu >= num_cpus){
+		while(1)
+			asm volatile("cli; hlt"); 	//showed up after smp_init gave up on it
+	}
+	ltr(CPU_TSS(cpu));
+	lidt(idt_desc_ptr);
+	lldt(KERNEL_LDT);
+	paging_init_ap();
+	fpu_init_cpu();
+	sysenter_init_cpu();
+	lapic_init_ap();
+	cpus[cpu].online = 1;
+	sched_idle();
+}
+
+/*
+* void set_kernel_stack(uint32_t esp0)
+*   Inputs: esp0 = top of the kernel stack of the process about to run
+*   Return Value: none
+*	Function: interrupts and sysenter from user mode on this cpu switch to
+*		that stack
+*/
+void set_kernel_stack(uint32_t esp0){
+	uint32_t cpu = cpu_id();
+	if(cpu == 0)
+		tss.esp0 = esp0;
+	else
+		ap_tss[cpu - 1].esp0 = esp0;
+	sysenter_set_stack(esp0);
+}
+
+/*
+* void smp_kick(uint32_t cpu)
+*   Inputs: cpu = index of the cpu to interrupt
+*   Return Value: none
+*	Function: makes it enter the kernel and look for something to do
+*/
+void smp_kick(uint32_t cpu){
+	if(cpu < num_cpus && cpu != cpu_id())
+		lapic_send_ipi(cpus[cpu].apic_id, ICR_FIXED | IPI_IDT);
+}
+
+/*
+* void smp_kick_idle()
+*   Inputs: none
+*   Return Value: none
+*	Function: wakes the halted cpus after something became runnable, the
+*		first to pick it runs it. sched_lock is held, so a cpu about to halt
+*		either sees the new work or is marked idle already
+*/
+void smp_kick_idle(){
+	uint32_t cpu;
+	if(!smp_active)
+		return;
+	for(cpu = 0; cpu < num_cpus; cpu++){
+		if(cpus[cpu].idle)
+			smp_kick(cpu);
+	}
+}
+
+/*
+* void smp_kick_others()
+*   Inputs: none
+*   Return Value: none
+*	Function: interrupts every other cpu, e.g. so they remap vidmap pages
+*		after a terminal switch
+*/
+void smp_kick_others(){
+	uint32_t cpu;
+	if(!smp_active)
+		return;
+	for(cpu = 0; cpu < num_cpus; cpu++)
+		smp_kick(cpu);
+}
+
+/*
+* int32_t smp_others_idle()
+*   Inputs: none
+*   Return Value: 1 if every other cpu is halted
+*	Function: cpu 0 only stops the tick then, the others' time slices run
+*		on it
+*/
+int32_t smp_others_idle(){
+	uint32_t cpu;
+	for(cpu = 0; cpu < num_cpus; cpu++){
+		if(cpu != cpu_id() && !cpus[cpu].idle)
+			return 0;
+	}
+	return 1;
+}
+
+/*
+* void ipi_handler()
+*   Inputs: none
+*   Return Value: none
+*	Function: another cpu wants this one to reschedule or notice a change,
+*		e.g. the terminal on screen. the switch happens right here, on the
+*		stack of the interrupted process
+*/
+void ipi_handler(){
+	cpu_t* cpu = this_cpu();
+	lapic_eoi();
+	cpu->ipis++;
+	if(cpu->id == 0)
+		timer_ipi(); 	//maybe a kernel timer came in from another cpu
+	sched_resume();
+	schedule();
+}
@@ -0,0 +1,187 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include "x86_desc.h"
+
+//the other cpus start in real mode at a page below 1MB, the SIPI vector is
+//its page number
+#define AP_TRAMPOLINE 0x7000
+#define AP_TRAMPOLINE_PAGE (AP_TRAMPOLINE >> 12)
+#define CR0_PE 0x1
+
+#define IPI_IDT 0xF0 						//reschedule, also just to wake a halted cpu
+
+#ifndef ASM
+
+#include "types.h"
+
+//MP floating pointer and configuration table, Intel MP spec 1.4
+#define MP_FLOAT_SIG "_MP_"
+#define MP_CONFIG_SIG "PCMP"
+#define MP_SIG_LEN 4
+#define MP_ALIGN 16
+#define MP_PROC 0 							//entry types
+#define MP_BUS 1
+#define MP_IOAPIC 2
+#define MP_IOINT 3
+#define MP_PROC_LEN 20
+#define MP_OTHER_LEN 8 						//bus, io apic, irq and local irq entries
+#define MP_LAST_TYPE 4
+#define MP_PROC_ENABLED 0x1
+#define MP_IOAPIC_ENABLED 0x1
+#define MP_IMCR 0x80 						//features[1], the chipset has an IMCR
+#define MP_BUS_ISA "ISA   "
+#define MP_BUS_TYPE_LEN 6
+#define MP_INT 0 							//io interrupt that is a plain vectored irq
+#define MP_POLARITY 0x3 					//io interrupt flags, 0 conforms to the bus
+#define MP_ACTIVE_LOW 0x3
+#define MP_TRIGGER_SHIFT 2
+#define MP_TRIGGER 0x3
+#define MP_LEVEL 0x3
+#define MP_ID_NONE 0xFFFFFFFF
+#define BDA_EBDA 0x40E 						//segment of the extended bios data area
+#define BDA_BASE_KB 0x413 					//kb of memory below 640KB
+#define BIOS_ROM 0xF0000
+#define BIOS_ROM_LEN 0x10000
+#define EBDA_SCAN_LEN 1024
+#define LOW_MEMORY_END 0x100000
+
+//INIT, then two STARTUPs, delays from the MP spec
+#define AP_INIT_DELAY_US 10000
+#define AP_SIPI_DELAY_US 200
+#define AP_BOOT_TIMEOUT_MS 100
+#define IDLE_STACK_SIZE 0x2000
+#define GDT_DESC_LEN 6 						//limit and base, what lgdt loads
+
+typedef struct mp_float_t {
+	int8_t sig[MP_SIG_LEN];
+	uint32_t config; 					//physical address of the configuration table
+	uint8_t length; 					//in 16 byte units
+	uint8_t version;
+	uint8_t checksum;
+	uint8_t features[5];
+} __attribute__((packed)) mp_float_t;
+
+typedef struct mp_config_t {
+	int8_t sig[MP_SIG_LEN];
+	uint16_t length;
+	uint8_t version;
+	uint8_t checksum;
+	int8_t oem[20];
+	uint32_t oem_table;
+	uint16_t oem_length;
+	uint16_t entries;
+	uint32_t lapic; 					//where the local APICs are mapped
+	uint16_t ext_length;
+	uint8_t ext_checksum;
+	uint8_t reserved;
+} __attribute__((packed)) mp_config_t;
+
+typedef struct mp_proc_t {
+	uint8_t type;
+	uint8_t apic_id;
+	uint8_t apic_version;
+	uint8_t flags;
+	uint32_t signature;
+	uint32_t features;
+	uint32_t reserved[2];
+} __attribute__((packed)) mp_proc_t;
+
+typedef struct mp_bus_t {
+	uint8_t type;
+	uint8_t id;
+	int8_t bus_type[MP_BUS_TYPE_LEN];
+} __attribute__((packed)) mp_bus_t;
+
+typedef struct mp_ioapic_t {
+	uint8_t type;
+	uint8_t id;
+	uint8_t version;
+	uint8_t flags;
+	uint32_t addr;
+} __attribute__((packed)) mp_ioapic_t;
+
+//which IOAPIC pin a bus irq is wired to
+typedef struct mp_ioint_t {
+	uint8_t type;
+	uint8_t int_type;
+	uint16_t flags;
+	uint8_t src_bus;
+	uint8_t src_irq;
+	uint8_t dst_ioapic;
+	uint8_t dst_pin;
+} __attribute__((packed)) mp_ioint_t;
+
+//what each cpu is doing. the scheduler fields replace the globals the
+//kernel had while it ran on one cpu
+typedef struct cpu_t {
+	uint32_t id; 						//index in cpus, also picks the TSS
+	uint32_t apic_id;
+	volatile uint32_t online;
+	int32_t slot; 						//slot of curr_task it runs, SLOT_IDLE if none
+	int32_t terminal; 					//terminal of that process
+	int32_t shown_terminal; 			//current_terminal when its vidmap page was set up
+	uint32_t slice_left;
+	volatile uint32_t need_resched;
+	volatile uint32_t idle; 			//halted until an interrupt
+	uint32_t in_idle; 					//in cpu_idle, whose caller picks what runs next
+	uint32_t idle_esp; 					//its idle loop, parked in switch_to
+	uint32_t dead_esp; 					//stacks of exited processes are parked here
+	int32_t dead_pid; 					//process that exited here, freed once off its stack
+	uint32_t ipis; 						//interrupts from other cpus
+} cpu_t;
+
+extern cpu_t cpus[MAX_CPUS];
+extern uint32_t num_cpus;
+extern uint32_t smp_active; 			//more than one cpu is running
+
+/* Index of the calling cpu in cpus, from the TSS it loaded */
+static inline uint32_t cpu_id(void)
+{
+	uint16_t sel;
+	asm volatile("str %0" : "=r"(sel));
+	return (sel < AP_TSS) ? 0 : ((sel - AP_TSS) >> 3) + 1;
+}
+
+#define this_cpu() (&cpus[cpu_id()])
+
+/* Swaps val into *addr and returns what was there, atomically across cpus */
+static inline uint32_t xchg(volatile uint32_t* addr, uint32_t val)
+{
+	asm volatile("xchgl %0, %1"
+			: "+r"(val), "+m"(*addr)
+			:
+			: "memory" );
+	return val;
+}
+
+/* Adds val to *addr and returns what was there, atomically across cpus */
+static inline uint32_t xadd(volatile uint32_t* addr, uint32_t val)
+{
+	asm volatile("lock; xaddl %0, %1"
+			: "+r"(val), "+m"(*addr)
+			:
+			: "memory", "cc" );
+	return val;
+}
+
+void smp_init();
+void ap_main(uint32_t cpu);
+void set_kernel_stack(uint32_t esp0);
+void smp_kick(uint32_t cpu);
+void smp_kick_idle();
+void smp_kick_others();
+int32_t smp_others_idle();
+void ipi_handler();
+void ipi_entry();
+
+//startup code in smp_boot.S, copied to AP_TRAMPOLINE
+extern uint8_t ap_trampoline[];
+extern uint8_t ap_trampoline_end[];
+extern uint8_t ap_gdt_desc[];
+extern uint32_t ap_stack;
+extern uint32_t ap_cpu;
+
+#endif /* ASM */
+
+#endif /* SMP_H */
@@ -0,0 +1,105 @@
+#include "spinlock.h"
+#include "smp.h"
+#include "timer.h"
+
+//every lock shows up in lockstat the first time it is taken
+static spinlock_t* locks[MAX_LOCKS];
+static volatile uint32_t num_locks;
+
+/*
+* void lock_register(spinlock_t* lock)
+*   Inputs: lock = lock just taken for the first time
+*   Return Value: none
+*	Function: adds it to the table lockstat reads, once
+*/
+static void lock_register(spinlock_t* lock){
+	uint32_t i;
+	if(xchg(&lock->registered, 1) != 0)
+		return;
+	i = xadd(&num_locks, 1);
+	if(i < MAX_LOCKS)
+		locks[i] = lock;
+}
+
+/*
+* void spin_lock(spinlock_t* lock)
+*   Inputs: lock = lock to take
+*   Return Value: none
+*	Function: takes a ticket and spins until it is served. the wait and the
+*		time the lock is then held are counted in TSC cycles
+*/
+void spin_lock(spinlock_t* lock){
+	uint64_t start = rdtsc();
+	uint32_t ticket = xadd(&lock->next, 1);
+	uint32_t waited = 0;
+
+	while(lock->serving != ticket){
+		waited = 1;
+		asm volatile("pause");
+	}
+	lock->cpu = cpu_id();
+	lock->stamp = rdtsc();
+	lock->acquired++;
+	if(waited){
+		lock->contended++;
+		lock->wait_cycles += lock->stamp - start;
+	}
+	if(!lock->registered)
+		lock_register(lock);
+}
+
+/*
+* void spin_unlock(spinlock_t* lock)
+*   Inputs: lock = lock held by this cpu
+*   Return Value: none
+*	Function: hands the lock to the next ticket
+*/
+void spin_unlock(spinlock_t* lock){
+	uint64_t held = rdtsc() - lock->stamp;
+
+	lock->hold_cycles += held;
+	if(held > lock->max_hold_cycles)
+		lock->max_hold_cycles = held;
+	lock->cpu = -1;
+	asm volatile("" : : : "memory");
+	lock->serving++; 	//only the holder writes it
+}
+
+/*
+* uint32_t cycles_to_us(uint64_t cycles)
+*   Inputs: cycles = TSC cycles
+*   Return Value: the same time in us, 0 without a calibrated TSC
+*/
+static uint32_t cycles_to_us(uint64_t cycles){
+	uint64_t ns = cycles_to_ns(cycles);
+	div64(&ns, NSEC_PER_USEC);
+	return (uint32_t)ns;
+}
+
+/*
+* int32_t get_lock_stats(lock_stats_t* out, int32_t max)
+*   Inputs: out = array to fill in, max = its length
+*   Return Value: number of locks filled in
+*	Function: copies out the counters of every lock taken so far
+*/
+int32_t get_lock_stats(lock_stats_t* out, int32_t max){
+	spinlock_t* lock;
+	int32_t i, n;
+
+	n = (num_locks < MAX_LOCKS) ? num_locks : MAX_LOCKS;
+	if(n > max)
+		n = max;
+	for(i = 0; i < n; i++){
+		lock = locks[i];
+		if(lock == NULL)
+			break; 	//registered but not stored yet
+		memset(out[i].name, 0, LOCK_NAME_LEN);
+		strncpy(out[i].name, lock->name, LOCK_NAME_LEN - 1);
+		out[i].acquired = lock->acquired;
+		out[i].contended = lock->contended;
+		out[i].wait_us = cycles_to_us(lock->wait_cycles);
+		out[i].hold_us = cycles_to_us(lock->hold_cycles);
+		out[i].max_hold_us = cycles_to_us(lock->max_hold_cycles);
+	}
+	return i;
+}
@@ -0,0 +1,56 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include "types.h"
+#include "lib.h"
+
+//ticket spinlocks, each cpu waits its turn in the order it asked. the
+//_irqsave variants also turn interrupts off, needed for any lock an interrupt
+//handler or the worker thread takes, or they would spin on a lock the code
+//they interrupted holds
+#define MAX_LOCKS 32 						//locks lockstat reports on
+#define LOCK_NAME_LEN 16
+
+typedef struct spinlock_t {
+	volatile uint32_t next; 			//ticket the next cpu to ask gets
+	volatile uint32_t serving; 			//ticket that holds the lock
+	int32_t cpu; 						//cpu holding it, -1 if free
+	const int8_t* name;
+	volatile uint32_t registered; 		//in the lockstat table
+	uint64_t stamp; 					//TSC when it was taken
+	uint32_t acquired;
+	uint32_t contended; 				//acquisitions that had to wait
+	uint64_t wait_cycles;
+	uint64_t hold_cycles;
+	uint64_t max_hold_cycles;
+} spinlock_t;
+
+#define SPIN_LOCK_INIT(lock_name) { 0, 0, -1, lock_name, 0, 0, 0, 0, 0, 0, 0 }
+
+//counters of one lock, returned by lockstat
+typedef struct lock_stats_t {
+	int8_t name[LOCK_NAME_LEN];
+	uint32_t acquired;
+	uint32_t contended;
+	uint32_t wait_us; 					//spent spinning for it
+	uint32_t hold_us; 					//spent holding it
+	uint32_t max_hold_us;
+} lock_stats_t;
+
+void spin_lock(spinlock_t* lock);
+void spin_unlock(spinlock_t* lock);
+int32_t get_lock_stats(lock_stats_t* out, int32_t max);
+
+#define spin_lock_irqsave(lock, flags) \
+do { \
+	cli_and_save(flags); \
+	spin_lock(lock); \
+} while(0)
+
+#define spin_unlock_irqrestore(lock, flags) \
+do { \
+	spin_unlock(lock); \
+	restore_flags(flags); \
+} while(0)
+
+#endif /* SPINLOCK_H */
@@ -0,0 +1,340 @@
+#include "swap.h"
+#include "paging.h"
+#include "exceptions.h"
+#include "lib.h"
+#include "sched.h"
+
+//compressed pages are stored as a stream of tokens over 32-bit words. a token
+//byte with the high bit set is a run: the next word repeated (token & 0x7F) + 1
+//times. otherwise it is (token + 1) literal words that follow. heap pages of
+//idle programs are mostly runs of zeros so they shrink to a few bytes
+#define TOKEN_RUN 0x80
+#define TOKEN_MAX 128
+#define WORDS_PER_PAGE (FRAME_SIZE / 4)
+#define SWAP_FREE 0
+#define SWAP_USED 1
+#define CHUNKS_FULL 0xFF
+#define SWAP_SWEEP_PAGES (2 * USER_PAGES) 	//program region then heap of each process
+
+typedef struct swap_entry_t {
+	uint32_t frame; 				//pool frame holding the compressed data
+	uint16_t length; 				//compressed length in bytes
+	uint8_t first_chunk;
+	uint8_t num_chunks;
+	uint32_t flags;
+} swap_entry_t;
+
+static swap_entry_t swap_entries[MAX_SWAP_ENTRIES];
+static uint32_t swap_frames[MAX_SWAP_FRAMES]; 		//pool frames, NO_FRAME if unused
+static uint8_t swap_chunk_map[MAX_SWAP_FRAMES]; 	//bit n set if chunk n of the frame is used
+static uint8_t swap_buf[SWAP_MAX_COMPRESSED + SWAP_MAX_COMPRESSED / TOKEN_MAX + 1];
+static swap_stats_t swap_stats;
+
+//clock hand for the second-chance (approximate LRU) sweep
+static uint32_t clock_pid;
+static uint32_t clock_index;
+//everything above, taken after sched_lock and before the frame pool's lock
+static spinlock_t swap_lock = SPIN_LOCK_INIT("swap");
+
+/*
+* uint32_t compress_page(const uint32_t* page, uint8_t* out)
+*   Inputs: page = 4KB page to compress, out = output buffer
+*   Return Value: compressed length, or 0 if it would exceed SWAP_MAX_COMPRESSED
+*	Function: run length encodes the page one word at a time
+*/
+static uint32_t compress_page(const uint32_t* page, uint8_t* out){
+	uint32_t i = 0, len = 0, run, lit;
+
+	while(i < WORDS_PER_PAGE){
+		//count how many times this word repeats
+		for(run = 1; i + run < WORDS_PER_PAGE && run < TOKEN_MAX && page[i + run] == page[i]; run++);
+		if(run > 1){
+			if(len + 1 + 4 > SWAP_MAX_COMPRESSED)
+				return 0;
+			out[len++] = TOKEN_RUN | (run - 1);
+			memcpy(&out[len], &page[i], 4);
+			len += 4;
+			i += run;
+			continue;
+		}
+		//collect literals until the next run of at least 2 words starts
+		for(lit = 1; i + lit < WORDS_PER_PAGE && lit < TOKEN_MAX; lit++){
+			if(i + lit + 1 < WORDS_PER_PAGE && page[i + lit] == page[i + lit + 1])
+				break;
+		}
+		if(len + 1 + lit * 4 > SWAP_MAX_COMPRESSED)
+			return 0;
+		out[len++] = lit - 1;
+		memcpy(&out[len], &page[i], lit * 4);
+		len += lit * 4;
+		i += lit;
+	}
+	return len;
+}
+
+/*
+* void decompress_page(const uint8_t* in, uint32_t len, uint32_t* page)
+*   Inputs: in = compressed data, len = compressed length, page = 4KB output page
+*   Return Value: none
+*	Function: expands the token stream written by compress_page
+*/
+static void decompress_page(const uint8_t* in, uint32_t len, uint32_t* page){
+	uint32_t pos = 0, i = 0, count, word;
+
+	while(pos < len && i < WORDS_PER_PAGE){
+		count = (in[pos] & ~TOKEN_RUN) + 1;
+		if(in[pos++] & TOKEN_RUN){
+			memcpy(&word, &in[pos], 4);
+			pos += 4;
+			memset_dword(&page[i], word, count);
+		}
+		else{
+			memcpy(&page[i], &in[pos], count * 4);
+			pos += count * 4;
+		}
+		i += count;
+	}
+}
+
+/*
+* int32_t find_chunks(uint32_t num_chunks, uint32_t victim, uint32_t* first)
+*   Inputs: num_chunks = chunks needed, victim = frame being evicted
+*		first = set to the first chunk of the run
+*   Return Value: pool frame index, or -1 if the pool is full
+*	Function: finds num_chunks contiguous free chunks in a pool frame. when no
+*		frame has room the victim frame itself joins the pool, so storing a
+*		page never needs a new frame
+*/
+static int32_t find_chunks(uint32_t num_chunks, uint32_t victim, uint32_t* first){
+	uint32_t mask = (1 << num_chunks) - 1;
+	int32_t f, unused = -1;
+	uint32_t c;
+
+	for(f = 0; f < MAX_SWAP_FRAMES; f++){
+		if(swap_frames[f] == NO_FRAME){
+			if(unused == -1)
+				unused = f;
+			continue;
+		}
+		if(swap_chunk_map[f] == CHUNKS_FULL)
+			continue;
+		for(c = 0; c + num_chunks <= SWAP_CHUNKS_PER_FRAME; c++){
+			if((swap_chunk_map[f] & (mask << c)) == 0){
+				*first = c;
+				return f;
+			}
+		}
+	}
+	if(unused == -1)
+		return -1;
+	swap_frames[unused] = victim;
+	swap_chunk_map[unused] = 0;
+	swap_stats.pool_frames++;
+	*first = 0;
+	return unused;
+}
+
+/*
+* int32_t swap_out(uint32_t* pte)
+*   Inputs: pte = page table entry of a present, cold user page
+*   Return Value: 1 if a frame was freed, 0 otherwise
+*	Function: compresses the page into the pool and replaces the pte with a
+*		not present entry that remembers the swap slot. swap_lock is held
+*/
+static int32_t swap_out(uint32_t* pte){
+	uint32_t frame = *pte & ~(FRAME_SIZE - 1);
+	uint32_t len, num_chunks, first, i;
+	int32_t f;
+
+	len = compress_page((uint32_t*) frame, swap_buf);
+	if(len == 0){
+		swap_stats.rejected++;
+		return 0;
+	}
+	for(i = 0; i < MAX_SWAP_ENTRIES; i++){
+		if(swap_entries[i].flags == SWAP_FREE)
+			break;
+	}
+	if(i == MAX_SWAP_ENTRIES)
+		return 0;
+
+	num_chunks = (len + SWAP_CHUNK_SIZE - 1) / SWAP_CHUNK_SIZE;
+	f = find_chunks(num_chunks, frame, &first);
+	if(f == -1)
+		return 0;
+
+	memcpy((uint8_t*) swap_frames[f] + first * SWAP_CHUNK_SIZE, swap_buf, len);
+	swap_chunk_map[f] |= ((1 << num_chunks) - 1) << first;
+	swap_entries[i].frame = f;
+	swap_entries[i].first_chunk = first;
+	swap_entries[i].num_chunks = num_chunks;
+	swap_entries[i].length = len;
+	swap_entries[i].flags = SWAP_USED;
+	*pte = (i << SWAP_INDEX_SHIFT) | PAGE_SWAPPED;
+
+	swap_stats.swap_outs++;
+	swap_stats.stored_pages++;
+	swap_stats.stored_bytes += len;
+
+	//the victim frame is either free now or became a pool frame
+	if(swap_frames[f] == frame)
+		return 0;
+	free_frame(frame);
+	return 1;
+}
+
+/*
+* void swap_release_entry(uint32_t i)
+*   Inputs: i = swap entry index
+*   Return Value: none
+*	Function: frees the chunks of the entry, and the pool frame once it is
+*		empty. swap_lock is held
+*/
+static void swap_release_entry(uint32_t i){
+	swap_entry_t* e = &swap_entries[i];
+	swap_chunk_map[e->frame] &= ~(((1 << e->num_chunks) - 1) << e->first_chunk);
+	if(swap_chunk_map[e->frame] == 0){
+		free_frame(swap_frames[e->frame]);
+		swap_frames[e->frame] = NO_FRAME;
+		swap_stats.pool_frames--;
+	}
+	swap_stats.stored_pages--;
+	swap_stats.stored_bytes -= e->length;
+	e->flags = SWAP_FREE;
+}
+
+/*
+* int32_t sweep_page()
+*   Inputs: none
+*   Return Value: 1 if a frame was freed, 0 otherwise
+*	Function: moves the clock hand one page on. a page touched since the
+*		last sweep gets a second chance (its accessed bit is cleared), an
+*		untouched one is cold and gets compressed. sched_lock and swap_lock
+*		are held, so the process can't be switched to meanwhile
+*/
+static int32_t sweep_page(){
+	pcb_t* task;
+	uint32_t* table;
+	uint32_t* pte;
+	uint32_t heap;
+
+	if(clock_index >= SWAP_SWEEP_PAGES){
+		clock_index = 0;
+		clock_pid = (clock_pid + 1) % MAX_PROCESSES;
+	}
+	task = process_table[clock_pid];
+	//processes running on any cpu are skipped
+	if(task == NULL || task_on_cpu(task)){
+		clock_index = SWAP_SWEEP_PAGES;
+		return 0;
+	}
+	//first the program region, then the heap. a heap mapped as a large
+	//page is skipped, the cpu isn't updating its 4KB entries
+	heap = (clock_index >= USER_PAGES);
+	table = heap ? task->heap_table : task->user_table;
+	pte = &table[clock_index++ % USER_PAGES];
+	if(table == NULL || (heap && (task->large_regions & LARGE_HEAP)) ||
+			!(*pte & PAGE_PRESENT_BIT) || !(*pte & PAGE_RW))
+		return 0;
+	if(*pte & PAGE_ACCESSED){
+		*pte &= ~PAGE_ACCESSED;
+		return 0;
+	}
+	return swap_out(pte);
+}
+
+/*
+* int32_t swap_reclaim(uint32_t target)
+*   Inputs: target = number of frames to try to free
+*   Return Value: number of frames freed
+*	Function: sweeps the private program pages and heap pages of every process
+*		that isn't running with a clock hand. shared read only text is never
+*		swapped. the locks are let go between pages so the other cpus can
+*		switch processes meanwhile
+*/
+int32_t swap_reclaim(uint32_t target){
+	uint32_t freed = 0, scanned = 0;
+	uint32_t max_scan = 2 * MAX_PROCESSES * SWAP_SWEEP_PAGES;
+	uint32_t flags;
+
+	while(freed < target && scanned++ < max_scan){
+		spin_lock_irqsave(&sched_lock, flags);
+		spin_lock(&swap_lock);
+		freed += sweep_page();
+		spin_unlock(&swap_lock);
+		spin_unlock_irqrestore(&sched_lock, flags);
+	}
+	if(scanned > 0)
+		reset_cr3();
+	return freed;
+}
+
+/*
+* int32_t swap_in(uint32_t* table, uint32_t index)
+*   Inputs: table = page table of the faulting address, index = entry in the table
+*   Return Value: 0 if the page was brought back, -1 if it wasn't swapped out
+*	Function: decompresses a swapped page into a new frame and maps it again,
+*		called from the page fault handler
+*/
+int32_t swap_in(uint32_t* table, uint32_t index){
+	uint32_t i, frame, flags;
+	swap_entry_t* e;
+
+	if(table == NULL || !(table[index] & PAGE_SWAPPED))
+		return -1;
+	//may reclaim, which takes swap_lock itself
+	frame = alloc_frame();
+	if(frame == NO_FRAME)
+		return -1;
+
+	spin_lock_irqsave(&swap_lock, flags);
+	i = table[index] >> SWAP_INDEX_SHIFT;
+	if(!(table[index] & PAGE_SWAPPED) || i >= MAX_SWAP_ENTRIES || swap_entries[i].flags == SWAP_FREE){
+		spin_unlock_irqrestore(&swap_lock, flags);
+		free_frame(frame);
+		return -1;
+	}
+	e = &swap_entries[i];
+	decompress_page((uint8_t*) swap_frames[e->frame] + e->first_chunk * SWAP_CHUNK_SIZE, e->length, (uint32_t*) frame);
+	swap_release_entry(i);
+
+	table[index] = frame | USERREADPRESENT;
+	swap_stats.swap_ins++;
+	spin_unlock_irqrestore(&swap_lock, flags);
+	reset_cr3();
+	return 0;
+}
+
+/*
+* void swap_discard(uint32_t pte)
+*   Inputs: pte = swapped out page table entry that is being unmapped
+*   Return Value: none
+*	Function: drops the compressed copy of a page that is freed without being read
+*/
+void swap_discard(uint32_t pte){
+	uint32_t i = pte >> SWAP_INDEX_SHIFT;
+	uint32_t flags;
+
+	if(!(pte & PAGE_SWAPPED) || i >= MAX_SWAP_ENTRIES)
+		return;
+	spin_lock_irqsave(&swap_lock, flags);
+	if(swap_entries[i].flags != SWAP_FREE)
+		swap_release_entry(i);
+	spin_unlock_irqrestore(&swap_lock, flags);
+}
+
+/*
+* void get_swap_stats(swap_stats_t* stats)
+*   Inputs: stats = struct to fill in
+*   Return Value: none
+*	Function: copies out the swap counters
+*/
+void get_swap_stats(swap_stats_t* stats){
+	uint32_t flags;
+
+	if(stats == NULL)
+		return;
+	spin_lock_irqsave(&swap_lock, flags);
+	*stats = swap_stats;
+	spin_unlock_irqrestore(&swap_lock, flags);
+}
@@ -0,0 +1,28 @@
+#ifndef SWAP_H
+#define SWAP_H
+
+#include "types.h"
+
+//compressed in-RAM swap for cold 4KB user pages
+#define MAX_SWAP_ENTRIES 1024
+#define MAX_SWAP_FRAMES 256 					//pool frames holding compressed pages
+#define SWAP_CHUNK_SIZE 512 					//pool frames are split into 8 chunks
+#define SWAP_CHUNKS_PER_FRAME 8
+#define SWAP_MAX_COMPRESSED 3072 				//pages that don't compress below this stay resident
+#define SWAP_BATCH 8 							//pages reclaimed per call when frames run out
+
+typedef struct swap_stats_t {
+	uint32_t swap_outs; 				//pages compressed into the pool
+	uint32_t swap_ins; 					//pages decompressed on a page fault
+	uint32_t rejected; 					//cold pages that didn't compress well enough
+	uint32_t stored_pages; 				//pages currently in the pool
+	uint32_t stored_bytes; 				//compressed bytes currently in the pool
+	uint32_t pool_frames; 				//frames currently used by the pool
+} swap_stats_t;
+
+int32_t swap_reclaim(uint32_t target);
+int32_t swap_in(uint32_t* table, uint32_t index);
+void swap_discard(uint32_t pte);
+void get_swap_stats(swap_stats_t* stats);
+
+#endif /* SWAP_H */
@@ -0,0 +1,57 @@
+#include "sysenter.h"
+#include "lib.h"
+#include "timer.h"
+#include "x86_desc.h"
+
+//int $0x80 stays for old programs and for the signal trampoline, the user
+//library switches to sysenter when kdata says the kernel set it up
+
+uint32_t sysenter_ok;
+
+/*
+* void sysenter_init()
+*   Inputs: none
+*   Return Value: none
+*	Function: checks cpuid for sysenter and sets up cpu 0. called before
+*		paging_init, which tells user programs through the kdata page
+*/
+void sysenter_init(){
+	uint32_t regs[4];
+
+	cpuid(CPUID_FEATURES, regs);
+	if(!(regs[3] & CPUID_SEP))
+		return;
+	if(CPUID_FAMILY(regs[0]) == SEP_BROKEN_FAMILY && CPUID_MODEL(regs[0]) < SEP_BROKEN_MODEL &&
+			CPUID_STEPPING(regs[0]) < SEP_BROKEN_STEPPING)
+		return;
+	sysenter_ok = 1;
+	sysenter_init_cpu();
+}
+
+/*
+* void sysenter_init_cpu()
+*   Inputs: none
+*   Return Value: none
+*	Function: points the calling cpu's sysenter at sysenter_entry. every cpu
+*		does this once, set_kernel_stack fills in the stack before the first
+*		process runs on it
+*/
+void sysenter_init_cpu(){
+	if(!sysenter_ok)
+		return;
+	wrmsr(MSR_SYSENTER_CS, KERNEL_CS);
+	wrmsr(MSR_SYSENTER_EIP, (uint32_t)sysenter_entry);
+}
+
+/*
+* void sysenter_set_stack(uint32_t esp0)
+*   Inputs: esp0 = top of the kernel stack of the process about to run
+*   Return Value: none
+*	Function: sysenter switches to the same stack as the TSS' esp0. loaded
+*		straight into esp, so even a debug trap on the first instruction of
+*		sysenter_entry lands on the right stack
+*/
+void sysenter_set_stack(uint32_t esp0){
+	if(sysenter_ok)
+		wrmsr(MSR_SYSENTER_ESP, esp0);
+}
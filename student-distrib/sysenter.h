@@ -0,0 +1,40 @@
+#ifndef SYSENTER_H
+#define SYSENTER_H
+
+//fast system calls. user code puts the call number in eax and the arguments
+//in ebx, ecx and edx like for int $0x80, plus where to return in esi and its
+//esp in edi, then runs sysenter. ecx and edx don't survive the call
+#define MSR_SYSENTER_CS 0x174 				//sysexit uses this + 16 and + 24 for user cs and ss
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
+
+#define CPUID_SEP (1 << 11) 				//cpuid leaf 1 edx
+#define CPUID_FAMILY(eax) (((eax) >> 8) & 0xF)
+#define CPUID_MODEL(eax) (((eax) >> 4) & 0xF)
+#define CPUID_STEPPING(eax) ((eax) & 0xF)
+#define SEP_BROKEN_FAMILY 6 				//the Pentium Pro reports SEP but has no sysenter
+#define SEP_BROKEN_MODEL 3
+#define SEP_BROKEN_STEPPING 3
+
+//vector field of the regs_t sysenter_entry builds, signal_return leaves
+//through sysexit for it. anything that needs all registers back sets it
+//to SYSTEM_CALL_IDT so the iret restores them
+#define SYSENTER_VECTOR 0x81
+#define SYSENTER_LEN 2 						//bytes of the sysenter instruction
+#define EFLAGS_IF 0x200
+#define EFLAGS_TF 0x100
+
+#ifndef ASM
+
+#include "types.h"
+
+extern uint32_t sysenter_ok;
+
+void sysenter_init();
+void sysenter_init_cpu();
+void sysenter_set_stack(uint32_t esp0);
+void sysenter_entry();
+
+#endif /* ASM */
+
+#endif /* SYSENTER_H */
@@ -0,0 +1,613 @@
+#include "timer.h"
+#include "i8259.h"
+#include "kdata.h"
+#include "lapic.h"
+#include "lib.h"
+#include "rtc.h"
+#include "smp.h"
+#include "spinlock.h"
+
+//the clock is the TSC, calibrated once against PIT channel 2. channel 0 is
+//then used one-shot: every interrupt arms it for whichever comes first, the
+//next scheduler tick or the next kernel timer, so timers aren't rounded up to
+//the 10ms tick. while the cpu idles the tick is stopped and only timers arm
+//it. without a TSC the PIT stays periodic and the clock and the timers only
+//move in whole ticks. once the irqs come through the IOAPIC the local APIC
+//timer of cpu 0 takes over from channel 0, it is armed the same way. the
+//wheel and the event state are under timer_lock, the clock base is read by
+//every cpu without it, through clock_seq
+
+uint32_t tsc_khz;
+
+static uint32_t clock_mult; 			//ns per cycle << CLOCK_SHIFT
+static uint64_t base_tsc; 				//cycle count at base_ns
+static uint64_t base_ns;
+static volatile uint32_t clock_seq; 	//odd while base_tsc and base_ns change
+static uint64_t realtime_offset; 		//ns since 1970 at clock_ns 0, from the cmos time at boot
+
+static uint64_t next_tick; 				//clock_ns of the next scheduler tick
+static uint64_t next_event; 			//clock_ns the tick timer is armed for, WHEEL_NEVER if it isn't
+static uint32_t tick_stopped; 			//cpu is idle, no scheduler ticks needed
+static uint32_t lapic_mult; 			//local APIC timer counts per ns << LAPIC_NS_SHIFT, 0 on the PIT
+static uint32_t tick_count; 			//scheduler ticks since boot, for the kernel data page
+
+static ktimer_t* wheel[WHEEL_LEVELS][WHEEL_SIZE];
+static uint64_t wheel_clk; 				//next level 0 slot to run, in wheel units
+static uint32_t wheel_pending;
+static ktimer_t* volatile running_timer; 	//fn cpu 0 is running without the lock
+static spinlock_t timer_lock = SPIN_LOCK_INIT("timer");
+
+/*
+* uint64_t cycles_to_ns(uint64_t cycles)
+*   Inputs: cycles = TSC cycles
+*   Return Value: the same time in ns
+*	Function: (cycles * clock_mult) >> CLOCK_SHIFT, done in two halves so it
+*		doesn't overflow when the tick was stopped for a long idle stretch
+*/
+uint64_t cycles_to_ns(uint64_t cycles){
+	uint64_t high = (cycles >> 32) * clock_mult;
+	uint64_t low = (cycles & 0xFFFFFFFFULL) * clock_mult;
+	return (high << (32 - CLOCK_SHIFT)) + (low >> CLOCK_SHIFT);
+}
+
+/*
+* uint32_t tsc_calibrate()
+*   Inputs: none
+*   Return Value: TSC frequency in kHz, 0 if there is no usable TSC
+*	Function: counts TSC cycles while PIT channel 2 counts down CALIBRATE_MS
+*/
+static uint32_t tsc_calibrate(){
+	uint32_t regs[4];
+	uint32_t latch = PIT_BASE_HZ / (1000 / CALIBRATE_MS);
+	uint64_t start, cycles;
+
+	cpuid(CPUID_FEATURES, regs);
+	if(!(regs[3] & CPUID_TSC))
+		return 0;
+
+	//gate channel 2 on with the speaker off, its output goes high at zero
+	outb((inb(PIT_GATE_PORT) & ~PIT_SPEAKER) | PIT_GATE, PIT_GATE_PORT);
+	outb(PIT_CH2_ONESHOT, PIT_COMMAND);
+	outb(latch & PIT_BYTE_MASK, PIT_CHANNEL2);
+	outb((latch >> 8) & PIT_BYTE_MASK, PIT_CHANNEL2);
+	start = rdtsc();
+	while(!(inb(PIT_GATE_PORT) & PIT_CH2_OUT))
+		;
+	cycles = rdtsc() - start;
+
+	div64(&cycles, CALIBRATE_MS);
+	if(cycles < TSC_MIN_KHZ || (cycles >> 32) != 0)
+		return 0;
+	return (uint32_t)cycles;
+}
+
+/*
+* void pit_program(uint64_t now, uint64_t when)
+*   Inputs: now = current clock_ns
+*		when = clock_ns the next interrupt should come at
+*   Return Value: none
+*	Function: arms PIT channel 0 one-shot. the counter is 16 bits so anything
+*		past PIT_MAX_NS gets an early interrupt that just arms it again. the
+*		count is rounded up, an interrupt that comes too early costs a second one
+*/
+static void pit_program(uint64_t now, uint64_t when){
+	uint64_t delta = (when > now) ? when - now : 0;
+	uint32_t count;
+
+	if(delta > PIT_MAX_NS)
+		delta = PIT_MAX_NS;
+	count = (uint32_t)((delta * PIT_NS_MULT) >> PIT_NS_SHIFT) + 1;
+	if(count < PIT_MIN_COUNT)
+		count = PIT_MIN_COUNT;
+	next_event = now + delta;
+	outb(count & PIT_BYTE_MASK, PIT_CHANNEL0);
+	outb((count >> 8) & PIT_BYTE_MASK, PIT_CHANNEL0);
+}
+
+/*
+* void event_program(uint64_t now, uint64_t when)
+*   Inputs: now = current clock_ns
+*		when = clock_ns the next interrupt should come at
+*   Return Value: none
+*	Function: arms whichever timer drives the tick, one-shot
+*/
+static void event_program(uint64_t now, uint64_t when){
+	uint64_t delta = (when > now) ? when - now : 0;
+
+	if(lapic_mult == 0){
+		pit_program(now, when);
+		return;
+	}
+	if(delta > LAPIC_MAX_NS)
+		delta = LAPIC_MAX_NS;
+	next_event = now + delta;
+	lapic_timer_arm((uint32_t)((delta * lapic_mult) >> LAPIC_NS_SHIFT) + 1);
+}
+
+/*
+* void clock_set(uint64_t ns, uint64_t tsc)
+*   Inputs: ns = monotonic clock at tsc, tsc = cycle count
+*   Return Value: none
+*	Function: moves the clock base. readers on other cpus retry while seq is
+*		odd, so they never mix an old base_ns with a new base_tsc. x86 keeps
+*		stores in order, the compiler has to be told
+*/
+static void clock_set(uint64_t ns, uint64_t tsc){
+	uint32_t flags;
+
+	cli_and_save(flags); 	//a reader on this cpu would spin forever
+	clock_seq++;
+	asm volatile("" : : : "memory");
+	base_ns = ns;
+	base_tsc = tsc;
+	asm volatile("" : : : "memory");
+	clock_seq++;
+	restore_flags(flags);
+}
+
+/*
+* void clock_publish()
+*   Inputs: none
+*   Return Value: none
+*	Function: copies the clock to the kernel data page, where processes read
+*		it without a system call
+*/
+static void clock_publish(){
+	uint64_t sec = realtime_offset + base_ns;
+
+	div64(&sec, NSEC_PER_SEC);
+	kdata_clock(tick_count, (uint32_t)sec, base_tsc, base_ns, clock_mult);
+}
+
+/*
+* void realtime_init()
+*   Inputs: none
+*   Return Value: none
+*	Function: reads the time of day once the monotonic clock runs and keeps
+*		how far apart the two are
+*/
+static void realtime_init(){
+	uint32_t boot_time = rtc_read_time();
+	realtime_offset = (uint64_t)boot_time * NSEC_PER_SEC - clock_ns();
+}
+
+/*
+* void timer_init()
+*   Inputs: none
+*   Return Value: none
+*	Function: calibrates the TSC, reads the time of day and starts PIT channel
+*		0, one-shot if the TSC works. the caller unmasks IRQ0
+*/
+void timer_init(){
+	uint64_t mult = (uint64_t)NSEC_PER_MSEC << CLOCK_SHIFT;
+	uint32_t divisor = PIT_BASE_HZ / PIT_HZ;
+
+	tsc_khz = tsc_calibrate();
+	clock_set(0, 0);
+	wheel_clk = 0;
+	wheel_pending = 0;
+	next_tick = TICK_NS;
+	tick_stopped = 0;
+	tick_count = 0;
+
+	if(tsc_khz == 0){
+		outb(PIT_SQUARE_WAVE, PIT_COMMAND);
+		outb(divisor & PIT_BYTE_MASK, PIT_CHANNEL0);
+		outb((divisor >> 8) & PIT_BYTE_MASK, PIT_CHANNEL0);
+		realtime_init();
+		clock_publish();
+		return;
+	}
+	div64(&mult, tsc_khz);
+	clock_mult = (uint32_t)mult;
+	clock_set(0, rdtsc());
+	realtime_init();
+	clock_publish();
+	outb(PIT_ONESHOT, PIT_COMMAND);
+	pit_program(0, next_tick);
+}
+
+
+/*
+* uint64_t clock_ns()
+*   Inputs: none
+*   Return Value: ns since boot
+*	Function: the monotonic clock, read again if cpu 0 moved its base
+*		meanwhile
+*/
+uint64_t clock_ns(){
+	uint64_t ns;
+	uint32_t seq;
+
+	do{
+		seq = clock_seq;
+		asm volatile("" : : : "memory");
+		if(tsc_khz == 0)
+			ns = base_ns;
+		else
+			ns = base_ns + cycles_to_ns(rdtsc() - base_tsc);
+		asm volatile("" : : : "memory");
+	}while((seq & 1) || seq != clock_seq);
+	return ns;
+}
+
+/*
+* void clock_realtime(timespec_t* ts)
+*   Inputs: ts = gets the time since 1970
+*   Return Value: none
+*	Function: the time of day, the monotonic clock moved by the offset taken
+*		at boot so both advance together down to the ns
+*/
+void clock_realtime(timespec_t* ts){
+	ns_to_timespec(clock_ns() + realtime_offset, ts);
+}
+
+/*
+* void ns_to_timespec(uint64_t ns, timespec_t* ts)
+*   Inputs: ns = time in ns
+*		ts = gets it in seconds and ns
+*   Return Value: none
+*	Function: splits a time in ns
+*/
+void ns_to_timespec(uint64_t ns, timespec_t* ts){
+	ts->nsec = div64(&ns, NSEC_PER_SEC);
+	ts->sec = (uint32_t)ns;
+}
+
+/*
+* void wheel_insert(ktimer_t* timer)
+*   Inputs: timer = timer to queue
+*   Return Value: none
+*	Function: puts the timer in the level whose range covers its distance from
+*		wheel_clk. a slot above level 0 is moved down a level when the level
+*		below wraps around to it, which is never after the timers in it expire
+*/
+static void wheel_insert(ktimer_t* timer){
+	//a timer may only run once its slot is completely in the past
+	uint64_t when = WHEEL_ROUND(timer->expires) >> WHEEL_SHIFT;
+	uint64_t delta;
+	uint32_t level, shift;
+	ktimer_t** slot;
+
+	if(when < wheel_clk)
+		when = wheel_clk;
+	delta = when - wheel_clk;
+	for(level = 0; level < WHEEL_LEVELS - 1; level++){
+		if(delta < (1ULL << (WHEEL_BITS * (level + 1))))
+			break;
+	}
+	shift = WHEEL_BITS * level;
+	if(delta >> (shift + WHEEL_BITS))
+		when = wheel_clk + (1ULL << (shift + WHEEL_BITS)) - 1; 	//too far out
+	slot = &wheel[level][(when >> shift) & WHEEL_MASK];
+
+	timer->next = *slot;
+	if(*slot != NULL)
+		(*slot)->pprev = &timer->next;
+	timer->pprev = slot;
+	*slot = timer;
+}
+
+/*
+* void wheel_unlink(ktimer_t* timer)
+*   Inputs: timer = pending timer
+*   Return Value: none
+*	Function: takes the timer out of its slot
+*/
+static void wheel_unlink(ktimer_t* timer){
+	*timer->pprev = timer->next;
+	if(timer->next != NULL)
+		timer->next->pprev = timer->pprev;
+	timer->next = NULL;
+	timer->pprev = NULL;
+}
+
+/*
+* uint32_t wheel_cascade(uint32_t level)
+*   Inputs: level = level whose current slot is due to move down
+*   Return Value: index of that slot, 0 means the level wrapped as well
+*	Function: requeues the timers of the slot, they land in lower levels now
+*/
+static uint32_t wheel_cascade(uint32_t level){
+	uint32_t index = (wheel_clk >> (WHEEL_BITS * level)) & WHEEL_MASK;
+	ktimer_t* timer = wheel[level][index];
+	ktimer_t* next;
+
+	wheel[level][index] = NULL;
+	while(timer != NULL){
+		next = timer->next;
+		wheel_insert(timer);
+		timer = next;
+	}
+	return index;
+}
+
+/*
+* void wheel_run(uint64_t now)
+*   Inputs: now = current clock_ns
+*   Return Value: none
+*	Function: runs every level 0 slot up to now, cascading the upper levels as
+*		level 0 wraps. an empty wheel just skips ahead. timer_lock is held,
+*		the fns run without it so they can queue timers and take other locks
+*/
+static void wheel_run(uint64_t now){
+	uint64_t until = now >> WHEEL_SHIFT;
+	uint32_t index, level;
+	ktimer_t* timer;
+	ktimer_t* expired;
+
+	while(wheel_clk <= until){
+		if(wheel_pending == 0){
+			wheel_clk = until; 	//nothing to cascade or run on the way
+			break;
+		}
+		index = wheel_clk & WHEEL_MASK;
+		for(level = 1; index == 0 && level < WHEEL_LEVELS; level++){
+			if(wheel_cascade(level) != 0)
+				break;
+		}
+		//take the slot's list first, a timer added again by its fn mustn't
+		//land in the slot being run
+		expired = wheel[0][index];
+		wheel[0][index] = NULL;
+		if(expired != NULL)
+			expired->pprev = &expired;
+		wheel_clk++;
+		while((timer = expired) != NULL){
+			wheel_unlink(timer);
+			wheel_pending--;
+			running_timer = timer;
+			spin_unlock(&timer_lock);
+			timer->fn(timer);
+			spin_lock(&timer_lock);
+			running_timer = NULL;
+		}
+	}
+}
+
+/*
+* uint64_t wheel_next()
+*   Inputs: none
+*   Return Value: clock_ns at which the wheel has something to do next
+*	Function: for level 0 that's the first non-empty slot, for the upper levels
+*		the time their first non-empty slot cascades, which is no later than
+*		when its timers expire
+*/
+static uint64_t wheel_next(){
+	uint64_t next = WHEEL_NEVER, when, base;
+	uint32_t level, k, shift;
+
+	if(wheel_pending == 0)
+		return WHEEL_NEVER;
+	for(k = 0; k < WHEEL_SIZE; k++){
+		if(wheel[0][(wheel_clk + k) & WHEEL_MASK] != NULL)
+			return (wheel_clk + k) << WHEEL_SHIFT;
+	}
+	for(level = 1; level < WHEEL_LEVELS; level++){
+		shift = WHEEL_BITS * level;
+		base = wheel_clk >> shift;
+		for(k = 1; k <= WHEEL_SIZE; k++){
+			if(wheel[level][(base + k) & WHEEL_MASK] != NULL){
+				when = ((base + k) << shift) << WHEEL_SHIFT;
+				if(when < next)
+					next = when;
+				break;
+			}
+		}
+	}
+	return next;
+}
+
+/*
+* void timer_rearm(uint64_t now)
+*   Inputs: now = current clock_ns
+*   Return Value: none
+*	Function: arms the PIT for the next scheduler tick or kernel timer, the
+*		tick doesn't count while it is stopped
+*/
+static void timer_rearm(uint64_t now){
+	uint64_t when = wheel_next();
+
+	if(!tick_stopped && next_tick < when)
+		when = next_tick;
+	if(when == WHEEL_NEVER){
+		//a new control word stops the count, mode 4 only fires once a count is loaded
+		if(lapic_mult != 0)
+			lapic_timer_arm(0);
+		else
+			outb(PIT_ONESHOT, PIT_COMMAND);
+		next_event = WHEEL_NEVER;
+		return;
+	}
+	event_program(now, when);
+}
+
+/*
+* uint32_t timer_interrupt()
+*   Inputs: none
+*   Return Value: number of scheduler ticks that are due
+*	Function: called by the PIT handler with interrupts off. runs the expired
+*		kernel timers and arms the PIT for the next event
+*/
+uint32_t timer_interrupt(){
+	uint32_t ticks = 0;
+	uint64_t now, tsc, late;
+
+	spin_lock(&timer_lock);
+	if(tsc_khz == 0){
+		clock_set(base_ns + TICK_NS, 0);
+		tick_count++;
+		clock_publish();
+		wheel_run(base_ns);
+		spin_unlock(&timer_lock);
+		return 1;
+	}
+
+	//move the base up so the cycle delta in clock_ns stays small
+	tsc = rdtsc();
+	now = base_ns + cycles_to_ns(tsc - base_tsc);
+	clock_set(now, tsc);
+
+	//after a stopped tick many can be due at once
+	if(now >= next_tick){
+		late = now - next_tick;
+		div64(&late, TICK_NS);
+		ticks = (uint32_t)late + 1;
+		next_tick += (uint64_t)ticks * TICK_NS;
+		tick_count += ticks;
+	}
+	clock_publish();
+	wheel_run(now);
+	timer_rearm(now);
+	spin_unlock(&timer_lock);
+	return ticks;
+}
+
+/*
+* void timer_stop_tick()
+*   Inputs: none
+*   Return Value: none
+*	Function: called with interrupts off before the cpu halts with nothing to
+*		run. the PIT is only armed for kernel timers, not at all if there are
+*		none, so an idle cpu sleeps until a timer or a device needs it
+*/
+void timer_stop_tick(){
+	if(tsc_khz == 0)
+		return;
+	spin_lock(&timer_lock);
+	tick_stopped = 1;
+	timer_rearm(clock_ns());
+	spin_unlock(&timer_lock);
+}
+
+/*
+* void timer_restart_tick()
+*   Inputs: none
+*   Return Value: none
+*	Function: called with interrupts off when the cpu leaves idle. ticks that
+*		were skipped are due already, so the PIT fires right away and the
+*		handler accounts for all of them at once
+*/
+void timer_restart_tick(){
+	if(tsc_khz == 0)
+		return;
+	spin_lock(&timer_lock);
+	tick_stopped = 0;
+	timer_rearm(clock_ns());
+	spin_unlock(&timer_lock);
+}
+
+/*
+* void timer_use_lapic()
+*   Inputs: none
+*   Return Value: none
+*	Function: called on cpu 0 once the irqs come through the IOAPIC. moves
+*		the tick and the kernel timers from PIT channel 0 to the local APIC
+*		timer, which is armed and ended without port I/O. the PIT stays if
+*		there is no TSC to measure the APIC timer against
+*/
+void timer_use_lapic(){
+	uint64_t mult;
+	uint32_t flags;
+
+	mult = (uint64_t)lapic_timer_calibrate() << LAPIC_NS_SHIFT;
+	div64(&mult, NSEC_PER_MSEC);
+	if(mult == 0 || (mult >> 32) != 0)
+		return;
+
+	spin_lock_irqsave(&timer_lock, flags);
+	disable_irq(PIT_IRQ);
+	outb(PIT_ONESHOT, PIT_COMMAND); 	//stops the count
+	lapic_mult = (uint32_t)mult;
+	timer_rearm(clock_ns());
+	spin_unlock_irqrestore(&timer_lock, flags);
+}
+
+/*
+* void timer_ipi()
+*   Inputs: none
+*   Return Value: none
+*	Function: called on cpu 0 when another cpu queued a kernel timer that
+*		comes before its APIC timer is armed for
+*/
+void timer_ipi(){
+	if(lapic_mult == 0)
+		return;
+	spin_lock(&timer_lock);
+	timer_rearm(clock_ns());
+	spin_unlock(&timer_lock);
+}
+
+/*
+* void timer_setup(ktimer_t* timer, void (*fn)(ktimer_t* timer), void* data)
+*   Inputs: timer = timer to set up
+*		fn = called when it expires, in the PIT interrupt with interrupts off
+*		data = for fn
+*   Return Value: none
+*	Function: initializes a timer that isn't pending
+*/
+void timer_setup(ktimer_t* timer, void (*fn)(ktimer_t* timer), void* data){
+	timer->fn = fn;
+	timer->data = data;
+	timer->next = NULL;
+	timer->pprev = NULL;
+}
+
+/*
+* void timer_add(ktimer_t* timer, uint64_t expires)
+*   Inputs: timer = timer from timer_setup
+*		expires = clock_ns to run it at
+*   Return Value: none
+*	Function: queues the timer, or moves it if it was pending already. the PIT
+*		is armed again if the timer comes before the next interrupt
+*/
+void timer_add(ktimer_t* timer, uint64_t expires){
+	uint32_t flags;
+	uint64_t now;
+
+	spin_lock_irqsave(&timer_lock, flags);
+	if(timer_pending(timer)){
+		wheel_unlink(timer);
+		wheel_pending--;
+	}
+	timer->expires = expires;
+	wheel_insert(timer);
+	wheel_pending++;
+	if(tsc_khz != 0 && WHEEL_ROUND(expires) < next_event){
+		if(lapic_mult != 0 && cpu_id() != 0){
+			smp_kick(0); 	//the APIC timer can only be armed by its own cpu
+		}
+		else{
+			now = clock_ns();
+			event_program(now, WHEEL_ROUND(expires));
+		}
+	}
+	spin_unlock_irqrestore(&timer_lock, flags);
+}
+
+/*
+* int32_t timer_del(ktimer_t* timer)
+*   Inputs: timer = timer from timer_setup
+*   Return Value: 1 if it was pending, 0 if not
+*	Function: cancels the timer. if cpu 0 is running its fn, which may queue
+*		it again, waits for the fn to finish first, so the timer can be freed
+*		once this returns
+*/
+int32_t timer_del(ktimer_t* timer){
+	uint32_t flags;
+	int32_t pending;
+
+	spin_lock_irqsave(&timer_lock, flags);
+	while(running_timer == timer && cpu_id() != 0){
+		spin_unlock(&timer_lock);
+		asm volatile("pause");
+		spin_lock(&timer_lock);
+	}
+	pending = timer_pending(timer);
+	if(pending){
+		wheel_unlink(timer);
+		wheel_pending--;
+	}
+	spin_unlock_irqrestore(&timer_lock, flags);
+	return pending;
+}
@@ -0,0 +1,89 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include "types.h"
+
+//8253/8254 PIT, channel 0 drives IRQ0
+#define PIT_IRQ 0
+#define PIT_IDT 32
+#define PIT_CHANNEL0 0x40
+#define PIT_CHANNEL2 0x42
+#define PIT_COMMAND 0x43
+#define PIT_SQUARE_WAVE 0x36 			//channel 0, low then high byte, mode 3
+#define PIT_ONESHOT 0x38 				//channel 0, low then high byte, mode 4
+#define PIT_CH2_ONESHOT 0xB0 			//channel 2, low then high byte, mode 0
+#define PIT_BASE_HZ 1193182
+#define PIT_HZ 100 						//10ms ticks
+#define PIT_BYTE_MASK 0xFF
+#define PIT_MAX_NS 50000000 			//under the 16 bit counter's 55ms
+#define PIT_MIN_COUNT 20 				//about 17us, shorter ones could be missed
+#define PIT_NS_MULT 5005 				//PIT counts per ns, shifted left by PIT_NS_SHIFT
+#define PIT_NS_SHIFT 22
+#define LAPIC_NS_SHIFT 22 				//local APIC timer counts per ns are shifted by it
+#define LAPIC_MAX_NS 1000000000 		//its counter is 32 bits, a second always fits
+
+//channel 2 is gated by the speaker port, used to calibrate the TSC
+#define PIT_GATE_PORT 0x61
+#define PIT_GATE 0x01
+#define PIT_SPEAKER 0x02
+#define PIT_CH2_OUT 0x20
+
+#define NSEC_PER_SEC 1000000000
+#define NSEC_PER_MSEC 1000000
+#define NSEC_PER_USEC 1000
+#define TICK_NS (NSEC_PER_SEC / PIT_HZ)
+
+//TSC clocksource, cycles are turned into ns by (cycles * mult) >> CLOCK_SHIFT
+#define CPUID_FEATURES 1
+#define CPUID_TSC (1 << 4) 				//edx
+#define CALIBRATE_MS 10
+#define TSC_MIN_KHZ 1000
+#define CLOCK_SHIFT 22
+
+//hierarchical timer wheel, WHEEL_LEVELS levels of WHEEL_SIZE slots. a slot
+//of level 0 is 2^WHEEL_SHIFT ns, about 131us, every level up is WHEEL_SIZE
+//times coarser. timers further out than the last level wait in its last slot
+#define WHEEL_SHIFT 17
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
+#define WHEEL_NEVER 0xFFFFFFFFFFFFFFFFULL
+#define WHEEL_ROUND(ns) (((ns) + (1 << WHEEL_SHIFT) - 1) & ~((1ULL << WHEEL_SHIFT) - 1))
+
+#define CLOCK_REALTIME 0
+#define CLOCK_MONOTONIC 1
+
+//kernel timer, fn runs in the PIT interrupt once clock_ns reaches expires
+typedef struct ktimer_t {
+	uint64_t expires;
+	void (*fn)(struct ktimer_t* timer);
+	void* data;
+	struct ktimer_t* next;
+	struct ktimer_t** pprev; 			//NULL while the timer isn't pending
+} ktimer_t;
+
+#define timer_pending(timer) ((timer)->pprev != NULL)
+
+typedef struct timespec_t {
+	uint32_t sec;
+	uint32_t nsec;
+} timespec_t;
+
+extern uint32_t tsc_khz; 				//0 if the clock runs off the PIT ticks
+
+void timer_init();
+void timer_use_lapic();
+void timer_ipi();
+uint32_t timer_interrupt();
+void timer_stop_tick();
+void timer_restart_tick();
+uint64_t clock_ns();
+uint64_t cycles_to_ns(uint64_t cycles);
+void clock_realtime(timespec_t* ts);
+void ns_to_timespec(uint64_t ns, timespec_t* ts);
+void timer_setup(ktimer_t* timer, void (*fn)(ktimer_t* timer), void* data);
+void timer_add(ktimer_t* timer, uint64_t expires);
+int32_t timer_del(ktimer_t* timer);
+
+#endif /* TIMER_H */
@@ -0,0 +1,21 @@
+#include "uaccess.h"
+
+//pairs of (faulting instruction, fixup) built in usercopy.S
+extern uint32_t ex_table_start[];
+extern uint32_t ex_table_end[];
+
+/*
+* uint32_t search_exception_table(uint32_t eip)
+*   Inputs: eip = address of the instruction that faulted
+*   Return Value: address to resume at, 0 if the instruction has no fixup
+*	Function: looks the instruction up in the exception table. the table only
+*		has a few entries so a linear scan is enough
+*/
+uint32_t search_exception_table(uint32_t eip){
+	uint32_t* entry;
+	for(entry = ex_table_start; entry < ex_table_end; entry += 2){
+		if(entry[0] == eip)
+			return entry[1];
+	}
+	return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef UACCESS_H
+#define UACCESS_H
+
+//everything a user pointer may point at: program, vidmap, heap and shared memory
+#define USER_SPACE_START 0x08000000 			//128MB
+#define USER_SPACE_END 0x09000000 				//144MB, end of shared memory
+
+#ifndef ASM
+
+#include "types.h"
+
+//each returns the number of bytes that could not be copied, 0 on success
+uint32_t copy_from_user(void* to, const void* from, uint32_t n);
+uint32_t copy_to_user(void* to, const void* from, uint32_t n);
+//copies a null terminated string, returns its length or -1 if it faults or
+//doesn't fit in n bytes
+int32_t strncpy_from_user(uint8_t* to, const uint8_t* from, uint32_t n);
+uint32_t search_exception_table(uint32_t eip);
+
+#endif /* ASM */
+
+#endif /* UACCESS_H */
@@ -0,0 +1,141 @@
+#include "workqueue.h"
+#include "lib.h"
+#include "sched.h"
+
+//bottom halves. interrupt handlers only grab what the device has and queue
+//a work item, the worker kernel thread runs the items with interrupts on once
+//the last handler is done. the worker has its own stack and runs in place of
+//the interrupted process, which it switches back to when the queue is empty.
+//the scheduler leaves the cpu alone while the worker runs
+
+static uint8_t worker_stack[WORKER_STACK_SIZE] __attribute__((aligned(4)));
+static uint32_t worker_esp; 			//worker parked in switch_to
+static uint32_t return_esp; 			//interrupted process parked in switch_to
+static volatile uint32_t in_worker;
+static work_t* work_head;
+static work_t* work_tail;
+
+/*
+* work_t* dequeue_work()
+*   Inputs: none
+*   Return Value: oldest queued work item, NULL if none
+*	Function: takes the item off the queue, interrupts must be off
+*/
+static work_t* dequeue_work(){
+	work_t* work = work_head;
+	if(work != NULL){
+		work_head = work->next;
+		if(work_head == NULL)
+			work_tail = NULL;
+		work->next = NULL;
+		work->pending = 0; 	//may be queued again while it runs
+	}
+	return work;
+}
+
+/*
+* void worker_main()
+*   Inputs: none
+*   Return Value: never returns
+*	Function: the worker thread, runs the queue empty with interrupts on and
+*		then switches back to the process it interrupted
+*/
+static void worker_main(){
+	work_t* work;
+	while(1){
+		cli();
+		work = dequeue_work();
+		if(work == NULL){
+			switch_to(&worker_esp, return_esp);
+			continue;
+		}
+		sti();
+		work->fn(work);
+	}
+}
+
+/*
+* void worker_init()
+*   Inputs: none
+*   Return Value: none
+*	Function: sets the worker's stack up to look like it is parked in
+*		switch_to, so the first switch to it starts worker_main
+*/
+void worker_init(){
+	uint32_t* stack = (uint32_t*)(worker_stack + WORKER_STACK_SIZE);
+
+	*--stack = 0; 						//worker_main never returns
+	*--stack = (uint32_t)worker_main; 	//switch_to returns into it
+	*--stack = 0; 						//ebp
+	*--stack = 0; 						//ebx
+	*--stack = 0; 						//esi
+	*--stack = 0; 						//edi
+	worker_esp = (uint32_t)stack;
+	work_head = NULL;
+	work_tail = NULL;
+	in_worker = 0;
+}
+
+/*
+* void work_init(work_t* work, void (*fn)(work_t* work))
+*   Inputs: work = item to set up
+*		fn = what the worker calls for it
+*   Return Value: none
+*	Function: initializes a work item that isn't queued
+*/
+void work_init(work_t* work, void (*fn)(work_t* work)){
+	work->fn = fn;
+	work->next = NULL;
+	work->pending = 0;
+}
+
+/*
+* int32_t queue_work(work_t* work)
+*   Inputs: work = item from work_init
+*   Return Value: 1 if queued, 0 if it was queued already
+*	Function: called from interrupt handlers, the item runs once they are done
+*/
+int32_t queue_work(work_t* work){
+	uint32_t flags;
+
+	cli_and_save(flags);
+	if(work->pending){
+		restore_flags(flags);
+		return 0;
+	}
+	work->pending = 1;
+	if(work_tail != NULL)
+		work_tail->next = work;
+	else
+		work_head = work;
+	work_tail = work;
+	restore_flags(flags);
+	return 1;
+}
+
+/*
+* void run_deferred_work()
+*   Inputs: none
+*   Return Value: none
+*	Function: called by the irq entries with interrupts off after the handler
+*		left the interrupt stack. switches to the worker if there is work,
+*		unless another irq is still running or the worker itself was
+*		interrupted, it picks up the new work in its loop
+*/
+void run_deferred_work(){
+	if(work_head == NULL || in_worker || irq_depth != 0)
+		return;
+	in_worker = 1;
+	switch_to(&return_esp, worker_esp);
+	in_worker = 0;
+}
+
+/*
+* int32_t worker_active()
+*   Inputs: none
+*   Return Value: 1 if the worker is running in place of a process
+*	Function: the scheduler and the ctrl+C halt have to wait until it is done
+*/
+int32_t worker_active(){
+	return in_worker;
+}
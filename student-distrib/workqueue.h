@@ -0,0 +1,21 @@
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include "types.h"
+
+#define WORKER_STACK_SIZE 0x2000
+
+//work an interrupt handler leaves for the worker thread
+typedef struct work_t {
+	void (*fn)(struct work_t* work);
+	struct work_t* next;
+	uint32_t pending; 					//queued and not started yet
+} work_t;
+
+void worker_init();
+void work_init(work_t* work, void (*fn)(work_t* work));
+int32_t queue_work(work_t* work);
+void run_deferred_work();
+int32_t worker_active();
+
+#endif /* WORKQUEUE_H */
@@ -15,6 +15,11 @@
 #define USER_DS 0x002B
 #define KERNEL_TSS 0x0030
 #define KERNEL_LDT 0x0038
+#define AP_TSS 0x0040 					//TSS of cpu 1, the other cpus' follow
+
+/* Each cpu has its own TSS, cpu 0 uses KERNEL_TSS */
+#define MAX_CPUS 4
+#define CPU_TSS(cpu) ((cpu) == 0 ? KERNEL_TSS : AP_TSS + (((cpu) - 1) << 3))
 
 /* Size of the task state segment (TSS) */
 #define TSS_SIZE 104
@@ -124,6 +129,7 @@ extern uint32_t ldt;
 extern uint32_t tss_size;
 extern seg_desc_t tss_desc_ptr;
 extern tss_t tss;
+extern seg_desc_t ap_tss_desc_ptr[MAX_CPUS - 1];
 
 /* Sets runtime-settable parameters in the GDT entry for the LDT */
 #define SET_LDT_PARAMS(str, addr, lim) \
@@ -0,0 +1,47 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NUMBUFSIZE 12
+
+static struct ece391_lockstat locks[ECE391_MAX_LOCKS];
+
+static void
+put_num (uint32_t value, uint32_t width)
+{
+    uint8_t buf[NUMBUFSIZE];
+    uint32_t len;
+
+    ece391_itoa (value, buf, 10);
+    for (len = ece391_strlen (buf); len < width; len++)
+        ece391_fdputs (1, (uint8_t*)" ");
+    ece391_fdputs (1, buf);
+}
+
+int main ()
+{
+    int32_t i, n;
+    uint32_t len;
+
+    if (-1 == (n = ece391_lockstat (locks, ECE391_MAX_LOCKS))) {
+        ece391_fdputs (1, (uint8_t*)"lockstat failed\n");
+        return 3;
+    }
+
+    /* locks show up once they have been taken */
+    ece391_fdputs (1, (uint8_t*)"lock          taken  waited   wait us   hold us  max hold\n");
+    for (i = 0; i < n; i++) {
+        ece391_fdputs (1, locks[i].name);
+        for (len = ece391_strlen (locks[i].name); len < 8; len++)
+            ece391_fdputs (1, (uint8_t*)" ");
+        put_num (locks[i].acquired, 11);
+        put_num (locks[i].contended, 8);
+        put_num (locks[i].wait_us, 10);
+        put_num (locks[i].hold_us, 10);
+        put_num (locks[i].max_hold_us, 10);
+        ece391_fdputs (1, (uint8_t*)"\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NUMBUFSIZE 12
+
+static struct ece391_memstat stats;
+
+static void
+put_num (uint32_t value)
+{
+    uint8_t buf[NUMBUFSIZE];
+
+    ece391_itoa (value, buf, 10);
+    ece391_fdputs (1, buf);
+}
+
+static void
+put_line (const uint8_t* name, uint32_t value, const uint8_t* unit)
+{
+    ece391_fdputs (1, name);
+    put_num (value);
+    ece391_fdputs (1, unit);
+}
+
+int main ()
+{
+    uint32_t i;
+
+    if (-1 == ece391_memstat (&stats)) {
+        ece391_fdputs (1, (uint8_t*)"memstat failed\n");
+        return 3;
+    }
+
+    ece391_fdputs (1, (uint8_t*)"frames (4KB) by owner\n");
+    put_line ((uint8_t*)"  pool     ", stats.pool_frames, (uint8_t*)"\n");
+    put_line ((uint8_t*)"  free     ", stats.free_frames, (uint8_t*)"\n");
+    put_line ((uint8_t*)"  zeroed   ", stats.zero_frames, (uint8_t*)"\n");
+    put_line ((uint8_t*)"  process  ", stats.process_frames, (uint8_t*)"\n");
+    put_line ((uint8_t*)"  fs cache ", stats.cache_frames, (uint8_t*)"\n");
+    put_line ((uint8_t*)"  shm      ", stats.shm_frames, (uint8_t*)"\n");
+    put_line ((uint8_t*)"  swap     ", stats.swap_frames, (uint8_t*)"\n");
+    put_line ((uint8_t*)"  video    ", stats.video_frames, (uint8_t*)"\n");
+    put_line ((uint8_t*)"  kernel   ", stats.kernel_frames, (uint8_t*)"\n");
+
+    put_line ((uint8_t*)"kernel stack ", stats.stack_size,
+              (uint8_t*)" bytes, deepest use ");
+    put_num (stats.max_stack_used);
+    ece391_fdputs (1, (uint8_t*)"\n");
+
+    put_line ((uint8_t*)"zero pool ", stats.zero_hits, (uint8_t*)" hits, ");
+    put_num (stats.zero_misses);
+    ece391_fdputs (1, (uint8_t*)" misses\n");
+
+    put_line ((uint8_t*)"large pages ", stats.promotions, (uint8_t*)" promoted, ");
+    put_num (stats.copied);
+    ece391_fdputs (1, (uint8_t*)" copied, ");
+    put_num (stats.demotions);
+    ece391_fdputs (1, (uint8_t*)" demoted\n");
+
+    ece391_fdputs (1, (uint8_t*)"pid term frames stack\n");
+    for (i = 0; i < stats.num_procs; i++) {
+        put_num (stats.procs[i].pid);
+        ece391_fdputs (1, (uint8_t*)"   ");
+        put_num (stats.procs[i].terminal);
+        ece391_fdputs (1, (uint8_t*)"    ");
+        put_num (stats.procs[i].frames);
+        ece391_fdputs (1, (uint8_t*)"    ");
+        put_num (stats.procs[i].stack_used);
+        ece391_fdputs (1, (uint8_t*)"\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NUMBUFSIZE 12
+
+static struct ece391_schedstat stats;
+
+static void
+put_num (uint32_t value)
+{
+    uint8_t buf[NUMBUFSIZE];
+
+    ece391_itoa (value, buf, 10);
+    ece391_fdputs (1, buf);
+}
+
+static void
+put_line (const uint8_t* name, uint32_t value, const uint8_t* unit)
+{
+    ece391_fdputs (1, name);
+    put_num (value);
+    ece391_fdputs (1, unit);
+}
+
+int main ()
+{
+    uint32_t i;
+
+    if (-1 == ece391_schedstat (&stats)) {
+        ece391_fdputs (1, (uint8_t*)"schedstat failed\n");
+        return 3;
+    }
+
+    put_line ((uint8_t*)"uptime        ", stats.uptime_ms, (uint8_t*)" ms\n");
+    put_line ((uint8_t*)"ticks         ", stats.ticks, (uint8_t*)"\n");
+    put_line ((uint8_t*)"switches      ", stats.switches, (uint8_t*)"\n");
+    put_line ((uint8_t*)"sleeps        ", stats.sleeps, (uint8_t*)"\n");
+    put_line ((uint8_t*)"cpus          ", stats.cpus, (uint8_t*)"\n");
+    put_line ((uint8_t*)"migrations    ", stats.migrations, (uint8_t*)"\n");
+    put_line ((uint8_t*)"ipis          ", stats.ipis, (uint8_t*)"\n");
+
+    /* idle time is summed over the cpus */
+    ece391_fdputs (1, (uint8_t*)"idle\n");
+    put_line ((uint8_t*)"  time        ", stats.idle_ms, (uint8_t*)" ms (");
+    put_num (stats.uptime_ms >= 100 ? stats.idle_ms / (stats.uptime_ms / 100 * stats.cpus) : 0);
+    ece391_fdputs (1, (uint8_t*)"%)\n");
+    put_line ((uint8_t*)"  halts       ", stats.idle_entries, (uint8_t*)"\n");
+    put_line ((uint8_t*)"  timer irqs  ", stats.timer_irqs, (uint8_t*)"\n");
+    put_line ((uint8_t*)"  ticks saved ", stats.ticks_skipped, (uint8_t*)"\n");
+
+    ece391_fdputs (1, (uint8_t*)"wakeups by irq\n");
+    for (i = 0; i < ECE391_NUM_IRQS; i++) {
+        if (stats.wakeups[i] == 0)
+            continue;
+        put_line ((uint8_t*)"  irq ", i, (uint8_t*)"  ");
+        put_num (stats.wakeups[i]);
+        ece391_fdputs (1, (uint8_t*)"\n");
+    }
+
+    return 0;
+}
@@ -4,6 +4,66 @@
 #include "ece391syscall.h"
 
 #define BUFSIZE 1024
+#define MAX_STAGES 4
+
+/*
+ * Runs "a | b | c": every stage but the last is spawned in the background
+ * with its stdout on a pipe into the next one, the shell waits for the last
+ * stage like a plain command. Returns what execute would.
+ */
+static int32_t
+run_pipeline (uint8_t* buf)
+{
+    uint8_t* stage[MAX_STAGES];
+    int32_t nstages, i, in_fd, rval;
+    int32_t fds[2];
+    uint8_t* end;
+
+    /* split on '|' and trim the spaces around each command */
+    nstages = 0;
+    stage[nstages++] = buf;
+    for (end = buf; '\0' != *end; end++) {
+        if ('|' != *end)
+	    continue;
+	if (MAX_STAGES == nstages)
+	    return -1;
+	*end = '\0';
+	stage[nstages++] = end + 1;
+    }
+    for (i = 0; i < nstages; i++) {
+        while (' ' == *stage[i])
+	    stage[i]++;
+	end = stage[i] + ece391_strlen (stage[i]);
+	while (end > stage[i] && ' ' == end[-1])
+	    *--end = '\0';
+	if ('\0' == *stage[i])
+	    return -1;
+    }
+
+    in_fd = 0;
+    for (i = 0; i < nstages - 1; i++) {
+        if (-1 == ece391_pipe (fds))
+	    break;
+	/* the stage keeps its own copy of the write end, close ours so the
+	   reader sees the end of the data when the stage halts */
+	rval = ece391_spawn (stage[i], in_fd, fds[1]);
+	ece391_close (fds[1]);
+	if (0 != in_fd)
+	    ece391_close (in_fd);
+	in_fd = fds[0];
+	if (-1 == rval)
+	    break;
+    }
+    if (i < nstages - 1) {
+        if (0 != in_fd)
+	    ece391_close (in_fd);
+	return -1;
+    }
+    rval = ece391_execute_fds (stage[nstages - 1], in_fd, 1);
+    if (0 != in_fd)
+        ece391_close (in_fd);
+    return rval;
+}
 
 int main ()
 {
@@ -24,7 +84,11 @@ int main ()
 	    return 0;
 	if ('\0' == buf[0])
 	    continue;
-	rval = ece391_execute (buf);
+	for (rval = 0; '\0' != buf[rval] && '|' != buf[rval]; rval++);
+	if ('|' == buf[rval])
+	    rval = run_pipeline (buf);
+	else
+	    rval = ece391_execute (buf);
 	if (-1 == rval)
 	    ece391_fdputs (1, (uint8_t*)"no such command\n");
 	else if (256 == rval)
@@ -3,6 +3,29 @@
 #include "ece391support.h"
 #include "ece391syscall.h"
 
+/*
+ * Heap allocator.  Small requests are served from segregated free lists,
+ * one per power-of-two size class (16 to 2048 bytes including the block
+ * header), so malloc and free are a list pop and push.  Empty classes are
+ * refilled by carving one block off the arena that is grown with sbrk.
+ * Larger requests get their own page-rounded block and are reused first-fit.
+ */
+#define MALLOC_MIN_SHIFT    4
+#define MALLOC_NUM_CLASSES  8
+#define MALLOC_LARGE        MALLOC_NUM_CLASSES
+#define MALLOC_CHUNK        4096
+#define MALLOC_HDR_SIZE     8
+
+typedef struct malloc_block {
+    uint32_t size_class;            /* class index, or MALLOC_LARGE */
+    uint32_t size;                  /* block size including the header */
+    struct malloc_block* next;      /* only valid while the block is free */
+} malloc_block_t;
+
+static malloc_block_t* free_lists[MALLOC_NUM_CLASSES + 1];
+static uint8_t* arena_cur = 0;
+static uint8_t* arena_end = 0;
+
 uint32_t ece391_strlen(const uint8_t* s)
 {
     uint32_t len;
@@ -102,3 +125,199 @@ uint8_t* ece391_strrev(uint8_t* s)
    return s;
 }
 
+/*
+ * Kernel data page.  Every cpu has its own copy at ECE391_KDATA_ADDR, so a
+ * copy is also retried if the process was moved to another cpu halfway.
+ */
+#define NSEC_PER_SEC 1000000000
+
+/* the stubs in ece391syscall.S test sysenter at ECE391_KDATA_SYSENTER */
+typedef char kdata_sysenter_offset[(__builtin_offsetof (struct ece391_kdata, sysenter)
+                                    == ECE391_KDATA_SYSENTER) ? 1 : -1];
+
+static void kdata_read(struct ece391_kdata* out)
+{
+    volatile struct ece391_kdata* k = (volatile struct ece391_kdata*)ECE391_KDATA_ADDR;
+    uint32_t seq, cpu;
+
+    do {
+        cpu = k->cpu;
+        seq = k->seq;
+        asm volatile ("" : : : "memory");
+        out->ticks = k->ticks;
+        out->time = k->time;
+        out->base_tsc = k->base_tsc;
+        out->base_ns = k->base_ns;
+        out->clock_mult = k->clock_mult;
+        out->clock_shift = k->clock_shift;
+        out->pid = k->pid;
+        out->terminal = k->terminal;
+        asm volatile ("" : : : "memory");
+    } while ((seq & 1) || seq != k->seq || cpu != k->cpu);
+    out->seq = seq;
+    out->cpu = cpu;
+}
+
+/* ns since boot from a copy of the page, the same sum the kernel does */
+static uint64_t kdata_ns(const struct ece391_kdata* k)
+{
+    uint64_t tsc, cycles;
+
+    if (k->clock_mult == 0)
+        return k->base_ns;
+    asm volatile ("rdtsc" : "=A" (tsc));
+    /* the TSCs of the cpus may be a little apart */
+    cycles = (tsc > k->base_tsc) ? tsc - k->base_tsc : 0;
+    return k->base_ns
+        + (((cycles >> 32) * k->clock_mult) << (32 - k->clock_shift))
+        + (((cycles & 0xFFFFFFFFULL) * k->clock_mult) >> k->clock_shift);
+}
+
+/* 64 by 32 bit division without libgcc, n becomes the quotient and the
+   remainder is returned */
+uint32_t ece391_div64(uint64_t* n, uint32_t base)
+{
+    uint32_t high = (uint32_t)(*n >> 32);
+    uint32_t low = (uint32_t)*n;
+    uint32_t q_high = high / base;
+    uint32_t rem;
+
+    high %= base;
+    asm ("divl %4"
+         : "=a" (low), "=d" (rem)
+         : "0" (low), "1" (high), "rm" (base));
+    *n = ((uint64_t)q_high << 32) | low;
+    return rem;
+}
+
+/* Scheduler ticks since boot */
+uint32_t ece391_ticks(void)
+{
+    struct ece391_kdata k;
+
+    kdata_read(&k);
+    return k.ticks;
+}
+
+/* Monotonic clock in ns */
+uint64_t ece391_clock_ns(void)
+{
+    struct ece391_kdata k;
+
+    kdata_read(&k);
+    return kdata_ns(&k);
+}
+
+/* Same as ece391_clock_gettime, without entering the kernel */
+int32_t ece391_gettime(int32_t clock, struct ece391_timespec* ts)
+{
+    struct ece391_kdata k;
+    uint64_t ns;
+
+    if (clock != ECE391_CLOCK_REALTIME && clock != ECE391_CLOCK_MONOTONIC)
+        return -1;
+    kdata_read(&k);
+    ns = kdata_ns(&k);
+    ts->nsec = ece391_div64(&ns, NSEC_PER_SEC);
+    ts->sec = (uint32_t)ns;
+    if (clock == ECE391_CLOCK_REALTIME) {
+        /* time is the boot time plus base_ns in whole seconds */
+        ns = k.base_ns;
+        ece391_div64(&ns, NSEC_PER_SEC);
+        ts->sec += k.time - (uint32_t)ns;
+    }
+    return 0;
+}
+
+/* Pid of the calling process */
+int32_t ece391_getpid(void)
+{
+    struct ece391_kdata k;
+
+    kdata_read(&k);
+    return k.pid;
+}
+
+/* Terminal the calling process runs on */
+int32_t ece391_getterminal(void)
+{
+    struct ece391_kdata k;
+
+    kdata_read(&k);
+    return k.terminal;
+}
+
+
+/* Grow the arena so at least size more bytes can be carved from it */
+static int32_t malloc_arena_grow(uint32_t size)
+{
+    uint32_t chunk = (size + MALLOC_CHUNK - 1) & ~(MALLOC_CHUNK - 1);
+    int32_t old_brk = ece391_sbrk(chunk);
+
+    if (-1 == old_brk)
+        return -1;
+    /* sbrk memory is contiguous unless a large block was taken in between */
+    if ((uint8_t*)old_brk != arena_end)
+        arena_cur = (uint8_t*)old_brk;
+    arena_end = (uint8_t*)old_brk + chunk;
+    return 0;
+}
+
+void* ece391_malloc(uint32_t size)
+{
+    malloc_block_t* block;
+    malloc_block_t** prev;
+    uint32_t need = size + MALLOC_HDR_SIZE;
+    uint32_t c;
+    int32_t old_brk;
+
+    if (0 == size)
+        return 0;
+
+    /* small request: find the size class and pop its free list */
+    for (c = 0; c < MALLOC_NUM_CLASSES; c++) {
+        if (need <= (1U << (c + MALLOC_MIN_SHIFT)))
+            break;
+    }
+    if (c < MALLOC_NUM_CLASSES) {
+        need = 1U << (c + MALLOC_MIN_SHIFT);
+        if (0 != (block = free_lists[c])) {
+            free_lists[c] = block->next;
+            return (uint8_t*)block + MALLOC_HDR_SIZE;
+        }
+        if (arena_end - arena_cur < need && -1 == malloc_arena_grow(need))
+            return 0;
+        block = (malloc_block_t*)arena_cur;
+        arena_cur += need;
+        block->size_class = c;
+        block->size = need;
+        return (uint8_t*)block + MALLOC_HDR_SIZE;
+    }
+
+    /* large request: reuse a freed block that fits, else take fresh pages */
+    for (prev = &free_lists[MALLOC_LARGE]; 0 != *prev; prev = &(*prev)->next) {
+        if ((*prev)->size >= need) {
+            block = *prev;
+            *prev = block->next;
+            return (uint8_t*)block + MALLOC_HDR_SIZE;
+        }
+    }
+    need = (need + MALLOC_CHUNK - 1) & ~(MALLOC_CHUNK - 1);
+    if (-1 == (old_brk = ece391_sbrk(need)))
+        return 0;
+    block = (malloc_block_t*)old_brk;
+    block->size_class = MALLOC_LARGE;
+    block->size = need;
+    return (uint8_t*)block + MALLOC_HDR_SIZE;
+}
+
+void ece391_free(void* ptr)
+{
+    malloc_block_t* block;
+
+    if (0 == ptr)
+        return;
+    block = (malloc_block_t*)((uint8_t*)ptr - MALLOC_HDR_SIZE);
+    block->next = free_lists[block->size_class];
+    free_lists[block->size_class] = block;
+}
@@ -1,6 +1,8 @@
 #if !defined(ECE391SUPPORT_H)
 #define ECE391SUPPORT_H
 
+struct ece391_timespec;
+
 extern uint32_t ece391_strlen(const uint8_t* s);
 extern void ece391_strcpy(uint8_t* dst, const uint8_t* src);
 extern void ece391_fdputs(int32_t fd, const uint8_t* s);
@@ -8,6 +10,14 @@ extern int32_t ece391_strcmp(const uint8_t* s1, const uint8_t* s2);
 extern int32_t ece391_strncmp(const uint8_t* s1, const uint8_t* s2, uint32_t n);
 extern uint8_t *ece391_itoa(uint32_t value, uint8_t* buf, int32_t radix);
 extern uint8_t *ece391_strrev(uint8_t* s);
+extern void *ece391_malloc(uint32_t size);
+extern void ece391_free(void* ptr);
+extern uint32_t ece391_ticks(void);
+extern uint64_t ece391_clock_ns(void);
+extern int32_t ece391_gettime(int32_t clock, struct ece391_timespec* ts);
+extern int32_t ece391_getpid(void);
+extern int32_t ece391_getterminal(void);
+extern uint32_t ece391_div64(uint64_t* n, uint32_t base);
 
 #endif /* ECE391SUPPORT_H */
 
@@ -0,0 +1,72 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NUMBUFSIZE 12
+#define CALLS 20000
+#define ROUNDS 5
+
+/* ns for CALLS calls of fn, the best of ROUNDS so a timer interrupt or a
+   switch to another process doesn't count. fits 32 bits below 4s */
+static uint32_t
+time_calls (int32_t (*fn)(void))
+{
+    uint32_t best = 0xFFFFFFFF;
+    uint32_t elapsed;
+    uint64_t start;
+    int32_t round, i;
+
+    for (round = 0; round < ROUNDS; round++) {
+        start = ece391_clock_ns ();
+        for (i = 0; i < CALLS; i++)
+            fn ();
+        elapsed = (uint32_t)(ece391_clock_ns () - start);
+        if (elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+/* prints the ns per call of one path */
+static void
+put_result (const uint8_t* name, uint32_t ns)
+{
+    uint8_t buf[NUMBUFSIZE];
+
+    ece391_fdputs (1, name);
+    ece391_itoa (ns / CALLS, buf, 10);
+    ece391_fdputs (1, buf);
+    ece391_fdputs (1, (uint8_t*)" ns per call\n");
+}
+
+/* times the empty system call through int $0x80 and through sysenter */
+int main ()
+{
+    volatile struct ece391_kdata* k = (volatile struct ece391_kdata*)ECE391_KDATA_ADDR;
+    uint32_t slow, fast;
+    uint64_t tenths;
+    uint8_t buf[NUMBUFSIZE];
+
+    slow = time_calls (ece391_null_int80);
+    put_result ((uint8_t*)"int $0x80 ", slow);
+    if (!k->sysenter) {
+        ece391_fdputs (1, (uint8_t*)"sysenter  not supported\n");
+        return 0;
+    }
+    fast = time_calls (ece391_null_sysenter);
+    put_result ((uint8_t*)"sysenter  ", fast);
+    if (fast != 0) {
+        /* slow * 10 passes 32 bits once the int $0x80 run takes 430ms */
+        tenths = (uint64_t)slow * 10;
+        ece391_div64 (&tenths, fast);
+        ece391_fdputs (1, (uint8_t*)"speedup   ");
+        ece391_itoa ((uint32_t)tenths / 10, buf, 10);
+        ece391_fdputs (1, buf);
+        ece391_fdputs (1, (uint8_t*)".");
+        ece391_itoa ((uint32_t)tenths % 10, buf, 10);
+        ece391_fdputs (1, buf);
+        ece391_fdputs (1, (uint8_t*)"x\n");
+    }
+    return 0;
+}
@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 
+#include "ece391sysnum.h"
+
 /* All calls return >= 0 on success or -1 on failure. */
 
 /*  
@@ -21,6 +23,175 @@ extern int32_t ece391_getargs (uint8_t* buf, int32_t nbytes);
 extern int32_t ece391_vidmap (uint8_t** screen_start);
 extern int32_t ece391_set_handler (int32_t signum, void* handler);
 extern int32_t ece391_sigreturn (void);
+/* Sets the ALARM period in ms (10000 by default), 0 stops it. Returns the old one. */
+extern int32_t ece391_alarm (uint32_t ms);
+/*
+ * Pipes: fds[0] gets the read end, fds[1] the write end. spawn starts a
+ * program in the background with in_fd and out_fd as its stdin and stdout
+ * and returns its pid without waiting; execute_fds does the same but waits
+ * like execute. Both only take terminal and pipe descriptors.
+ */
+extern int32_t ece391_pipe (int32_t fds[2]);
+extern int32_t ece391_spawn (const uint8_t* command, int32_t in_fd, int32_t out_fd);
+extern int32_t ece391_execute_fds (const uint8_t* command, int32_t in_fd, int32_t out_fd);
+/* Grows (or shrinks) the heap by increment bytes, returns the old end. */
+extern int32_t ece391_sbrk (int32_t increment);
+/* Named shared memory: create (or look up) a segment, then map it. A
+   segment lives while its creator runs or any process has it attached. */
+extern int32_t ece391_shm_create (const uint8_t* name, uint32_t size);
+extern int32_t ece391_shm_attach (int32_t id);
+extern int32_t ece391_shm_detach (void* addr);
+
+/* Must match the kernel's MAX_PROCESSES. */
+#ifndef ECE391_MAX_PROCS
+#define ECE391_MAX_PROCS 64
+#endif
+
+/* Memory use of one process. */
+struct ece391_procmem {
+    uint32_t pid;
+    uint32_t terminal;
+    uint32_t frames;           /* private 4KB frames, page tables included */
+    uint32_t stack_used;       /* deepest kernel stack use in bytes */
+};
+
+/* Frames (4KB) by owner and kernel stack use, filled in by memstat. */
+struct ece391_memstat {
+    uint32_t pool_frames;
+    uint32_t free_frames;
+    uint32_t zero_frames;
+    uint32_t zero_hits;        /* zeroed allocations served from the zero pool */
+    uint32_t zero_misses;      /* zeroed allocations that zeroed on the spot */
+    uint32_t process_frames;
+    uint32_t cache_frames;
+    uint32_t shm_frames;
+    uint32_t swap_frames;
+    uint32_t video_frames;
+    uint32_t kernel_frames;
+    uint32_t stack_size;
+    uint32_t max_stack_used;
+    uint32_t promotions;       /* heaps collapsed into a 4MB page */
+    uint32_t demotions;        /* 4MB pages split back into 4KB pages */
+    uint32_t copied;           /* promotions that copied into a free 4MB block */
+    uint32_t num_procs;
+    struct ece391_procmem procs[ECE391_MAX_PROCS];
+};
+
+extern int32_t ece391_memstat (struct ece391_memstat* buf);
+
+/* clock_gettime clocks, time since 1970 and time since boot */
+#define ECE391_CLOCK_REALTIME 0
+#define ECE391_CLOCK_MONOTONIC 1
+
+struct ece391_timespec {
+    uint32_t sec;
+    uint32_t nsec;
+};
+
+extern int32_t ece391_clock_gettime (int32_t clock, struct ece391_timespec* ts);
+extern int32_t ece391_nanosleep (const struct ece391_timespec* req, struct ece391_timespec* rem);
+
+/* Read-only page the kernel keeps up to date in every process, read by the
+   clock, tick and pid functions in ece391support.c without a system call.
+   seq is odd while the kernel writes it. ns since boot are
+   base_ns + ((rdtsc - base_tsc) * clock_mult >> clock_shift), or just
+   base_ns if clock_mult is 0. sysenter is set when the system calls in
+   ece391syscall.S enter the kernel through sysenter instead of int $0x80.
+   ECE391_KDATA_ADDR and the sysenter offset are in ece391sysnum.h */
+
+struct ece391_kdata {
+    uint32_t seq;
+    uint32_t cpu;
+    uint32_t ticks;
+    uint32_t time;
+    uint64_t base_tsc;
+    uint64_t base_ns;
+    uint32_t clock_mult;
+    uint32_t clock_shift;
+    int32_t pid;
+    int32_t terminal;
+    uint32_t sysenter;
+};
+
+/* Scheduler counters and idle residency, filled in by schedstat. */
+#define ECE391_NUM_IRQS 16
+
+struct ece391_schedstat {
+    uint32_t ticks;
+    uint32_t idle_ticks;
+    uint32_t switches;
+    uint32_t sleeps;
+    uint32_t uptime_ms;
+    uint32_t idle_ms;
+    uint32_t idle_entries;
+    uint32_t timer_irqs;
+    uint32_t ticks_skipped;
+    uint32_t wakeups[ECE391_NUM_IRQS];
+    uint32_t cpus;
+    uint32_t migrations;
+    uint32_t ipis;
+};
+
+extern int32_t ece391_schedstat (struct ece391_schedstat* buf);
+
+/* filled in by ece391_read on an rtc when the buffer is this big, a 4 byte
+   buffer gets just elapsed. latencies are in 1/1024 second ticks */
+struct ece391_rtc_info {
+    uint32_t elapsed;
+    uint32_t frequency;
+    uint32_t ticks;
+    uint32_t missed;
+    uint32_t jitter_max;
+    uint32_t jitter_avg;
+};
+
+/* cpu time of one process, filled in by getrusage. who is a pid, or one of
+   these for the caller or its halted children. times are in us */
+#define ECE391_RUSAGE_SELF -1
+#define ECE391_RUSAGE_CHILDREN -2
+#define ECE391_MAX_PROCESSES 64
+#define ECE391_PROC_NAME_LEN 32
+
+#define ECE391_PROC_RUNNING 0
+#define ECE391_PROC_RUNNABLE 1
+#define ECE391_PROC_BLOCKED 2
+#define ECE391_PROC_WAITING 3
+
+struct ece391_rusage {
+    uint32_t pid;
+    int32_t ppid;
+    uint32_t terminal;
+    uint32_t state;
+    uint32_t utime_us;
+    uint32_t stime_us;
+    uint32_t nvcsw;
+    uint32_t nivcsw;
+    uint32_t start_ms;
+    uint8_t name[ECE391_PROC_NAME_LEN];
+};
+
+extern int32_t ece391_getrusage (int32_t who, struct ece391_rusage* buf);
+
+/* counters of one kernel spinlock, lockstat fills in up to max of them and
+   returns how many. times are in us */
+#define ECE391_MAX_LOCKS 32
+#define ECE391_LOCK_NAME_LEN 16
+
+struct ece391_lockstat {
+    uint8_t name[ECE391_LOCK_NAME_LEN];
+    uint32_t acquired;
+    uint32_t contended;
+    uint32_t wait_us;
+    uint32_t hold_us;
+    uint32_t max_hold_us;
+};
+
+extern int32_t ece391_lockstat (struct ece391_lockstat* buf, int32_t max);
+
+/* the empty call 0 through int $0x80 and through sysenter, both return -1.
+   only call ece391_null_sysenter if the kdata page's sysenter is set */
+extern int32_t ece391_null_int80 (void);
+extern int32_t ece391_null_sysenter (void);
 
 enum signums {
 	DIV_ZERO = 0,
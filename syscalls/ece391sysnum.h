@@ -11,5 +11,24 @@
 #define SYS_VIDMAP  8
 #define SYS_SET_HANDLER  9
 #define SYS_SIGRETURN  10
+#define SYS_SBRK    11
+#define SYS_SHM_CREATE  12
+#define SYS_SHM_ATTACH  13
+#define SYS_SHM_DETACH  14
+#define SYS_MEMSTAT 15
+#define SYS_CLOCK_GETTIME 16
+#define SYS_NANOSLEEP 17
+#define SYS_SCHEDSTAT 18
+#define SYS_ALARM 19
+#define SYS_PIPE 20
+#define SYS_SPAWN 21
+#define SYS_EXECUTE_FDS 22
+#define SYS_GETRUSAGE 23
+#define SYS_LOCKSTAT 24
+
+/* The kernel data page, struct ece391_kdata in ece391syscall.h, and the
+   offset of its sysenter field for the stubs in ece391syscall.S */
+#define ECE391_KDATA_ADDR 0x08401000
+#define ECE391_KDATA_SYSENTER 48
 
 #endif /* ECE391SYSNUM_H */
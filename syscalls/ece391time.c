@@ -0,0 +1,64 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define BUFSIZE 128
+#define NUMBUFSIZE 12
+
+static struct ece391_rusage before, after;
+
+/* prints us as seconds with three decimals */
+static void
+put_time (const uint8_t* name, uint32_t us)
+{
+    uint8_t buf[NUMBUFSIZE];
+    uint32_t ms = us / 1000;
+
+    ece391_fdputs (1, name);
+    ece391_itoa (ms / 1000, buf, 10);
+    ece391_fdputs (1, buf);
+    ece391_fdputs (1, (uint8_t*)".");
+    ms %= 1000;
+    if (ms < 100)
+        ece391_fdputs (1, (uint8_t*)"0");
+    if (ms < 10)
+        ece391_fdputs (1, (uint8_t*)"0");
+    ece391_itoa (ms, buf, 10);
+    ece391_fdputs (1, buf);
+    ece391_fdputs (1, (uint8_t*)"s\n");
+}
+
+/* runs the command given as its arguments, then prints the wall clock time
+   and the cpu time it used in user mode and in the kernel */
+int main ()
+{
+    uint8_t command[BUFSIZE];
+    struct ece391_timespec start, end;
+    int32_t status;
+
+    if (0 != ece391_getargs (command, BUFSIZE) || command[0] == '\0') {
+        ece391_fdputs (1, (uint8_t*)"usage: time <command>\n");
+        return 3;
+    }
+
+    ece391_getrusage (ECE391_RUSAGE_CHILDREN, &before);
+    ece391_gettime (ECE391_CLOCK_MONOTONIC, &start);
+    status = ece391_execute (command);
+    ece391_gettime (ECE391_CLOCK_MONOTONIC, &end);
+    ece391_getrusage (ECE391_RUSAGE_CHILDREN, &after);
+
+    if (status == -1) {
+        ece391_fdputs (1, (uint8_t*)"time: no such command\n");
+        return 3;
+    }
+    if (end.nsec < start.nsec) {
+        end.nsec += 1000000000;
+        end.sec--;
+    }
+    ece391_fdputs (1, (uint8_t*)"\n");
+    put_time ((uint8_t*)"real ", (end.sec - start.sec) * 1000000 + (end.nsec - start.nsec) / 1000);
+    put_time ((uint8_t*)"user ", after.utime_us - before.utime_us);
+    put_time ((uint8_t*)"sys  ", after.stime_us - before.stime_us);
+    return status;
+}
@@ -0,0 +1,161 @@
+#include <stdint.h>
+
+#include "ece391support.h"
+#include "ece391syscall.h"
+
+#define NUM_COLS 80
+#define NUM_ROWS 25
+#define ATTRIB 0x7
+#define NUM_TERMINALS 3
+#define NUMBUFSIZE 12
+#define REFRESH_SEC 1
+#define TABLE_ROW 2
+
+/* columns of the table */
+#define COL_PID 0
+#define COL_PPID 6
+#define COL_STATE 13
+#define COL_CPU 19
+#define COL_USER 25
+#define COL_SYS 36
+#define COL_VCSW 47
+#define COL_IVCSW 55
+#define COL_NAME 64
+
+static uint8_t* screen;
+static struct ece391_rusage usage;
+
+/* cpu time and start of each pid at the last refresh, a different start
+   means the pid was reused */
+static uint32_t last_cpu[ECE391_MAX_PROCESSES];
+static uint32_t last_start[ECE391_MAX_PROCESSES];
+
+static const char* state_names[] = {"run", "ready", "sleep", "wait"};
+
+static void
+put_str (int32_t row, int32_t col, const uint8_t* s)
+{
+    uint8_t* cell = screen + ((row * NUM_COLS + col) << 1);
+
+    while (*s != '\0' && col++ < NUM_COLS) {
+        cell[0] = *s++;
+        cell[1] = ATTRIB;
+        cell += 2;
+    }
+}
+
+/* right aligned in width columns */
+static void
+put_num (int32_t row, int32_t col, int32_t width, uint32_t value)
+{
+    uint8_t buf[NUMBUFSIZE];
+
+    ece391_itoa (value, buf, 10);
+    put_str (row, col + width - ece391_strlen (buf), buf);
+}
+
+static void
+clear_row (int32_t row)
+{
+    uint8_t* cell = screen + ((row * NUM_COLS) << 1);
+    int32_t i;
+
+    for (i = 0; i < NUM_COLS; i++) {
+        cell[i << 1] = ' ';
+        cell[(i << 1) + 1] = ATTRIB;
+    }
+}
+
+static uint32_t
+now_ms ()
+{
+    struct ece391_timespec ts;
+
+    ece391_clock_gettime (ECE391_CLOCK_MONOTONIC, &ts);
+    return ts.sec * 1000 + ts.nsec / 1000000;
+}
+
+/* one line for the process in usage, its share of the cpu since the last
+   refresh elapsed_ms ago */
+static void
+put_proc (int32_t row, uint32_t elapsed_ms)
+{
+    uint32_t cpu = usage.utime_us + usage.stime_us;
+    uint32_t used = 0;
+
+    if (last_start[usage.pid] == usage.start_ms && elapsed_ms >= 10)
+        used = (cpu - last_cpu[usage.pid]) / (elapsed_ms * 10);
+    last_cpu[usage.pid] = cpu;
+    last_start[usage.pid] = usage.start_ms;
+
+    clear_row (row);
+    put_num (row, COL_PID, 5, usage.pid);
+    if (usage.ppid >= 0)
+        put_num (row, COL_PPID, 5, usage.ppid);
+    else
+        put_str (row, COL_PPID + 4, (uint8_t*)"-");
+    put_str (row, COL_STATE, (uint8_t*)state_names[usage.state]);
+    put_num (row, COL_CPU, 4, used);
+    put_num (row, COL_USER, 8, usage.utime_us / 1000);
+    put_num (row, COL_SYS, 8, usage.stime_us / 1000);
+    put_num (row, COL_VCSW, 6, usage.nvcsw);
+    put_num (row, COL_IVCSW, 6, usage.nivcsw);
+    put_str (row, COL_NAME, usage.name);
+}
+
+/* refreshes every second with the processes of each terminal under their
+   own heading, until ctrl+C */
+int main ()
+{
+    struct ece391_timespec delay = {REFRESH_SEC, 0};
+    uint32_t last_ms, ms, elapsed;
+    int32_t row, term, pid, procs;
+
+    if (-1 == ece391_vidmap (&screen)) {
+        ece391_fdputs (1, (uint8_t*)"top: vidmap failed\n");
+        return 3;
+    }
+
+    last_ms = now_ms ();
+    while (1) {
+        ms = now_ms ();
+        elapsed = ms - last_ms;
+        last_ms = ms;
+
+        row = TABLE_ROW;
+        procs = 0;
+        for (term = 0; term < NUM_TERMINALS && row < NUM_ROWS - 1; term++) {
+            clear_row (row);
+            put_str (row, 0, (uint8_t*)"terminal ");
+            put_num (row, 9, 1, term);
+            row++;
+            for (pid = 0; pid < ECE391_MAX_PROCESSES && row < NUM_ROWS; pid++) {
+                if (0 != ece391_getrusage (pid, &usage) || usage.terminal != term)
+                    continue;
+                put_proc (row++, elapsed);
+                procs++;
+            }
+        }
+        while (row < NUM_ROWS)
+            clear_row (row++);
+
+        clear_row (0);
+        put_str (0, 0, (uint8_t*)"top - up       s,      processes");
+        put_num (0, 8, 6, ms / 1000);
+        put_num (0, 16, 5, procs);
+        clear_row (1);
+        put_str (1, COL_PID, (uint8_t*)"  PID");
+        put_str (1, COL_PPID, (uint8_t*)" PPID");
+        put_str (1, COL_STATE, (uint8_t*)"STATE");
+        put_str (1, COL_CPU, (uint8_t*)"%CPU");
+        put_str (1, COL_USER, (uint8_t*)" USER ms");
+        put_str (1, COL_SYS, (uint8_t*)"  SYS ms");
+        put_str (1, COL_VCSW, (uint8_t*)"  VCSW");
+        put_str (1, COL_IVCSW, (uint8_t*)" IVCSW");
+        put_str (1, COL_NAME, (uint8_t*)"NAME");
+
+        ece391_nanosleep (&delay, 0);
+    }
+
+    return 0;
+}